@@ -0,0 +1,556 @@
+/*
+ * adc.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of Analog to Digital converter 
+ * for ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Analog to Digital converter, continuous acquisition (adc.h and adc.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * See adc.h for usage.
+ */
+
+#include "adc.h"
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#if (ADC_BUFFER_SIZE & (ADC_BUFFER_SIZE - 1)) != 0 || ADC_BUFFER_SIZE > 256
+# error "ADC_BUFFER_SIZE must be power of two and at most 256"
+#endif
+
+#if ADC_SCAN_MAX < 1 || ADC_SCAN_MAX >= ADC_BUFFER_SIZE || ADC_SCAN_MAX > 127
+# error "ADC_SCAN_MAX must be 1..127 and smaller than ADC_BUFFER_SIZE"
+#endif
+
+#define ADC_MASK (ADC_BUFFER_SIZE - 1)
+
+/* Ring buffer, interrupt writes to head and adc_read() reads from tail.
+ * Sample is stored before head is moved, so reader never sees a slot
+ * which is being written. */
+static volatile uint16_t adc_buffer[ADC_BUFFER_SIZE];
+static volatile uint8_t adc_head;
+static volatile uint8_t adc_tail;
+
+/* Sample number of each slot. adc_sequence counts every conversion, 
+ * also the dropped ones, so a jump between slots is a gap. */
+static volatile uint16_t adc_mark[ADC_BUFFER_SIZE];
+static volatile uint16_t adc_sequence;
+
+/* samples dropped because buffer was full */
+static volatile uint16_t adc_overrun_count;
+
+/* Sample number of the next sample at tail, extended to 32 bits, and 
+ * its place in frame. Only main loop uses these. */
+static uint32_t adc_number;
+static uint8_t adc_position;
+
+/* Conversions of one frame in order. Input is ADC_INPUT() value and 
+ * store is place in frame + 1, or zero for a settling conversion whose
+ * result is discarded. */
+static uint8_t adc_scan_input[2 * ADC_SCAN_MAX];
+static uint8_t adc_scan_store[2 * ADC_SCAN_MAX];
+static uint8_t adc_scan_steps = 1;
+static uint8_t adc_scan_channels = 1;
+
+/* ADC_vect: step of the result being read and step to write to ADMUX */
+static volatile uint8_t adc_scan_result;
+static volatile uint8_t adc_scan_mux;
+
+#if ADC_OVERSAMPLE_BITS
+/* 4^3 sums of 1023 fit to 16 bits, more do not */
+#if ADC_OVERSAMPLE_BITS > 3
+typedef uint32_t adc_sum_t;
+#else
+typedef uint16_t adc_sum_t;
+#endif
+
+/* Sums of each input and number of frames summed so far. Only ADC_vect
+ * uses these after adc_scan(). */
+static adc_sum_t adc_sum[ADC_SCAN_MAX];
+static uint16_t adc_round;
+#endif
+
+#if ADC_TIMER_TRIGGER
+/* Timer prescalers selected by CSn2:0 values 1..5 */
+static const uint16_t adc_timer_prescalers[] = { 1, 8, 64, 256, 1024 };
+
+/* actual sample rate in Hz */
+static uint16_t adc_rate_hz;
+
+/************************************************************************/
+/* Sets timer prescaler and TOP, timer starts counting from zero        */
+/************************************************************************/
+static void adc_timer_set(uint8_t cs, uint16_t top)
+{
+#if ADC_TRIGGER == ADC_TRIGGER_TIMER1
+	/* CTC mode 12, counter is cleared after ICR1. OCR1A is left free, 
+	 * compare B is the trigger and matches when counter is at TOP. */
+	TCCR1B = 0;
+	TCCR1A = 0;
+	ICR1 = top;
+	OCR1B = top;
+	TCNT1 = 0;
+	TIFR1 = (1<<OCF1B);
+	TCCR1B = (1<<WGM13) | (1<<WGM12) | cs;
+#else
+	/* CTC mode 2, counter is cleared after OCR0A and compare A is the 
+	 * trigger */
+	TCCR0B = 0;
+	TCCR0A = (1<<WGM01);
+	OCR0A = top;
+	TCNT0 = 0;
+	TIFR0 = (1<<OCF0A);
+	TCCR0B = cs;
+#endif
+}
+#endif
+
+/************************************************************************/
+/* Selects input for the next conversion to start                       */
+/************************************************************************/
+static inline void adc_select(uint8_t input)
+{
+	/* Right adjusted result (ADLAR 0), all 10 bits are read from ADC 
+	 * (ADCL first and then ADCH, compiler does it in this order). 
+	 * REFS1:0 and MUX4:0 are in ADMUX and MUX5 in ADCSRB, where it is
+	 * bit 5 like in input. 
+	 */
+	ADMUX = input & ~(1<<ADLAR);
+	
+	/* ADTS3:0 zero is Free Running mode, new conversion starts when the
+	 * previous one completes. Timer triggers are rising edges of its 
+	 * compare match flag. ADC_TRIGGER_SLEEP does not use ADTS. */
+	ADCSRB = (input & (1<<MUX5)) | ADC_ADTS;
+}
+
+/************************************************************************/
+/* Nonzero for inputs through gain stage, bandgap and temperature       */
+/* sensor. Single ended inputs are MUX5:0 0..7 and 32..39, but 39 is    */
+/* the temperature sensor.                                              */
+/************************************************************************/
+static uint8_t adc_internal(uint8_t input)
+{
+	return (input & 0x18) || (input & 0x3F) == ADC_TEMPERATURE;
+}
+
+/************************************************************************/
+/* Nonzero when first conversion of next after previous is not usable.  */
+/* Reference needs time to settle, internal inputs when they are        */
+/* switched in or out.                                                  */
+/************************************************************************/
+static uint8_t adc_settles(uint8_t previous, uint8_t next)
+{
+	if(previous == next)
+		return 0;
+	if((previous ^ next) & ((1<<REFS1) | (1<<REFS0)))
+		return 1;
+	return adc_internal(previous) || adc_internal(next);
+}
+
+/************************************************************************/
+/* Starts continuous conversions of channel. channel is the MUX5:0      */
+/* value of datasheet Table 24-4, 0..7 are ADC0..ADC7 single ended.     */
+/************************************************************************/
+void adc_start(uint8_t channel)
+{
+	uint8_t input = ADC_INPUT(channel);
+	adc_scan(&input, 1);
+}
+
+/************************************************************************/
+/* Starts continuous conversions of count inputs in turn, see adc.h.    */
+/* Returns number of conversions per frame, or 0 if count is 0 or over  */
+/* ADC_SCAN_MAX.                                                        */
+/************************************************************************/
+uint8_t adc_scan(const uint8_t* inputs, uint8_t count)
+{
+	uint8_t i, steps = 0;
+	uint8_t previous;
+	
+	if(count == 0 || count > ADC_SCAN_MAX)
+		return 0;
+	
+	/* interrupt must not see the schedule half written */
+	adc_stop();
+	
+	/* frame follows the previous frame, so first input settles after
+	 * the last one */
+	previous = inputs[count - 1];
+	for(i=0;i<count;i++)
+	{
+		if(adc_settles(previous, inputs[i]))
+		{
+			adc_scan_input[steps] = inputs[i];
+			adc_scan_store[steps++] = 0;
+		}
+		adc_scan_input[steps] = inputs[i];
+		adc_scan_store[steps++] = i + 1;
+		previous = inputs[i];
+	}
+	adc_scan_steps = steps;
+	adc_scan_channels = count;
+	
+	adc_head = 0;
+	adc_tail = 0;
+	adc_overrun_count = 0;
+	adc_sequence = 0;
+	adc_number = 0;
+	adc_position = 0;
+#if ADC_OVERSAMPLE_BITS
+	for(i=0;i<count;i++)
+		adc_sum[i] = 0;
+	adc_round = 0;
+#endif
+	
+	/* ADC_vect of the first conversion selects the second step */
+	adc_select(adc_scan_input[0]);
+	adc_scan_mux = steps > 1 ? 1 : 0;
+	
+#if ADC_TRIGGER == ADC_TRIGGER_FREE_RUNNING
+	/* Second conversion starts before the first interrupt and uses the
+	 * first step again, so the first result is discarded with 0xFF and
+	 * ADC_vect writes ADMUX two conversions ahead from then on. With a
+	 * timer the next conversion waits for the trigger and ADMUX is 
+	 * written one conversion ahead. */
+	adc_scan_result = 0xFF;
+	
+	/* Enable, start the first conversion, auto trigger, interrupt and
+	 * prescaler, see ADC_PRESCALER in adc.h. Writing one to ADIF clears
+	 * a flag left from before adc_stop(), so no stale interrupt comes. */
+	ADCSRA = (1<<ADEN) | (1<<ADSC) | (1<<ADATE) | (1<<ADIF) | (1<<ADIE) | ADC_ADPS;
+#elif ADC_TRIGGER == ADC_TRIGGER_SLEEP
+	adc_scan_result = 0;
+	
+	/* Single Conversion mode, no ADATE and no ADSC. Conversion starts
+	 * when adc_idle() enters ADC Noise Reduction sleep, ADMUX is written
+	 * one conversion ahead like with a timer. */
+	ADCSRA = (1<<ADEN) | (1<<ADIF) | (1<<ADIE) | ADC_ADPS;
+#else
+	adc_scan_result = 0;
+	
+	/* First conversion waits for the first compare match */
+	ADCSRA = (1<<ADEN) | (1<<ADATE) | (1<<ADIF) | (1<<ADIE) | ADC_ADPS;
+	adc_rate_hz = F_CPU / ADC_TIMER_PRESCALER / (ADC_TIMER_TOP + 1);
+	adc_timer_set(ADC_TIMER_CS, ADC_TIMER_TOP);
+#endif
+	return steps;
+}
+
+/************************************************************************/
+/* Returns samples per second of each input after oversampling, rounded */
+/* down                                                                 */
+/************************************************************************/
+uint16_t adc_frame_rate()
+{
+#if !ADC_TIMER_TRIGGER
+	return ADC_SAMPLE_HZ / adc_scan_steps / ADC_OVERSAMPLE;
+#else
+	return adc_rate_hz / adc_scan_steps / ADC_OVERSAMPLE;
+#endif
+}
+
+/************************************************************************/
+/* Sleeps until an interrupt, normally the next conversion. With        */
+/* ADC_TRIGGER_SLEEP ADC Noise Reduction sleep starts the conversion    */
+/* and stops CPU and I/O clocks while it runs. Free Running mode and    */
+/* timer triggers convert on their own, Idle sleep only saves power.    */
+/************************************************************************/
+void adc_idle()
+{
+#if ADC_TRIGGER == ADC_TRIGGER_SLEEP
+	set_sleep_mode(SLEEP_MODE_ADC);
+#else
+	set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
+	sleep_mode();
+}
+
+#if ADC_TIMER_TRIGGER
+/************************************************************************/
+/* Changes sample rate, nearest rate the timer can make is used and     */
+/* returned. Returns 0 and keeps the old rate if hz is faster than ADC  */
+/* can convert or slower than the timer can count. Sample numbers go on */
+/* from where they were, so change rate before timing matters.          */
+/************************************************************************/
+uint16_t adc_set_rate(uint16_t hz)
+{
+	uint8_t i;
+	
+	/* triggered conversion takes 13.5 ADC clocks */
+	if(hz == 0 || hz > ADC_CLOCK_HZ * 2 / 27)
+		return 0;
+	
+	/* smallest prescaler gives the finest steps */
+	for(i=0;i<sizeof(adc_timer_prescalers)/sizeof(adc_timer_prescalers[0]);i++)
+	{
+		uint32_t clock = F_CPU / adc_timer_prescalers[i];
+		uint32_t ticks = (clock + hz / 2) / hz;
+		
+		if(ticks <= ADC_TIMER_MAX)
+		{
+			adc_rate_hz = clock / ticks;
+			adc_timer_set(i + 1, ticks - 1);
+			return adc_rate_hz;
+		}
+	}
+	return 0;
+}
+
+/************************************************************************/
+/* Returns actual sample rate in Hz, rounded down                       */
+/************************************************************************/
+uint16_t adc_rate()
+{
+	return adc_rate_hz;
+}
+#endif
+
+/************************************************************************/
+/* Stops conversions, samples in buffer can still be read               */
+/************************************************************************/
+void adc_stop()
+{
+	ADCSRA &= ~((1<<ADEN) | (1<<ADATE) | (1<<ADIE));
+#if ADC_TRIGGER == ADC_TRIGGER_TIMER1
+	TCCR1B = 0;
+#elif ADC_TRIGGER == ADC_TRIGGER_TIMER0
+	TCCR0B = 0;
+#endif
+}
+
+/************************************************************************/
+/* Returns number of samples waiting in buffer                          */
+/************************************************************************/
+uint8_t adc_available()
+{
+	return (adc_head - adc_tail) & ADC_MASK;
+}
+
+/************************************************************************/
+/* Moves reader's sample number forward and keeps its place in frame    */
+/************************************************************************/
+static void adc_advance(uint16_t count)
+{
+	adc_number += count;
+	if(adc_scan_channels > 1)
+		adc_position = (adc_position + count % adc_scan_channels) % adc_scan_channels;
+}
+
+/************************************************************************/
+/* Copies at most max_count oldest samples to samples and removes them  */
+/* from buffer. Returns number of samples copied.                       */
+/************************************************************************/
+uint8_t adc_read(uint16_t* samples, uint8_t max_count)
+{
+	uint8_t head = adc_head;
+	uint8_t tail = adc_tail;
+	uint8_t count = 0;
+	
+	while(tail != head && count < max_count)
+	{
+		samples[count++] = adc_buffer[tail];
+		tail = (tail + 1) & ADC_MASK;
+	}
+	
+	/* keep sample numbering for adc_read_stamped() */
+	if(count)
+	{
+		uint16_t last = adc_mark[(tail - 1) & ADC_MASK];
+		adc_advance(last - (uint16_t)adc_number + 1);
+	}
+	
+	/* slots are given back to the interrupt only after copying */
+	adc_tail = tail;
+	return count;
+}
+
+/************************************************************************/
+/* Like adc_read() but stops at a gap of dropped samples, so samples    */
+/* are evenly spaced. Sample number of samples[0] is stored to first.   */
+/* Next call returns the samples after the gap.                         */
+/************************************************************************/
+uint8_t adc_read_stamped(uint16_t* samples, uint8_t max_count, uint32_t* first)
+{
+	uint8_t head = adc_head;
+	uint8_t tail = adc_tail;
+	uint8_t count = 0;
+	uint16_t mark;
+	
+	if(tail == head || max_count == 0)
+		return 0;
+	
+	/* 16 bit mark is the low part of the number, distance from the 
+	 * expected number is the length of the gap */
+	mark = adc_mark[tail];
+	adc_advance(mark - (uint16_t)adc_number);
+	*first = adc_number;
+	
+	do
+	{
+		samples[count++] = adc_buffer[tail];
+		tail = (tail + 1) & ADC_MASK;
+		mark++;
+	}
+	while(tail != head && count < max_count && adc_mark[tail] == mark);
+	
+	adc_advance(count);
+	adc_tail = tail;
+	return count;
+}
+
+/************************************************************************/
+/* Copies the oldest complete frame of adc_scan(), one sample of each   */
+/* input in order. Sample number of frame[0] is stored to first. Parts  */
+/* of frames around a gap of dropped samples are thrown away. Returns 1 */
+/* if frame was read and 0 if no complete frame is waiting.             */
+/************************************************************************/
+uint8_t adc_read_frame(uint16_t* frame, uint32_t* first)
+{
+	uint8_t head = adc_head;
+	uint8_t tail = adc_tail;
+	uint8_t channels = adc_scan_channels;
+	uint8_t i;
+	uint16_t mark;
+	
+	while(((head - tail) & ADC_MASK) >= channels)
+	{
+		mark = adc_mark[tail];
+		adc_advance(mark - (uint16_t)adc_number);
+		
+		/* frame starts at place 0 and continues without a gap */
+		i = 0;
+		if(adc_position == 0)
+		{
+			for(i=1;i<channels;i++)
+			{
+				if(adc_mark[(tail + i) & ADC_MASK] != (uint16_t)(mark + i))
+					break;
+			}
+			if(i == channels)
+			{
+				*first = adc_number;
+				for(i=0;i<channels;i++)
+				{
+					frame[i] = adc_buffer[tail];
+					tail = (tail + 1) & ADC_MASK;
+				}
+				adc_advance(channels);
+				adc_tail = tail;
+				return 1;
+			}
+		}
+		
+		/* skip to the gap, or one sample at a time to the next frame */
+		if(i == 0)
+			i = 1;
+		tail = (tail + i) & ADC_MASK;
+		adc_advance(i);
+		adc_tail = tail;
+	}
+	return 0;
+}
+
+/************************************************************************/
+/* Returns number of samples lost because buffer was full               */
+/************************************************************************/
+uint16_t adc_overruns()
+{
+	uint8_t sreg = SREG;
+	uint16_t count;
+	
+	/* 16 bit value is read in two parts, interrupt must not change it
+	 * in between */
+	cli();
+	count = adc_overrun_count;
+	SREG = sreg;
+	return count;
+}
+
+/************************************************************************/
+/* Conversion complete, store the sample                                */
+/************************************************************************/
+ISR(ADC_vect)
+{
+	uint16_t value = ADC;
+	uint16_t sequence;
+	uint8_t head, next;
+#if ADC_OVERSAMPLE_BITS
+	uint8_t place = 0;
+#endif
+	
+	/* Nothing clears the compare flag when its own interrupt is off. 
+	 * Next conversion starts only on a rising edge of the flag. */
+#if ADC_TRIGGER == ADC_TRIGGER_TIMER1
+	TIFR1 = (1<<OCF1B);
+#elif ADC_TRIGGER == ADC_TRIGGER_TIMER0
+	TIFR0 = (1<<OCF0A);
+#endif
+	
+	if(adc_scan_steps > 1)
+	{
+		uint8_t step = adc_scan_result;
+		uint8_t mux = adc_scan_mux;
+		
+		/* conversion running now already has its input, this one is
+		 * for the next conversion to start */
+		adc_select(adc_scan_input[mux]);
+		adc_scan_mux = mux + 1 == adc_scan_steps ? 0 : mux + 1;
+		
+		/* 0xFF + 1 is step 0 */
+		adc_scan_result = (uint8_t)(step + 1) == adc_scan_steps ? 0 : step + 1;
+		if(step == 0xFF || !adc_scan_store[step])
+			return;
+#if ADC_OVERSAMPLE_BITS
+		place = adc_scan_store[step] - 1;
+#endif
+	}
+	
+#if ADC_OVERSAMPLE_BITS
+	/* Every input is summed once per frame. Last frame of the round 
+	 * gives the sample and clears the sum. */
+	{
+		adc_sum_t sum = adc_sum[place] + value;
+		uint8_t last = place == adc_scan_channels - 1;
+		
+		if(adc_round != ADC_OVERSAMPLE - 1)
+		{
+			adc_sum[place] = sum;
+			if(last)
+				adc_round++;
+			return;
+		}
+		adc_sum[place] = 0;
+		if(last)
+			adc_round = 0;
+		value = sum >> ADC_OVERSAMPLE_BITS;
+	}
+#endif
+	
+	sequence = adc_sequence;
+	head = adc_head;
+	next = (head + 1) & ADC_MASK;
+	adc_sequence = sequence + 1;
+	if(next == adc_tail)
+	{
+		if(adc_overrun_count != 0xFFFF)
+			adc_overrun_count++;
+		return;
+	}
+	
+	adc_buffer[head] = value;
+	adc_mark[head] = sequence;
+	adc_head = next;
+}
@@ -0,0 +1,321 @@
+/*
+ * adc.h
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of Analog to Digital converter 
+ * for ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Analog to Digital converter, continuous acquisition (adc.h and adc.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * ADC runs in Free Running mode: ADATE bit with trigger source 0 starts a
+ * new conversion as soon as the previous one is done, 13 ADC clocks apart
+ * without software in between, so samples have no interrupt latency 
+ * jitter. ADC_vect only stores the 10 bit result to a ring buffer. Main 
+ * loop takes samples in blocks with adc_read().
+ *
+ * For a chosen sample rate define ADC_TRIGGER as ADC_TRIGGER_TIMER1 or
+ * ADC_TRIGGER_TIMER0. Timer runs in CTC mode and its compare match starts
+ * the conversion in hardware, so the rate is as exact as the crystal and
+ * no code runs to start a sample. Rate is ADC_RATE_HZ at start and can be
+ * changed with adc_set_rate(). Conversion starts at the next ADC clock 
+ * edge after the compare match, so keep F_CPU / rate a multiple of 
+ * ADC_PRESCALER for exactly equal spacing (1 kHz at 16 MHz is, 256 Hz is
+ * not and wanders by one ADC clock, 8 us).
+ *
+ *	ADC_TRIGGER_TIMER1: Timer1 compare B, TOP in ICR1. Timer1 is reserved,
+ *		so build liquid_refresh.c with LQ_REFRESH_TIMER 3.
+ *	ADC_TRIGGER_TIMER0: Timer0 compare A, rates down to F_CPU / 262144.
+ *		Timer0 is reserved, so liquid_async.c can not be used.
+ *
+ * ADC_TRIGGER_SLEEP uses the ADC Noise Reduction mode of the datasheet:
+ * ADC is in Single Conversion mode and every adc_idle() starts one 
+ * conversion by entering ADC Noise Reduction sleep. CPU and I/O clocks 
+ * are stopped during the conversion, so the conversion does not see their
+ * noise. ADC_vect wakes the CPU. Sample rate is how often main loop calls
+ * adc_idle(), at most ADC_SAMPLE_HZ. Timers stop in this sleep, so timer
+ * interrupts and liquid_refresh.c or liquid_async.c are late while it 
+ * sleeps. Interrupts must be enabled. Another interrupt may wake the CPU
+ * first, the conversion then completes while the CPU runs.
+ *
+ * Every sample gets a sample number, counted from adc_start() and 
+ * including dropped samples. adc_read_stamped() returns a block of 
+ * samples without gaps and the number of its first sample, so time of
+ * sample i in block is (first + i) / rate seconds. Samples are numbered 
+ * with 16 bits in the buffer, so reader must not fall more than 65535
+ * samples behind or the gap is measured wrong.
+ *
+ * adc_scan() converts several inputs in turn, one conversion and one
+ * interrupt per sample. Inputs are ADC_INPUT() values with own reference
+ * and MUX5:0 channel. Samples go to the ring interleaved in frames of one
+ * sample per input, adc_read_frame() takes one complete frame. ADC_vect 
+ * selects the next input while a conversion is running. In Free Running
+ * mode the following conversion has already started with the old input,
+ * so ADMUX is written two conversions ahead, with a timer trigger one.
+ * A conversion after a change of reference, or to or from a differential
+ * or internal input (gain stage, bandgap), is made twice and the first
+ * result is discarded. Other inputs are taken without extra conversion.
+ * adc_frame_rate() tells samples per second of each input.
+ *
+ * ADC_OVERSAMPLE_BITS n adds n bits of resolution. ADC_vect sums 4^n
+ * conversions of each input and stores the sum shifted right by n, so 
+ * ring gets one 10 + n bit sample per 4^n conversions and main loop 
+ * handles only those. This works only when the input has noise of about
+ * one LSB or more, a clean signal gives the same 10 bits back. Add analog
+ * dither to the input if it is too quiet. Only ADC_TRIGGER_SLEEP keeps 
+ * noise of the CPU itself out of the conversions. n is 0..6, 
+ * sums are 16 bit up to n 3 and 32 bit above. At 16 MHz n 2 gives 
+ * 12 bits at 601 Hz and n 3 13 bits at 150 Hz in Free Running mode.
+ *
+ * Ring buffer has one writer (interrupt) and one reader (main loop). Both
+ * indexes are bytes, each written by one side only, so no locking is 
+ * needed. When buffer is full new samples are dropped and counted, see 
+ * adc_overruns(). Sampling is gap free as long as main loop reads faster
+ * than ADC_SAMPLE_HZ on average, buffer holds ADC_BUFFER_SIZE - 1 samples
+ * of slack.
+ *
+ * Add adc.c to project to use this, it reserves ADC_vect.
+ *
+ * usage:
+ *
+ *	uint16_t block[16];
+ *	uint8_t i, count;
+ *
+ *	adc_start(0);	// ADC0, PF0
+ *	sei();
+ *
+ *	while(1)
+ *	{
+ *		count = adc_read(block, 16);
+ *		for(i=0;i<count;i++)
+ *			process(block[i]);	// 0..1023
+ *
+ *		if(adc_overruns())
+ *			warn();
+ *	}
+ *
+ * timestamped blocks with ADC_TRIGGER ADC_TRIGGER_TIMER1:
+ *
+ *	uint32_t first;
+ *
+ *	adc_start(0);
+ *	adc_set_rate(256);	// default is ADC_RATE_HZ
+ *	sei();
+ *
+ *	while(1)
+ *	{
+ *		count = adc_read_stamped(block, 16, &first);
+ *		if(count)
+ *			filter(block, count, first);	// first / 256 seconds
+ *	}
+ *
+ * four inputs, bandgap costs extra conversions when switched in and out:
+ *
+ *	static const uint8_t inputs[] = { ADC_INPUT(0), ADC_INPUT(1),
+ *		ADC_INPUT(4), ADC_INPUT(ADC_BANDGAP) };
+ *	uint16_t frame[4];
+ *
+ *	adc_scan(inputs, 4);	// 6 conversions per frame
+ *	sei();
+ *
+ *	while(1)
+ *	{
+ *		if(adc_read_frame(frame, &first))
+ *			show(frame);	// frame number is first / 4
+ *		else
+ *			adc_idle();
+ *	}
+ */
+
+#ifndef ADC_H
+#define ADC_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#ifndef F_CPU
+# error "F_CPU must be defined for ADC prescaler"
+#endif
+
+/* Samples in ring buffer, power of two and at most 256. */
+#ifndef ADC_BUFFER_SIZE
+#define ADC_BUFFER_SIZE 64
+#endif
+
+/* Highest ADC clock for full 10 bit resolution, datasheet section 
+ * "Prescaling and Conversion Timing": 50 kHz..200 kHz. Prescaler is the
+ * smallest one which gives at most this.
+ */
+#ifndef ADC_CLOCK_MAX_HZ
+#define ADC_CLOCK_MAX_HZ 200000UL
+#endif
+
+/* Reference voltage bits of ADMUX, AVCC with capacitor at AREF */
+#ifndef ADC_REFERENCE
+#define ADC_REFERENCE (1<<REFS0)
+#endif
+
+/* Extra bits of resolution by oversampling, 0 is off */
+#ifndef ADC_OVERSAMPLE_BITS
+#define ADC_OVERSAMPLE_BITS 0
+#endif
+
+#if ADC_OVERSAMPLE_BITS < 0 || ADC_OVERSAMPLE_BITS > 6
+# error "ADC_OVERSAMPLE_BITS must be 0..6"
+#endif
+
+/* conversions summed for one sample and bits of the sample */
+#define ADC_OVERSAMPLE (1U << (2 * ADC_OVERSAMPLE_BITS))
+#define ADC_RESULT_BITS (10 + ADC_OVERSAMPLE_BITS)
+
+/* Most inputs adc_scan() takes in one sequence */
+#ifndef ADC_SCAN_MAX
+#define ADC_SCAN_MAX 8
+#endif
+
+/* Input of adc_scan(), REFS1:0 in bits 7:6 like in ADMUX and MUX5:0 of
+ * datasheet Table 24-4 in bits 5:0. ADC_BANDGAP is 1.1 V bandgap and 
+ * ADC_TEMPERATURE temperature sensor, which needs the 2.56 V reference. */
+#define ADC_INPUT_REF(channel, reference) ((reference) | ((channel) & 0x3F))
+#define ADC_INPUT(channel) ADC_INPUT_REF(channel, ADC_REFERENCE)
+#define ADC_BANDGAP 0x1E
+#define ADC_TEMPERATURE 0x27
+#define ADC_REFERENCE_2V56 ((1<<REFS1) | (1<<REFS0))
+
+/* ADC prescaler and its ADPS bits, datasheet Table 24-5. ADC Prescaler 
+ * Selections */
+#if F_CPU / 2 <= ADC_CLOCK_MAX_HZ
+# define ADC_PRESCALER 2
+# define ADC_ADPS (1<<ADPS0)
+#elif F_CPU / 4 <= ADC_CLOCK_MAX_HZ
+# define ADC_PRESCALER 4
+# define ADC_ADPS (1<<ADPS1)
+#elif F_CPU / 8 <= ADC_CLOCK_MAX_HZ
+# define ADC_PRESCALER 8
+# define ADC_ADPS ((1<<ADPS1) | (1<<ADPS0))
+#elif F_CPU / 16 <= ADC_CLOCK_MAX_HZ
+# define ADC_PRESCALER 16
+# define ADC_ADPS (1<<ADPS2)
+#elif F_CPU / 32 <= ADC_CLOCK_MAX_HZ
+# define ADC_PRESCALER 32
+# define ADC_ADPS ((1<<ADPS2) | (1<<ADPS0))
+#elif F_CPU / 64 <= ADC_CLOCK_MAX_HZ
+# define ADC_PRESCALER 64
+# define ADC_ADPS ((1<<ADPS2) | (1<<ADPS1))
+#else
+# define ADC_PRESCALER 128
+# define ADC_ADPS ((1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0))
+#endif
+
+/* Conversion start, values are ADTS3:0 of datasheet Table 24-6. ADC
+ * Auto Trigger Source Selection. ADC_TRIGGER_SLEEP is not auto trigger,
+ * adc_idle() starts each conversion. */
+#define ADC_TRIGGER_FREE_RUNNING 0
+#define ADC_TRIGGER_TIMER0 3
+#define ADC_TRIGGER_TIMER1 5
+#define ADC_TRIGGER_SLEEP 0x10
+
+#ifndef ADC_TRIGGER
+#define ADC_TRIGGER ADC_TRIGGER_FREE_RUNNING
+#endif
+
+/* ADTS3:0 bits for ADCSRB and 1 when a timer triggers conversions */
+#if ADC_TRIGGER == ADC_TRIGGER_SLEEP
+# define ADC_ADTS 0
+#else
+# define ADC_ADTS ADC_TRIGGER
+#endif
+#define ADC_TIMER_TRIGGER (ADC_TRIGGER == ADC_TRIGGER_TIMER0 || ADC_TRIGGER == ADC_TRIGGER_TIMER1)
+
+/* Sample rate at adc_start() when a timer triggers conversions */
+#ifndef ADC_RATE_HZ
+#define ADC_RATE_HZ 1000UL
+#endif
+
+/* ADC clock and samples per second in Free Running mode, 13 ADC clocks 
+ * per conversion. At 16 MHz prescaler is 128, ADC clock 125 kHz and 
+ * 9615 samples per second. ADC_TRIGGER_SLEEP gets at most this. */
+#define ADC_CLOCK_HZ (F_CPU / ADC_PRESCALER)
+
+#if ADC_TRIGGER == ADC_TRIGGER_FREE_RUNNING || ADC_TRIGGER == ADC_TRIGGER_SLEEP
+# define ADC_SAMPLE_HZ (ADC_CLOCK_HZ / 13)
+#elif ADC_TIMER_TRIGGER
+# define ADC_SAMPLE_HZ ADC_RATE_HZ
+/* Triggered conversion takes 13.5 ADC clocks, trigger must be slower */
+# if ADC_RATE_HZ > ADC_CLOCK_HZ * 2 / 27
+#  error "ADC_RATE_HZ is faster than ADC can convert"
+# endif
+/* Timer prescaler and TOP, datasheet Table 14-6. Clock Select Bit 
+ * Description. Same CS bit values are used for Timer0 and Timer1, 
+ * ADC_TIMER_CS is the value of CSn2:0. */
+# if ADC_TRIGGER == ADC_TRIGGER_TIMER1
+#  define ADC_TIMER_MAX 65536UL
+# else
+#  define ADC_TIMER_MAX 256UL
+# endif
+# if F_CPU / ADC_RATE_HZ < ADC_TIMER_MAX
+#  define ADC_TIMER_PRESCALER 1
+#  define ADC_TIMER_CS 1
+# elif F_CPU / 8 / ADC_RATE_HZ < ADC_TIMER_MAX
+#  define ADC_TIMER_PRESCALER 8
+#  define ADC_TIMER_CS 2
+# elif F_CPU / 64 / ADC_RATE_HZ < ADC_TIMER_MAX
+#  define ADC_TIMER_PRESCALER 64
+#  define ADC_TIMER_CS 3
+# elif F_CPU / 256 / ADC_RATE_HZ < ADC_TIMER_MAX
+#  define ADC_TIMER_PRESCALER 256
+#  define ADC_TIMER_CS 4
+# elif F_CPU / 1024 / ADC_RATE_HZ < ADC_TIMER_MAX
+#  define ADC_TIMER_PRESCALER 1024
+#  define ADC_TIMER_CS 5
+# else
+#  error "ADC_RATE_HZ is too slow for the trigger timer"
+# endif
+/* counter counts 0..TOP, rounded to the nearest rate */
+# define ADC_TIMER_TOP ((F_CPU / ADC_TIMER_PRESCALER + ADC_RATE_HZ / 2) / ADC_RATE_HZ - 1)
+#else
+# error "ADC_TRIGGER must be ADC_TRIGGER_FREE_RUNNING, ADC_TRIGGER_TIMER0, ADC_TRIGGER_TIMER1 or ADC_TRIGGER_SLEEP"
+#endif
+
+/* samples per second to ring with one input, after oversampling */
+#define ADC_OUTPUT_HZ (ADC_SAMPLE_HZ / ADC_OVERSAMPLE)
+
+extern void adc_start(uint8_t channel);
+
+extern void adc_stop();
+
+extern uint8_t adc_available();
+
+extern uint8_t adc_read(uint16_t* samples, uint8_t max_count);
+
+extern uint16_t adc_overruns();
+
+extern uint8_t adc_read_stamped(uint16_t* samples, uint8_t max_count, uint32_t* first);
+
+extern uint8_t adc_scan(const uint8_t* inputs, uint8_t count);
+
+extern uint8_t adc_read_frame(uint16_t* frame, uint32_t* first);
+
+extern uint16_t adc_frame_rate();
+
+extern void adc_idle();
+
+#if ADC_TIMER_TRIGGER
+extern uint16_t adc_set_rate(uint16_t hz);
+
+extern uint16_t adc_rate();
+#endif
+
+#endif /* ADC_H */
@@ -30,6 +30,11 @@
  
  * This example converts analog voltage to digital and puts result to port b.
  * in ATmega 16/32U4 Port F serves as analog inputs to the A/D Converter.
+ * Conversions run continuously in Free Running mode (adc.c), here the main 
+ * loop takes the samples in blocks and averages 20 ms of them. Samples are
+ * 10 bit, or ADC_RESULT_BITS when adc.c is built with ADC_OVERSAMPLE_BITS.
+ * Result is shown also on LCD as a bar graph on the first row and as a 
+ * sparkline of the last 20 results on the second row (liquid_widget.c).
  *-----------------------------------------------------------------------------
  */
 
@@ -37,73 +42,79 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <stdlib.h>
+#include "adc.h"
+#include "liquid.h"
+
+/* samples averaged for one result, 20 ms */
+#if ADC_OUTPUT_HZ >= 50
+# define ADC_EXAMPLE_AVERAGE (ADC_OUTPUT_HZ / 50)
+#else
+# define ADC_EXAMPLE_AVERAGE 1
+#endif
 
 int adc_example()
 {
 	/* set port b to output */
 	DDRB = 0xFF;
 	
-	/* 8-bit or 10-bit results. we choose 10-bit.
-	 * This will be set with ADC Multiplexer Selection Register.
-	 * ADMUX Bit 5  ADLAR: ADC Left Adjust Result. The ADLAR bit affects the presentation 
-	 * of the ADC conversion result in the ADC Data Register. Write one to ADLAR to left 
-	 * adjust the result. Otherwise, the result is right adjusted.
-	 * from Table 24-4. Input Channel and Gain Selections can be seen that ADC0 channel is 
-	 * selected by default and we use that now, ADC0 is PF0.
-	 */
-	ADMUX |=(1<<ADLAR);
-	
-	/* Sets highest voltage limit capacitor in a AREF-pin for filtering noise. 
-	 * We choose REFS0. AVCC=5V with external capacitor at AREF pin. 
-	 */
-	ADMUX |=(1<<REFS0);
-
-	/* Enable interrupts function in ADC */
-	ADCSRA |=(1<<ADIE);
-
-	/* because ADC is rather slow, we use prescaler determined by the internal/external 
-	 * clock to set sample rate for ADC converter. By default, the successive approximation 
-	 * circuitry requires an input clock frequency between 50kHz and 200 kHz to get 
-	 * maximum resolution. If a lower resolution than 10 bits is needed, the input clock 
-	 * frequency to the ADC can be higher than 200 kHz to get a higher sample rate.
-	 * For instance if we have 1MHz crystal we calculate desired prescaler:
-	 * 1 000 000/50 000 = 20, 1 000 000/200 000 = 5. Therefore we have to choose prescaler
-	 * between 5...20. We choose 16, datasheet Table 24-5. ADC Prescaler Selections.
-	 * Sample rate is then 1 000 000/16 = 62500 (62,5kHz). 
-	 */
-	ADCSRA |= (1<<ADPS2);
-	
-	/* Turn on the ADC feature. Bit 7  ADEN: ADC Enable
-	 * Writing this bit to one enables the ADC. By writing it to zero, the ADC is turned off.
+	/* Continuous conversions of ADC0, PF0. adc_start() sets right 
+	 * adjusted 10 bit results, AVCC reference, the prescaler for highest
+	 * sample rate with full resolution and Free Running mode. See adc.c.
 	 */
-	ADCSRA |= (1<<ADEN);
+	adc_start(0);
 	
 	// enable global interrupt
 	sei();
-		
-	/* start conversion. Bit 6  ADSC: ADC Start Conversion. */
-	ADCSRA |=(1<<ADSC);
-
-	while(1) {}
 	
-}
-
+	/* LCD on command and data ports of liquid.h, port b is left for result */
+	lq_port_configuration();
+	lq_init();
 	
-/* interrupt from ADC */
-ISR(ADC_vect)
-{
-	/* Read the conversion result. The ADC Data Register  ADCL and ADCH.
-	 * Because we chosen to use 10 bits we are reading from ADCH 
-	 * Here we can do something with adc_result.
-	 * for example writing to LCD
-	 * char adc_result[4];
-	 * itoa(ADCH,adc_result,10);
-	 * send_to_lcd(adc_result);
-	 */
+	/* ring of sparkline samples, four cells of five samples */
+	uint8_t samples[4 * LQ_BAR_STEPS] = { 0 };
+	uint8_t newest = 0;
+	
+	uint16_t block[16];
+	uint32_t sum = 0;
+	uint16_t summed = 0;
+	uint8_t i, count;
 	
-	/* write analog-to-digital conversion directly to the port b */
-	PORTB = ADCH;
+	while(1)
+	{
+		/* all samples are used, ring buffer of adc.c holds about 6 ms of
+		 * them while LCD is written */
+		count = adc_read(block, 16);
+		if(count == 0)
+		{
+			/* wait for the next sample, with ADC_TRIGGER_SLEEP this 
+			 * starts its conversion */
+			adc_idle();
+			continue;
+		}
+		for(i=0;i<count;i++)
+			sum += block[i];
+		summed += count;
+		if(summed < ADC_EXAMPLE_AVERAGE)
+			continue;
+		
+		uint16_t value = sum / summed;
+		sum = 0;
+		summed = 0;
+		
+		/* write upper 8 bits directly to the port b */
+		PORTB = value >> (ADC_RESULT_BITS - 8);
+		
+		/* full scale to 80 levels of a 16 cell bar */
+		lq_bar(0, 0, 16, lq_bar_scale(value, ADC_RESULT_BITS, 16));
+		
+		/* sparkline dots have heights 0..7 */
+		newest = newest == sizeof(samples) - 1 ? 0 : newest + 1;
+		samples[newest] = value >> (ADC_RESULT_BITS - 3);
+		lq_sparkline(1, 12, 4, 4, samples, newest);
+		
+		/* only changed cells and glyph rows are written, a step of the 
+		 * bar costs two or three writes */
+		lq_flush();
+	}
 	
-	/* restart conversion. */
-	ADCSRA |=(1<<ADSC);
 }
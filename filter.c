@@ -0,0 +1,270 @@
+/*
+ * filter.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of fixed point digital filters
+ * for ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Fixed point filters, biquad cascade and FIR (filter.h and filter.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * See filter.h for usage.
+ */
+
+#include "filter.h"
+#include "adc.h"
+
+#if ADC_RESULT_BITS > 16
+# error "filter_from_adc() takes at most 16 bit samples"
+#endif
+
+/* part of biquad sum below one LSB of output */
+#define FILTER_FRACTION_MASK 0x3FFF
+
+/************************************************************************/
+/* acc + a * b. avr-gcc would call __mulhisi3 and add after, here four  */
+/* 8x8 bit multiplies go straight to the sum (Atmel AVR201), 24 cycles. */
+/************************************************************************/
+static inline int32_t filter_mac(int32_t acc, int16_t a, int16_t b)
+{
+#if defined(__AVR__) && defined(__AVR_HAVE_MUL__)
+	uint8_t zero;
+	
+	/* MULSU sets carry from the sign of its 16 bit result, SBC adds 
+	 * 0xFF to the top byte for a negative one. MUL clobbers r1, which is
+	 * zero register of the compiler. */
+	__asm__ (
+		"clr	%[zero]"			"\n\t"
+		"muls	%B[a], %B[b]"		"\n\t"
+		"add	%C[acc], r0"		"\n\t"
+		"adc	%D[acc], r1"		"\n\t"
+		"mul	%A[a], %A[b]"		"\n\t"
+		"add	%A[acc], r0"		"\n\t"
+		"adc	%B[acc], r1"		"\n\t"
+		"adc	%C[acc], %[zero]"	"\n\t"
+		"adc	%D[acc], %[zero]"	"\n\t"
+		"mulsu	%B[a], %A[b]"		"\n\t"
+		"sbc	%D[acc], %[zero]"	"\n\t"
+		"add	%B[acc], r0"		"\n\t"
+		"adc	%C[acc], r1"		"\n\t"
+		"adc	%D[acc], %[zero]"	"\n\t"
+		"mulsu	%B[b], %A[a]"		"\n\t"
+		"sbc	%D[acc], %[zero]"	"\n\t"
+		"add	%B[acc], r0"		"\n\t"
+		"adc	%C[acc], r1"		"\n\t"
+		"adc	%D[acc], %[zero]"	"\n\t"
+		"clr	__zero_reg__"
+		: [acc] "+r" (acc), [zero] "=&r" (zero)
+		: [a] "a" (a), [b] "a" (b)
+	);
+	return acc;
+#else
+	return acc + (int32_t)a * b;
+#endif
+}
+
+/************************************************************************/
+/* Limits sum to 16 bits                                                */
+/************************************************************************/
+static inline int16_t filter_saturate(int32_t value)
+{
+	if(value > 32767)
+		return 32767;
+	if(value < -32768)
+		return -32768;
+	return value;
+}
+
+/************************************************************************/
+/* Sets up cascade of stages biquads, state has one slot for each       */
+/************************************************************************/
+void filter_biquad_init(filter_biquad_t* filter, const filter_biquad_coef_t* coef,
+						filter_biquad_state_t* state, uint8_t stages)
+{
+	uint8_t i;
+	
+	filter->coef = coef;
+	filter->state = state;
+	filter->stages = stages;
+	for(i=0;i<stages;i++)
+	{
+		state[i].x1 = 0;
+		state[i].x2 = 0;
+		state[i].y1 = 0;
+		state[i].y2 = 0;
+		state[i].error = 0;
+	}
+}
+
+/************************************************************************/
+/* Filters count samples in place, whole block through one stage before */
+/* the next                                                             */
+/************************************************************************/
+void filter_biquad_block(filter_biquad_t* filter, int16_t* samples, uint8_t count)
+{
+	const filter_biquad_coef_t* coef = filter->coef;
+	filter_biquad_state_t* state = filter->state;
+	uint8_t stage, i;
+	
+	for(stage=0;stage<filter->stages;stage++,coef++,state++)
+	{
+		/* locals so that compiler keeps them in registers over block */
+		int16_t b0 = coef->b0, b1 = coef->b1, b2 = coef->b2;
+		int16_t a1 = coef->a1, a2 = coef->a2;
+		int16_t x1 = state->x1, x2 = state->x2;
+		int16_t y1 = state->y1, y2 = state->y2;
+		uint16_t error = state->error;
+		
+		for(i=0;i<count;i++)
+		{
+			int16_t x = samples[i];
+			int32_t acc = error;
+			
+			acc = filter_mac(acc, b0, x);
+			acc = filter_mac(acc, b1, x1);
+			acc = filter_mac(acc, b2, x2);
+			acc = filter_mac(acc, a1, y1);
+			acc = filter_mac(acc, a2, y2);
+			
+			/* arithmetic shift rounds down, what is left over is always 
+			 * positive and goes to the next sample */
+			error = acc & FILTER_FRACTION_MASK;
+			x2 = x1;
+			x1 = x;
+			y2 = y1;
+			y1 = filter_saturate(acc >> 14);
+			samples[i] = y1;
+		}
+		
+		state->x1 = x1;
+		state->x2 = x2;
+		state->y1 = y1;
+		state->y2 = y2;
+		state->error = error;
+	}
+}
+
+/************************************************************************/
+/* Filters one sample                                                   */
+/************************************************************************/
+int16_t filter_biquad(filter_biquad_t* filter, int16_t sample)
+{
+	filter_biquad_block(filter, &sample, 1);
+	return sample;
+}
+
+/************************************************************************/
+/* Sets up FIR of 1..127 taps, delay has room for 2 * taps samples      */
+/************************************************************************/
+void filter_fir_init(filter_fir_t* filter, const int16_t* coef, int16_t* delay, uint8_t taps)
+{
+	uint8_t i;
+	
+	filter->coef = coef;
+	filter->delay = delay;
+	filter->taps = taps;
+	filter->head = 0;
+	for(i=0;i<2*taps;i++)
+		delay[i] = 0;
+}
+
+/************************************************************************/
+/* Filters count samples in place                                       */
+/************************************************************************/
+void filter_fir_block(filter_fir_t* filter, int16_t* samples, uint8_t count)
+{
+	uint8_t taps = filter->taps;
+	uint8_t head = filter->head;
+	int16_t* delay = filter->delay;
+	uint8_t i, k;
+	
+	for(i=0;i<count;i++)
+	{
+		const int16_t* h = filter->coef;
+		const int16_t* newest;
+		const int16_t* oldest;
+		int32_t acc = 1L << 14;
+		
+		/* Newest sample goes before the previous one, and also taps 
+		 * later so that window head..head + taps - 1 never wraps */
+		head = head == 0 ? taps - 1 : head - 1;
+		delay[head] = samples[i];
+		delay[head + taps] = samples[i];
+		
+		/* samples at the same distance from both ends share coefficient, 
+		 * inputs in -0.5..0.5 make the sum fit to 16 bits */
+		newest = &delay[head];
+		oldest = newest + taps - 1;
+		for(k=taps>>1;k>0;k--)
+			acc = filter_mac(acc, *h++, *newest++ + *oldest--);
+		if(taps & 1)
+			acc = filter_mac(acc, *h, *newest);
+		
+		samples[i] = filter_saturate(acc >> 15);
+	}
+	filter->head = head;
+}
+
+/************************************************************************/
+/* Filters one sample                                                   */
+/************************************************************************/
+int16_t filter_fir(filter_fir_t* filter, int16_t sample)
+{
+	filter_fir_block(filter, &sample, 1);
+	return sample;
+}
+
+/************************************************************************/
+/* ADC_RESULT_BITS samples of adc.c to Q15 -0.5..0.5, 16 bit samples    */
+/* lose their lowest bit. samples and adc can be the same buffer.       */
+/************************************************************************/
+void filter_from_adc(int16_t* samples, const uint16_t* adc, uint8_t count)
+{
+	uint8_t i;
+	
+	for(i=0;i<count;i++)
+	{
+#if ADC_RESULT_BITS == 16
+		uint16_t value = adc[i] >> 1;
+#else
+		uint16_t value = adc[i] << (15 - ADC_RESULT_BITS);
+#endif
+		samples[i] = (int16_t)value - 0x4000;
+	}
+}
+
+/************************************************************************/
+/* Q15 back to ADC_RESULT_BITS range of adc.c, limited to it, for       */
+/* display. adc and samples can be the same buffer.                     */
+/************************************************************************/
+void filter_to_adc(uint16_t* adc, const int16_t* samples, uint8_t count)
+{
+	uint8_t i;
+	
+	for(i=0;i<count;i++)
+	{
+		int16_t value = samples[i];
+		
+		if(value < -0x4000)
+			value = -0x4000;
+		if(value > 0x3FFF)
+			value = 0x3FFF;
+#if ADC_RESULT_BITS == 16
+		adc[i] = (uint16_t)(value + 0x4000) << 1;
+#else
+		adc[i] = (uint16_t)(value + 0x4000) >> (15 - ADC_RESULT_BITS);
+#endif
+	}
+}
@@ -0,0 +1,159 @@
+/*
+ * filter.h
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of fixed point digital filters
+ * for ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Fixed point filters, biquad cascade and FIR (filter.h and filter.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * AVR has no floating point unit, a float multiply and add is a library
+ * call of about 150 cycles. These filters use 16 bit samples and 
+ * coefficients with 32 bit sums. MUL, MULS and MULSU instructions make
+ * one 16x16 bit signed multiply and add to 32 bits in 24 cycles,
+ * see filter_mac() in filter.c.
+ *
+ * Samples are Q15, -32768..32767 is -1.0..1.0. filter_from_adc() turns
+ * adc.c samples to -0.5..0.5, which leaves room for gain of the filter
+ * and for folded sums of FIR.
+ *
+ * Biquad is Direct Form I, y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2. 
+ * Coefficients are Q14 (-2.0..2.0) because a1 of a low frequency filter
+ * is near -2. FILTER_BIQUAD() makes them from floating point constants,
+ * a0 is 1 and a1 and a2 are stored negated so every step is an add. Part
+ * of the sum below one LSB is carried to the next sample of the stage,
+ * so rounding errors do not build up in filters with poles near 1.
+ * Higher order filters are cascades of biquads.
+ *
+ * FIR has odd or even number of symmetric taps, h[k] == h[taps - 1 - k],
+ * and only the first half (taps + 1) / 2 of coefficients is given. Two 
+ * samples having the same coefficient are added before multiplying, so
+ * 31 taps cost 16 multiplies. Delay line is twice the taps so that the
+ * window is always in one piece.
+ *
+ * Block functions filter samples in place, biquad one stage at a time 
+ * over the whole block so that coefficients stay in registers. Cycles
+ * per sample are estimates counted from the instructions of filter_mac()
+ * with a guess for loads, stores and loop overhead of the compiler:
+ *
+ *	biquad stage		~FILTER_BIQUAD_CYCLES (200)
+ *	FIR			~FILTER_FIR_CYCLES(taps), 31 taps ~700
+ *
+ * filter_example.c measures them with Timer1 on the target. Define
+ * FILTER_BIQUAD_CYCLES and FILTER_FIR_CYCLES(taps) with the measured 
+ * values when they differ, host/filterbench.c uses them for its channel
+ * counts.
+ *
+ * Run host/filterbench.c to compare to floating point and to see how 
+ * many channels fit to F_CPU at a sample rate. It also checks a byte by
+ * byte model of filter_mac() against a C multiply.
+ *
+ * usage, 50 Hz notch and 40 Hz low-pass at 1 kHz sample rate:
+ *
+ *	static const filter_biquad_coef_t coef[2] = {
+ *		{ 15893, -30230, 15893, 30230, -15402 },	// notch 50 Hz, Q 5
+ *		{ 219, 438, 219, 26992, -11483 }		// low-pass 40 Hz, Q 0.71
+ *	};
+ *	filter_biquad_state_t state[2];
+ *	filter_biquad_t biquad;
+ *	int16_t block[16];
+ *	uint32_t first;
+ *	uint8_t count;
+ *
+ *	filter_biquad_init(&biquad, coef, state, 2);
+ *	adc_start(0);
+ *	sei();
+ *
+ *	while(1)
+ *	{
+ *		count = adc_read_stamped((uint16_t*)block, 16, &first);
+ *		filter_from_adc(block, (uint16_t*)block, count);
+ *		filter_biquad_block(&biquad, block, count);
+ *		process(block, count);
+ *	}
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+
+/* floating point constant to Q14 and Q15, rounded */
+#define FILTER_Q14(x) ((int16_t)((x) * 16384.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define FILTER_Q15(x) ((int16_t)((x) * 32768.0 + ((x) < 0 ? -0.5 : 0.5)))
+
+/* biquad coefficients from normalized floating point ones, a0 is 1 */
+#define FILTER_BIQUAD(b0, b1, b2, a1, a2) \
+	{ FILTER_Q14(b0), FILTER_Q14(b1), FILTER_Q14(b2), FILTER_Q14(-(a1)), FILTER_Q14(-(a2)) }
+
+/* estimated cycles per sample, replace with values of filter_example.c */
+#ifndef FILTER_BIQUAD_CYCLES
+#define FILTER_BIQUAD_CYCLES 200
+#endif
+
+#ifndef FILTER_FIR_CYCLES
+#define FILTER_FIR_CYCLES(taps) (60 + 40 * ((taps) / 2) + 30 * ((taps) & 1))
+#endif
+
+/* Q14, a1 and a2 negated */
+typedef struct
+{
+	int16_t b0, b1, b2;
+	int16_t a1, a2;
+} filter_biquad_coef_t;
+
+/* previous inputs and outputs, error is the fraction left from output */
+typedef struct
+{
+	int16_t x1, x2;
+	int16_t y1, y2;
+	uint16_t error;
+} filter_biquad_state_t;
+
+typedef struct
+{
+	const filter_biquad_coef_t* coef;
+	filter_biquad_state_t* state;
+	uint8_t stages;
+} filter_biquad_t;
+
+/* coef has (taps + 1) / 2 Q15 values, delay 2 * taps samples */
+typedef struct
+{
+	const int16_t* coef;
+	int16_t* delay;
+	uint8_t taps;
+	uint8_t head;
+} filter_fir_t;
+
+extern void filter_biquad_init(filter_biquad_t* filter, const filter_biquad_coef_t* coef,
+							   filter_biquad_state_t* state, uint8_t stages);
+
+extern int16_t filter_biquad(filter_biquad_t* filter, int16_t sample);
+
+extern void filter_biquad_block(filter_biquad_t* filter, int16_t* samples, uint8_t count);
+
+extern void filter_fir_init(filter_fir_t* filter, const int16_t* coef, int16_t* delay, uint8_t taps);
+
+extern int16_t filter_fir(filter_fir_t* filter, int16_t sample);
+
+extern void filter_fir_block(filter_fir_t* filter, int16_t* samples, uint8_t count);
+
+extern void filter_from_adc(int16_t* samples, const uint16_t* adc, uint8_t count);
+
+extern void filter_to_adc(uint16_t* adc, const int16_t* samples, uint8_t count);
+
+#endif /* FILTER_H */
@@ -0,0 +1,122 @@
+/*
+ * filter_example.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of fixed point digital filters
+ * for ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Cycles of fixed point filters (filter_example.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * FILTER_BIQUAD_CYCLES and FILTER_FIR_CYCLES of filter.h are estimates.
+ * This example measures them: Timer1 counts CPU cycles with prescaler 1
+ * and TCNT1 is read before and after filter_biquad_block() and
+ * filter_fir_block(). Cycles of two reads with nothing between are taken
+ * away, call of the block function and its loop are counted in. Results
+ * are shown on LCD as cycles per sample:
+ *
+ *	BQ  200 FIR  700	biquad stage, FIR of FILTER_EXAMPLE_TAPS taps
+ *	est 200      700	FILTER_BIQUAD_CYCLES and FILTER_FIR_CYCLES()
+ *
+ * Interrupts are off while measuring so that only the filter is counted.
+ * A block of 16 samples through two stages is about 6400 cycles, well
+ * below the 65536 cycles where TCNT1 would wrap.
+ *-----------------------------------------------------------------------------
+ */
+
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "filter.h"
+#include "liquid.h"
+
+#define FILTER_EXAMPLE_BLOCK 16
+#define FILTER_EXAMPLE_STAGES 2
+#define FILTER_EXAMPLE_TAPS 31
+
+/* notch 50 Hz and low-pass 40 Hz at 1 kHz, from filter.h */
+static const filter_biquad_coef_t coef[FILTER_EXAMPLE_STAGES] = {
+	{ 15893, -30230, 15893, 30230, -15402 },
+	{ 219, 438, 219, 26992, -11483 }
+};
+
+/************************************************************************/
+/* Cycles of filtering one block, less the cycles of reading TCNT1      */
+/************************************************************************/
+static uint16_t filter_example_cycles(filter_biquad_t* biquad, filter_fir_t* fir, int16_t* samples)
+{
+	uint8_t sreg = SREG;
+	uint16_t start, empty, cycles;
+
+	cli();
+	start = TCNT1;
+	empty = TCNT1 - start;
+	start = TCNT1;
+	if(biquad)
+		filter_biquad_block(biquad, samples, FILTER_EXAMPLE_BLOCK);
+	else
+		filter_fir_block(fir, samples, FILTER_EXAMPLE_BLOCK);
+	cycles = TCNT1 - start;
+	SREG = sreg;
+	return cycles - empty;
+}
+
+int filter_example()
+{
+	filter_biquad_state_t state[FILTER_EXAMPLE_STAGES];
+	filter_biquad_t biquad;
+	/* coefficient values do not change the cycles, MUL takes two always */
+	int16_t fir_coef[(FILTER_EXAMPLE_TAPS + 1) / 2];
+	int16_t fir_delay[2 * FILTER_EXAMPLE_TAPS];
+	filter_fir_t fir;
+	int16_t samples[FILTER_EXAMPLE_BLOCK];
+	uint16_t cycles;
+	uint8_t i;
+
+	for(i=0;i<sizeof(fir_coef)/sizeof(fir_coef[0]);i++)
+		fir_coef[i] = 1024;
+	filter_biquad_init(&biquad, coef, state, FILTER_EXAMPLE_STAGES);
+	filter_fir_init(&fir, fir_coef, fir_delay, FILTER_EXAMPLE_TAPS);
+
+	/* Timer1 in normal mode counts every CPU cycle, CS10 is prescaler 1 */
+	TCCR1A = 0;
+	TCCR1B = (1<<CS10);
+
+	lq_port_configuration();
+	lq_init();
+
+	while(1)
+	{
+		/* square wave of quarter of full scale, saturation is not hit */
+		for(i=0;i<FILTER_EXAMPLE_BLOCK;i++)
+			samples[i] = i & 4 ? 8192 : -8192;
+
+		lq_buffer_clear();
+		lq_buffer_write_string((BYTE*)"BQ ");
+		cycles = filter_example_cycles(&biquad, 0, samples);
+		lq_buffer_write_u16(cycles / (FILTER_EXAMPLE_BLOCK * FILTER_EXAMPLE_STAGES), 4);
+		lq_buffer_write_string((BYTE*)" FIR");
+		cycles = filter_example_cycles(0, &fir, samples);
+		lq_buffer_write_u16(cycles / FILTER_EXAMPLE_BLOCK, 5);
+
+		lq_buffer_goto(1, 0);
+		lq_buffer_write_string((BYTE*)"est");
+		lq_buffer_write_u16(FILTER_BIQUAD_CYCLES, 4);
+		lq_buffer_write_string((BYTE*)"    ");
+		lq_buffer_write_u16(FILTER_FIR_CYCLES(FILTER_EXAMPLE_TAPS), 5);
+		lq_flush();
+	}
+
+}
@@ -0,0 +1,120 @@
+/*
+ * format_example.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of HD44780 LCD library
+ * for ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Cycles of number formatting (format_example.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * liquid_format.c finds digits by subtracting powers of ten, utoa() and
+ * ultoa() of avr-libc divide by 10 with __udivmodhi4 and __udivmodsi4.
+ * This example measures both: Timer1 counts CPU cycles with prescaler 1
+ * and TCNT1 is read before and after each call. Cycles of two reads with
+ * nothing between are taken away. Average over the values below is shown
+ * on LCD, liquid_format.c first and avr-libc second:
+ *
+ *	u16   xxxx   yyyy		lq_format_u16() and utoa()
+ *	u32   xxxx   yyyy		lq_format_u32() and ultoa()
+ *
+ * Interrupts are off while measuring. One call is well below the 65536
+ * cycles where TCNT1 would wrap.
+ *-----------------------------------------------------------------------------
+ */
+
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdlib.h>
+#include "liquid.h"
+
+/* from one digit to the longest, digit 9 is the most subtractions */
+static const uint16_t values16[] = { 0, 7, 42, 512, 1023, 9999, 32768, 65535 };
+static const uint32_t values32[] = { 0, 1023, 65535, 99999, 8388608UL, 999999999UL,
+									 2147483648UL, 4294967295UL };
+
+#define FORMAT_EXAMPLE_VALUES 8
+
+/* one of the four functions measured */
+#define FORMAT_LQ_U16 0
+#define FORMAT_UTOA 1
+#define FORMAT_LQ_U32 2
+#define FORMAT_ULTOA 3
+
+/************************************************************************/
+/* Average cycles of one function over its values, less the cycles of   */
+/* reading TCNT1                                                        */
+/************************************************************************/
+static uint16_t format_example_cycles(uint8_t function)
+{
+	uint8_t sreg = SREG;
+	BYTE text[12];
+	uint16_t start, empty, cycles;
+	uint32_t sum = 0;
+	uint8_t i;
+
+	for(i=0;i<FORMAT_EXAMPLE_VALUES;i++)
+	{
+		cli();
+		start = TCNT1;
+		empty = TCNT1 - start;
+		start = TCNT1;
+		switch(function)
+		{
+		case FORMAT_LQ_U16:
+			lq_format_u16(text, values16[i], 0, ' ');
+			break;
+		case FORMAT_UTOA:
+			utoa(values16[i], (char*)text, 10);
+			break;
+		case FORMAT_LQ_U32:
+			lq_format_u32(text, values32[i], 0, ' ');
+			break;
+		default:
+			ultoa(values32[i], (char*)text, 10);
+			break;
+		}
+		cycles = TCNT1 - start;
+		SREG = sreg;
+		sum += cycles - empty;
+	}
+	return sum / FORMAT_EXAMPLE_VALUES;
+}
+
+int format_example()
+{
+	/* Timer1 in normal mode counts every CPU cycle, CS10 is prescaler 1 */
+	TCCR1A = 0;
+	TCCR1B = (1<<CS10);
+
+	lq_port_configuration();
+	lq_init();
+
+	while(1)
+	{
+		lq_buffer_clear();
+		lq_buffer_write_string((BYTE*)"u16");
+		lq_buffer_write_u16(format_example_cycles(FORMAT_LQ_U16), 6);
+		lq_buffer_write_u16(format_example_cycles(FORMAT_UTOA), 7);
+
+		lq_buffer_goto(1, 0);
+		lq_buffer_write_string((BYTE*)"u32");
+		lq_buffer_write_u16(format_example_cycles(FORMAT_LQ_U32), 6);
+		lq_buffer_write_u16(format_example_cycles(FORMAT_ULTOA), 7);
+		lq_flush();
+	}
+
+}
@@ -65,6 +65,15 @@
 #define LCD_INSTRUCTION_DIS_CURSOR_BLINK 0b00000001
 #define LCD_INSTRUCTION_DIS_CURSOR_NO_BLINK 0b00000000
 
+/* Cursor or display shift bits. Bit pattern: 0 0 0 1 S/C R/L - -
+ * Moves cursor or shifts display without changing DDRAM contents.
+ */
+#define LCD_INSTRUCTION_CURSOR_DISPLAY_SHIFT 0b00010000
+#define LCD_INSTRUCTION_CDS_DISPLAY_SHIFT 0b00001000
+#define LCD_INSTRUCTION_CDS_CURSOR_MOVE 0b00000000
+#define LCD_INSTRUCTION_CDS_RIGHT 0b00000100
+#define LCD_INSTRUCTION_CDS_LEFT 0b00000000
+
 /* Function set bits. Bit pattern: 0 0 1 DL N F   
  * Sets interface data length (DL), number of display lines (N), and character font (F).
  * takes 37 ms
@@ -78,8 +87,197 @@
 #define LCD_INSTRUCTION_FS_FONT_5X8_DOTS 0b00000000
 #define LCD_INSTRUCTION_BUSY_FLAG 0b10000000
 
+/* Set CGRAM and DDRAM address. Bit pattern: 0 1 A A A A A A and 1 A A A A A A A.
+ * Following data writes go to the given address and the address counter
+ * is incremented (or decremented) after each write.
+ */
+#define LCD_INSTRUCTION_SET_CGRAM_ADDRESS 0b01000000
+#define LCD_INSTRUCTION_SET_DDRAM_ADDRESS 0b10000000
+
+/* Display geometry, 16x2 by default. For example 20x4 modules
+ * are used by defining LCD_COLUMNS 20 and LCD_ROWS 4.
+ */
+#ifndef LCD_COLUMNS
+#define LCD_COLUMNS 16
+#endif
+
+#ifndef LCD_ROWS
+#define LCD_ROWS 2
+#endif
+
+/* DDRAM address of the first character in a row. In two line mode second row
+ * starts at 0x40. Four line modules are two line modules where rows 3 and 4
+ * continue rows 1 and 2, so 20x4 rows begins at 0x00, 0x40, 0x14 and 0x54.
+ */
+#define LCD_ROW_ADDRESS(row) ((((row) & 1) ? 0x40 : 0x00) + (((row) & 2) ? LCD_COLUMNS : 0))
+
+/* Number of lines (N) and font (F) for function set. 5x10 dots font
+ * is available only in 1-line mode.
+ */
+#if LCD_ROWS > 1
+#define LCD_FUNCTION_SET_LINES (LCD_INSTRUCTION_FS_TWO_LINE | LCD_INSTRUCTION_FS_FONT_5X8_DOTS)
+#else
+#define LCD_FUNCTION_SET_LINES (LCD_INSTRUCTION_FS_ONE_LINE | LCD_INSTRUCTION_FS_FONT_5X10_DOTS)
+#endif
+
+/* Controller variants. Bus timing and execution times are selected
+ * by LCD_CONTROLLER, HD44780 compatible controllers differ slightly.
+ */
+#define LCD_CONTROLLER_HD44780 0
+#define LCD_CONTROLLER_KS0066 1
+#define LCD_CONTROLLER_ST7066 2
+
+#ifndef LCD_CONTROLLER
+#define LCD_CONTROLLER LCD_CONTROLLER_HD44780
+#endif
+
+/* Bus timing characteristics in nanoseconds. Values are minimums for 
+ * the lower supply voltage range, so they are valid also at 5 V.
+ * LCD_T_AS_NS  address set-up time, RS and R/W before E rise
+ * LCD_T_PW_NS  enable pulse width (high level)
+ * LCD_T_CYC_NS enable cycle time, E rise to next E rise
+ * LCD_T_DSW_NS data set-up time before E fall
+ * LCD_T_DDR_NS data delay time, read data is valid after E rise
+ * LCD_T_H_NS   data hold time after E fall
+ *
+ * Execution times are for the nominal oscillator frequency. Clear display
+ * and return home takes LCD_EXECUTION_TIME_LONG_US, all other instructions
+ * and data writes LCD_EXECUTION_TIME_US.
+ */
+#if LCD_CONTROLLER == LCD_CONTROLLER_HD44780
+/* HD44780U datasheet, Bus Timing Characteristics, VCC = 2.7 to 4.5 V */
+#define LCD_T_AS_NS 60
+#define LCD_T_PW_NS 450
+#define LCD_T_CYC_NS 1000
+#define LCD_T_DSW_NS 195
+#define LCD_T_DDR_NS 360
+#define LCD_T_H_NS 10
+#define LCD_EXECUTION_TIME_US 37
+#define LCD_EXECUTION_TIME_LONG_US 1520
+#elif LCD_CONTROLLER == LCD_CONTROLLER_KS0066
+/* KS0066U datasheet, AC Characteristics, VDD = 2.7 to 4.5 V */
+#define LCD_T_AS_NS 60
+#define LCD_T_PW_NS 450
+#define LCD_T_CYC_NS 1000
+#define LCD_T_DSW_NS 195
+#define LCD_T_DDR_NS 360
+#define LCD_T_H_NS 10
+#define LCD_EXECUTION_TIME_US 39
+#define LCD_EXECUTION_TIME_LONG_US 1530
+#elif LCD_CONTROLLER == LCD_CONTROLLER_ST7066
+/* ST7066U datasheet, AC Characteristics, VDD = 2.7 to 4.5 V */
+#define LCD_T_AS_NS 0
+#define LCD_T_PW_NS 460
+#define LCD_T_CYC_NS 1200
+#define LCD_T_DSW_NS 80
+#define LCD_T_DDR_NS 320
+#define LCD_T_H_NS 10
+#define LCD_EXECUTION_TIME_US 37
+#define LCD_EXECUTION_TIME_LONG_US 1520
+#else
+# error "unknown LCD_CONTROLLER for \"hd44780lq.h>\""
+#endif
+
+/* Nanoseconds to CPU cycles at F_CPU, rounded up. For example the 450 ns
+ * enable pulse is 1 cycle at 2 MHz and 8 cycles at 16 MHz.
+ */
+#define LCD_NS_TO_CYCLES(ns) (((ns) * (F_CPU / 1000UL) + 999999UL) / 1000000UL)
+
+/* Busy wait exact number of cycles. Argument must be compile time constant. */
+#define LCD_DELAY_NS(ns) __builtin_avr_delay_cycles(LCD_NS_TO_CYCLES(ns))
+
+/* Transport between MCU and LCD, selected by LCD_TRANSPORT:
+ * LCD_TRANSPORT_8BIT  DB0..DB7 in MCU_DATA_PORT, RS, R/W and E in MCU_COMMAND_PORT
+ * LCD_TRANSPORT_4BIT  DB4..DB7 in four bits of MCU_DATA_PORT starting from
+ *                     LCD_DATA_SHIFT, RS, R/W and E in MCU_COMMAND_PORT. Command
+ *                     port can be the same port as data port.
+ * LCD_TRANSPORT_I2C   PCF8574 I2C backpack in 4-bit mode through tinyi2c.
+ * Transport code is in liquid_bus.h.
+ */
+#define LCD_TRANSPORT_8BIT 0
+#define LCD_TRANSPORT_4BIT 1
+#define LCD_TRANSPORT_I2C 2
+
+#ifndef LCD_TRANSPORT
+#define LCD_TRANSPORT LCD_TRANSPORT_8BIT
+#endif
+
+/* Interface data length (DL) for function set */
+#if LCD_TRANSPORT == LCD_TRANSPORT_8BIT
+#define LCD_FUNCTION_SET_DATA_LENGTH LCD_INSTRUCTION_FS_DATA_LENGTH_8BIT
+#else
+#define LCD_FUNCTION_SET_DATA_LENGTH LCD_INSTRUCTION_FS_DATA_LENGTH_4BIT
+#endif
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_I2C
+
+/* I2C address of the backpack with write bit, PCF8574 with A0..A2 high
+ * is 0x27, 0x4E on the bus. PCF8574A with A0..A2 high is 0x7E.
+ */
+#ifndef LCD_I2C_ADDRESS
+#define LCD_I2C_ADDRESS 0x4E
+#endif
+
+/* PCF8574 outputs P0..P3 for control signals. DB4..DB7 are in P4..P7 */
+#ifndef LCD_I2C_RS
+#define LCD_I2C_RS 0
+#endif
+
+#ifndef LCD_I2C_RW
+#define LCD_I2C_RW 1
+#endif
+
+#ifndef LCD_I2C_E
+#define LCD_I2C_E 2
+#endif
+
+#ifndef LCD_I2C_BACKLIGHT
+#define LCD_I2C_BACKLIGHT 3
+#endif
+
+/* Blind timing: busy flag is not read. Reading it through PCF8574 takes 
+ * six I2C transactions, while one LCD byte written as four expander bytes
+ * takes longer than the LCD execution time anyway. Only clear display and
+ * return home are waited for. Whole strings are then written in one I2C
+ * transaction. Set to 0 to read busy flag after every byte.
+ */
+#ifndef LCD_I2C_BLIND
+#define LCD_I2C_BLIND 1
+#endif
+
+/* SCL frequency of the backpack, lq_init() sets the bus to it with
+ * tinyi2c_init_hz(). E falls of two nibbles are two expander bytes apart,
+ * 18 SCL cycles with acknowledge. Blind timing requires that this is at 
+ * least 1.5 times the execution time, which allows about 300 kHz at most.
+ * PCF8574 itself is specified for 100 kHz. tinyi2c_init() of other code on
+ * the same bus would set TINYI2C_SCL_HZ instead, keep it no faster.
+ */
+#ifndef LCD_I2C_SCL_HZ
+#define LCD_I2C_SCL_HZ 100000UL
+#endif
+
+#if LCD_I2C_BLIND && \
+	2UL * (18UL * 1000000UL / LCD_I2C_SCL_HZ) < 3UL * LCD_EXECUTION_TIME_US
+# error "LCD_I2C_SCL_HZ too fast for LCD_I2C_BLIND"
+#endif
+
+/* several displays share E lines of parallel bus, not an I2C backpack */
+#if defined(LCD_DISPLAYS) && LCD_DISPLAYS > 1
+# error "LCD_DISPLAYS > 1 needs a parallel transport"
+#endif
+
+#else /* parallel transports */
+
+/* Number of displays sharing data, RS and R/W lines. Each display has its 
+ * own E pin in MCU_COMMAND_PORT, given to lq_display_init(), and PIN_LCD_E 
+ * is not used. With one display E is PIN_LCD_E.
+ */
+#ifndef LCD_DISPLAYS
+#define LCD_DISPLAYS 1
+#endif
+
 /* MCU command Pin configuration */
-#ifndef PIN_LCD_E
+#if !defined(PIN_LCD_E) && LCD_DISPLAYS == 1
 /* prevent compiler error by supplying a default */
 # warning "PIN_LCD_E not defined for \"hd44780lq.h>\""
 #define PIN_LCD_E 5
@@ -114,7 +312,7 @@
 #ifndef MCU_DATA_DDR
 /* prevent compiler error by supplying a default */
 # warning "MCU_DATA_DDR not defined for \"hd44780lq.h>\""
-#define MCU_DATA_DDR DDRB
+#define MCU_DATA_DDR DDRD
 #endif
 
 #ifndef MCU_DATA_PORT
@@ -123,8 +321,26 @@
 #define MCU_DATA_PORT PORTD
 #endif
 
+#ifndef MCU_DATA_PIN
+/* prevent compiler error by supplying a default */
+# warning "MCU_DATA_PIN not defined for \"hd44780lq.h>\""
+#define MCU_DATA_PIN PIND
+#endif
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_4BIT
+/* DB4..DB7 are in MCU_DATA_PORT bits LCD_DATA_SHIFT..LCD_DATA_SHIFT+3,
+ * other bits of the port are not touched.
+ */
+#ifndef LCD_DATA_SHIFT
+#define LCD_DATA_SHIFT 4
+#endif
+#define LCD_DATA_MASK					(0x0F<<LCD_DATA_SHIFT)
+#define MCU_SET_DATA_IN					MCU_DATA_DDR &=~LCD_DATA_MASK
+#define MCU_SET_DATA_OUT				MCU_DATA_DDR |=LCD_DATA_MASK
+#else
 #define MCU_SET_DATA_IN					MCU_DATA_DDR=0x00
 #define MCU_SET_DATA_OUT				MCU_DATA_DDR=0xFF
+#endif
 #define LCD_SET_READ_MODE				MCU_COMMAND_PORT |=(1<<PIN_LCD_RW)	/* set RW bit */
 #define LCD_SET_WRITE_MODE				MCU_COMMAND_PORT &=~(1<<PIN_LCD_RW) /* reset RW bit */
 #define LCD_SET_DATA_MODE				MCU_COMMAND_PORT |=(1<<PIN_LCD_RS)	/* set data mode */
@@ -162,12 +378,25 @@
 /* The enable pin is used to latch the data on the data pins. 
  * Signal required to switch high to low to latch the data. The LCD interprets and executes command when enable 
  * signal is brought low. */
+#if LCD_DISPLAYS > 1
+/* E of selected display, lq_e_mask is set by lq_select(). Variable mask is
+ * read-modify-write of the port, not sbi/cbi, so interrupts must not 
+ * change other pins of MCU_COMMAND_PORT while LCD is written. */
+#define LCD_SET_CLOCK_ENABLED_HIGH		MCU_COMMAND_PORT |=lq_e_mask
+#define LCD_SET_CLOCK_ENABLED_LOW		MCU_COMMAND_PORT &=~lq_e_mask
+
+/* Command port direction initialization, E pins by lq_display_init() */
+#define LCD_INIT_PORTS MCU_COMMAND_DDR |=(1<<PIN_LCD_RS) | (1<<PIN_LCD_RW)
+#else
 #define LCD_SET_CLOCK_ENABLED_HIGH		MCU_COMMAND_PORT |=(1<<PIN_LCD_E)   /* Starts data read/write */
 #define LCD_SET_CLOCK_ENABLED_LOW		MCU_COMMAND_PORT &=~(1<<PIN_LCD_E) 
 
 
 /* Command port direction initialization */
 #define LCD_INIT_PORTS MCU_COMMAND_DDR |=(1<<PIN_LCD_RS) | (1<<PIN_LCD_RW) | (1<<PIN_LCD_E)
+#endif
+
+#endif /* LCD_TRANSPORT */
 
 
 
@@ -0,0 +1,229 @@
+/*
+ * host/adctest.c
+ * ----------------------------------------------------------------------------
+ * Continuous acquisition of adc.c on PC. A model of the ADC gives every
+ * conversion a value made of its input and the number of its sample, and
+ * calls ADC_vect. Input of a conversion is latched the way the hardware
+ * does it: in Free Running mode the next conversion starts before the
+ * interrupt runs, with a timer trigger it starts after. With
+ * ADC_TRIGGER_SLEEP each conversion starts from adc_idle(), which must
+ * enter ADC Noise Reduction sleep in Single Conversion mode.
+ *
+ * Checks that samples of one input come out of the ring in order with
+ * their values, that stamped blocks have the right first sample number
+ * across overruns, that scan frames have every input in its place and
+ * that oversampled samples have ADC_RESULT_BITS bits.
+ *
+ * Build and run on PC, from repository root:
+ *
+ *   gcc -std=gnu99 -O2 -Wall -Ihost -I. -DF_CPU=16000000UL \
+ *       -include host/lqsim_config.h -o adctest host/adctest.c adc.c \
+ *       host/avr_host.c host/hd44780sim.c && ./adctest
+ *
+ * Run it also with -DADC_TRIGGER=5 (Timer1), -DADC_TRIGGER=3 (Timer0),
+ * -DADC_TRIGGER=16 (sleep) and -DADC_OVERSAMPLE_BITS=2. Exit status is 1
+ * when any check fails.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include "adc.h"
+
+void ADC_vect(void);
+
+static int failures;
+
+/* ADC model: input of the running conversion and conversions per input */
+static uint8_t adc_latched;
+static uint32_t adc_conversions[8];
+
+static void check(const char* name, int ok)
+{
+	if(!ok)
+	{
+		printf("FAIL %s\n", name);
+		failures++;
+	}
+}
+
+/* input selected in ADMUX and ADCSRB, same bits as ADC_INPUT() */
+static uint8_t selected()
+{
+	return (ADMUX & ~(1<<ADLAR)) | (ADCSRB & (1<<MUX5));
+}
+
+/* value of a conversion: input in bits 9:7, sample number in bits 6:0 */
+static uint16_t value(uint8_t input, uint32_t sample)
+{
+	return ((input & 7) << 7) | (sample & 127);
+}
+
+/* sample which adc.c makes of value, oversampling sums 4^n equal values */
+static uint16_t result(uint8_t input, uint32_t sample)
+{
+	return value(input, sample) << ADC_OVERSAMPLE_BITS;
+}
+
+/************************************************************************/
+/* Starts model after adc_start() or adc_scan()                         */
+/************************************************************************/
+static void adc_model_start()
+{
+	memset(adc_conversions, 0, sizeof(adc_conversions));
+	adc_latched = selected();
+}
+
+/************************************************************************/
+/* One conversion and its interrupt                                     */
+/************************************************************************/
+static void convert()
+{
+	uint8_t input = adc_latched;
+
+#if ADC_TRIGGER == ADC_TRIGGER_SLEEP
+	/* conversion starts in ADC Noise Reduction sleep */
+	adc_idle();
+	if((SMCR & 0x0E) != SLEEP_MODE_ADC || (ADCSRA & (1<<ADATE)) || !(ADCSRA & (1<<ADEN)))
+	{
+		printf("FAIL adc_idle() did not start a conversion\n");
+		failures++;
+	}
+#endif
+	ADC = value(input, adc_conversions[input & 7]++ / ADC_OVERSAMPLE);
+#if ADC_TRIGGER == ADC_TRIGGER_FREE_RUNNING
+	adc_latched = selected();
+	ADC_vect();
+#else
+	ADC_vect();
+	adc_latched = selected();
+#endif
+}
+
+/* conversions for count samples of one input */
+static void convert_samples(unsigned count)
+{
+	unsigned i;
+
+	for(i=0;i<count * ADC_OVERSAMPLE;i++)
+		convert();
+}
+
+/************************************************************************/
+/* One input through ring buffer with adc_read()                        */
+/************************************************************************/
+static void check_ring()
+{
+	uint16_t block[16];
+	uint32_t expected = 0;
+	unsigned round, i, count, bad = 0;
+
+	adc_start(3);
+	adc_model_start();
+	for(round=0;round<1000;round++)
+	{
+		convert_samples(10);
+		count = adc_read(block, 16);
+		for(i=0;i<count;i++)
+			if(block[i] != result(ADC_INPUT(3), expected++))
+				bad++;
+	}
+	printf("ring: %lu samples, %u wrong, %u overruns\n", (unsigned long)expected, bad, adc_overruns());
+	check("ring", expected == 10000 && bad == 0 && adc_overruns() == 0);
+
+	/* full buffer drops new samples and counts them */
+	convert_samples(ADC_BUFFER_SIZE + 9);
+	check("ring overrun", adc_available() == ADC_BUFFER_SIZE - 1 && adc_overruns() == 10);
+}
+
+/************************************************************************/
+/* Stamped blocks, with bursts which overrun the buffer                 */
+/************************************************************************/
+static void check_stamped()
+{
+	uint16_t block[16];
+	uint32_t first, next = 0, samples = 0;
+	unsigned round, i, count, bad = 0, gaps = 0;
+
+	adc_start(2);
+	adc_model_start();
+	for(round=0;round<2000;round++)
+	{
+		convert_samples(round % 50 == 7 ? 100 : 5);
+		while((count = adc_read_stamped(block, 16, &first)))
+		{
+			if(first < next)
+				bad++;
+			if(first != next)
+				gaps += first - next;
+			for(i=0;i<count;i++)
+				if(block[i] != result(ADC_INPUT(2), first + i))
+					bad++;
+			next = first + count;
+			samples += count;
+		}
+	}
+	printf("stamped: %lu samples, %u lost in gaps, %u overruns, %u wrong\n",
+		   (unsigned long)samples, gaps, adc_overruns(), bad);
+	check("stamped", bad == 0 && gaps == adc_overruns() && samples + gaps == next && gaps > 0);
+}
+
+/************************************************************************/
+/* Frames of four inputs, bandgap needs settling conversions            */
+/************************************************************************/
+static void check_frames()
+{
+	static const uint8_t inputs[] = { ADC_INPUT(0), ADC_INPUT(1), ADC_INPUT(4), ADC_INPUT(ADC_BANDGAP) };
+	uint16_t frame[4];
+	uint32_t first, next = 0;
+	unsigned round, i, frames = 0, bad = 0, steps;
+
+	steps = adc_scan(inputs, 4);
+	adc_model_start();
+	for(round=0;round<3000;round++)
+	{
+		convert_samples(round % 97 == 5 ? 200 : 3);
+		while(adc_read_frame(frame, &first))
+		{
+			frames++;
+			if(first % 4 || first < next)
+				bad++;
+			next = first + 4;
+			for(i=0;i<4;i++)
+				if(frame[i] >> (7 + ADC_OVERSAMPLE_BITS) != (inputs[i] & 7))
+					bad++;
+		}
+	}
+	printf("frames: %u conversions per frame, %u frames, %u wrong, %u Hz per input\n",
+		   steps, frames, bad, adc_frame_rate());
+	check("frames", steps == 6 && frames > 1000 && bad == 0);
+
+	/* temperature sensor settles when switched in and out, also with the
+	 * same reference */
+	{
+		static const uint8_t sensor[] = { ADC_INPUT_REF(0, ADC_REFERENCE_2V56),
+			ADC_INPUT_REF(ADC_TEMPERATURE, ADC_REFERENCE_2V56) };
+
+		check("temperature settles", adc_scan(sensor, 2) == 4);
+	}
+}
+
+int main()
+{
+	printf("ADC_TRIGGER %d, %d bit samples, %lu Hz\n", ADC_TRIGGER, ADC_RESULT_BITS,
+		   (unsigned long)ADC_OUTPUT_HZ);
+
+	check_ring();
+	check_stamped();
+	check_frames();
+
+#if ADC_TIMER_TRIGGER
+	check("rate", adc_set_rate(ADC_RATE_HZ) == ADC_RATE_HZ && adc_rate() == ADC_RATE_HZ);
+	check("rate 256 Hz", adc_set_rate(256) >= 255 && adc_set_rate(256) <= 257);
+#endif
+
+	printf("%s, %d failures\n", failures ? "FAILED" : "OK", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * host/avr/interrupt.h
+ * ----------------------------------------------------------------------------
+ * Host build replacement of <avr/interrupt.h>. Interrupt handlers become
+ * ordinary functions which the host program calls when it simulates the
+ * interrupt, for example TIMER0_COMPA_vect().
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define ISR(vector, ...) void vector(void)
+#define sei() (SREG |= 0x80)
+#define cli() (SREG &= ~0x80)
+
+#endif /* HOST_AVR_INTERRUPT_H */
@@ -0,0 +1,127 @@
+/*
+ * host/avr/io.h
+ * ----------------------------------------------------------------------------
+ * Host build replacement of <avr/io.h>. I/O registers of ATmega16/32U4 used
+ * by the examples are plain variables (defined in host/avr_host.c), so that 
+ * the drivers compile and run on a PC against simulated devices.
+ * Bit numbers are from ATmega16/32U4 data sheet.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define HOST_REGISTER(name) extern volatile uint8_t name;
+#define HOST_REGISTER16(name) extern volatile uint16_t name;
+
+/* ports */
+HOST_REGISTER(PINB) HOST_REGISTER(DDRB) HOST_REGISTER(PORTB)
+HOST_REGISTER(PINC) HOST_REGISTER(DDRC) HOST_REGISTER(PORTC)
+HOST_REGISTER(PIND) HOST_REGISTER(DDRD) HOST_REGISTER(PORTD)
+HOST_REGISTER(PINE) HOST_REGISTER(DDRE) HOST_REGISTER(PORTE)
+HOST_REGISTER(PINF) HOST_REGISTER(DDRF) HOST_REGISTER(PORTF)
+
+/* status register and sleep mode control */
+HOST_REGISTER(SREG) HOST_REGISTER(SMCR)
+
+/* 2-wire serial interface */
+HOST_REGISTER(TWBR) HOST_REGISTER(TWSR) HOST_REGISTER(TWAR)
+HOST_REGISTER(TWDR) HOST_REGISTER(TWCR)
+
+/* analog to digital converter */
+HOST_REGISTER(ADMUX) HOST_REGISTER(ADCSRA) HOST_REGISTER(ADCSRB)
+HOST_REGISTER(ADCL) HOST_REGISTER(ADCH) HOST_REGISTER16(ADC)
+HOST_REGISTER(DIDR0) HOST_REGISTER(DIDR2)
+
+/* timers */
+HOST_REGISTER(TCCR0A) HOST_REGISTER(TCCR0B) HOST_REGISTER(TCNT0)
+HOST_REGISTER(OCR0A) HOST_REGISTER(OCR0B) HOST_REGISTER(TIMSK0) HOST_REGISTER(TIFR0)
+HOST_REGISTER(TCCR1A) HOST_REGISTER(TCCR1B) HOST_REGISTER16(TCNT1)
+HOST_REGISTER16(OCR1A) HOST_REGISTER16(OCR1B) HOST_REGISTER16(ICR1) HOST_REGISTER(TIMSK1) HOST_REGISTER(TIFR1)
+HOST_REGISTER(TCCR3A) HOST_REGISTER(TCCR3B) HOST_REGISTER16(TCNT3)
+HOST_REGISTER16(OCR3A) HOST_REGISTER(TIMSK3) HOST_REGISTER(TIFR3)
+
+/* port bits */
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PINB4 4
+#define PD0 0
+#define PD1 1
+#define PF0 0
+
+/* TWCR, TWSR */
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC 3
+#define TWEN 2
+#define TWIE 0
+#define TWPS1 1
+#define TWPS0 0
+
+/* ADMUX, ADCSRA, ADCSRB */
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define MUX4 4
+#define MUX3 3
+#define MUX2 2
+#define MUX1 1
+#define MUX0 0
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define ADHSM 7
+#define MUX5 5
+#define ADTS3 3
+#define ADTS2 2
+#define ADTS1 1
+#define ADTS0 0
+
+/* timer bits */
+#define WGM01 1
+#define WGM00 0
+#define CS02 2
+#define CS01 1
+#define CS00 0
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0 0
+#define OCF0A 1
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1 0
+#define OCF1B 2
+#define OCF1A 1
+#define WGM32 3
+#define CS32 2
+#define CS31 1
+#define CS30 0
+#define OCIE3A 1
+
+/* SMCR */
+#define SM2 3
+#define SM1 2
+#define SM0 1
+#define SE 0
+
+#endif /* HOST_AVR_IO_H */
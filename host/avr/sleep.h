@@ -0,0 +1,25 @@
+/*
+ * host/avr/sleep.h
+ * ----------------------------------------------------------------------------
+ * Host build replacement of <avr/sleep.h>. Sleep mode goes to SM2:0 of
+ * SMCR like on AVR, sleep does not wait for an interrupt.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#include <avr/io.h>
+
+/* SM2:0 in SMCR bits 3:1, datasheet Table 7-2. Sleep Mode Select */
+#define SLEEP_MODE_IDLE 0x00
+#define SLEEP_MODE_ADC 0x02
+#define SLEEP_MODE_PWR_DOWN 0x04
+
+#define set_sleep_mode(mode) (SMCR = (SMCR & ~0x0E) | (mode))
+#define sleep_enable() (SMCR |= 0x01)
+#define sleep_disable() (SMCR &= ~0x01)
+#define sleep_cpu()
+#define sleep_mode() do { sleep_enable(); sleep_cpu(); sleep_disable(); } while(0)
+
+#endif /* HOST_AVR_SLEEP_H */
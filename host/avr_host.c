@@ -0,0 +1,54 @@
+/*
+ * host/avr_host.c
+ * ----------------------------------------------------------------------------
+ * I/O registers and delays of host build, see host/avr/io.h and
+ * host/util/delay.h.
+ *
+ * Simulated time is counted in CPU cycles. Only delays advance it, so time
+ * of a bus operation is the sum of its delays, instructions between port 
+ * writes (a few cycles each) are not counted. Devices see the pins every 
+ * time the program waits. Every bus routine waits between changes of E, so
+ * devices do not miss edges. A host program can set host_delay_hook for a
+ * device of its own, e.g. a bus model which runs while the program waits.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <avr/io.h>
+#include <util/delay.h>
+#include "hd44780sim.h"
+
+#define HOST_DEFINE(name) volatile uint8_t name;
+#define HOST_DEFINE16(name) volatile uint16_t name;
+
+HOST_DEFINE(PINB) HOST_DEFINE(DDRB) HOST_DEFINE(PORTB)
+HOST_DEFINE(PINC) HOST_DEFINE(DDRC) HOST_DEFINE(PORTC)
+HOST_DEFINE(PIND) HOST_DEFINE(DDRD) HOST_DEFINE(PORTD)
+HOST_DEFINE(PINE) HOST_DEFINE(DDRE) HOST_DEFINE(PORTE)
+HOST_DEFINE(PINF) HOST_DEFINE(DDRF) HOST_DEFINE(PORTF)
+HOST_DEFINE(SREG) HOST_DEFINE(SMCR)
+HOST_DEFINE(TWBR) HOST_DEFINE(TWSR) HOST_DEFINE(TWAR)
+HOST_DEFINE(TWDR) HOST_DEFINE(TWCR)
+HOST_DEFINE(ADMUX) HOST_DEFINE(ADCSRA) HOST_DEFINE(ADCSRB)
+HOST_DEFINE(ADCL) HOST_DEFINE(ADCH) HOST_DEFINE16(ADC)
+HOST_DEFINE(DIDR0) HOST_DEFINE(DIDR2)
+HOST_DEFINE(TCCR0A) HOST_DEFINE(TCCR0B) HOST_DEFINE(TCNT0)
+HOST_DEFINE(OCR0A) HOST_DEFINE(OCR0B) HOST_DEFINE(TIMSK0) HOST_DEFINE(TIFR0)
+HOST_DEFINE(TCCR1A) HOST_DEFINE(TCCR1B) HOST_DEFINE16(TCNT1)
+HOST_DEFINE16(OCR1A) HOST_DEFINE16(OCR1B) HOST_DEFINE16(ICR1) HOST_DEFINE(TIMSK1) HOST_DEFINE(TIFR1)
+HOST_DEFINE(TCCR3A) HOST_DEFINE(TCCR3B) HOST_DEFINE16(TCNT3)
+HOST_DEFINE16(OCR3A) HOST_DEFINE(TIMSK3) HOST_DEFINE(TIFR3)
+
+/* simulated time in CPU cycles */
+uint64_t host_cycles;
+
+/* other simulated device of a host program, runs at every delay */
+void (*host_delay_hook)(void);
+
+void host_delay_cycles(uint32_t cycles)
+{
+	/* pins changed at the start of the delay */
+	hd44780sim_sample();
+	if(host_delay_hook)
+		host_delay_hook();
+	host_cycles += cycles;
+}
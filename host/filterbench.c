@@ -0,0 +1,482 @@
+/*
+ * host/filterbench.c
+ * ----------------------------------------------------------------------------
+ * Fixed point filters of filter.c against the same filters in double on PC.
+ * Prints largest difference to floating point, attenuation of the notch and
+ * estimated AVR cycles per sample with the number of channels which fit to
+ * F_CPU at common sample rates. Q14 coefficients of the filters are printed
+ * for copying, -DFILTERBENCH_FS=256 designs them for 256 Hz.
+ *
+ * PC builds of filter.c multiply in C, so the AVR201 instruction sequence
+ * of filter_mac() is modeled here byte by byte, with the carry of every
+ * ADD, ADC and SBC and the sign which MULSU leaves in carry, and checked
+ * against (int32_t)a * b for edge values and random ones. Cycle counts are
+ * estimates, filter_example.c measures them on AVR.
+ *
+ * Build and run on PC, from repository root:
+ *
+ *   gcc -std=gnu99 -O2 -Wall -Ihost -I. -DF_CPU=16000000UL \
+ *       -o filterbench host/filterbench.c filter.c -lm && ./filterbench
+ *
+ * Exit status is 1 when any check fails.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "filter.h"
+#include "adc.h"
+
+#ifndef FILTERBENCH_FS
+#define FILTERBENCH_FS 1000
+#endif
+
+/* seconds of signal, first one is left for filters to settle */
+#define SECONDS 4
+#define SAMPLES (SECONDS * FILTERBENCH_FS)
+#define SETTLE FILTERBENCH_FS
+
+#define BLOCK 16
+#define FIR_TAPS 31
+
+static int failures;
+
+/* AVR registers of the model: r1:r0 and carry flag */
+static uint8_t r0, r1, carry;
+
+static void avr_mul(uint16_t product)
+{
+	r0 = product;
+	r1 = product >> 8;
+}
+
+/* ADD and ADC, carry in only for ADC */
+static uint8_t avr_adc(uint8_t d, uint8_t r, uint8_t c)
+{
+	unsigned sum = d + r + c;
+
+	carry = sum > 0xFF;
+	return sum;
+}
+
+/* SBC d, zero */
+static uint8_t avr_sbc0(uint8_t d)
+{
+	unsigned difference = d - carry;
+
+	carry = difference > 0xFF;
+	return difference;
+}
+
+/************************************************************************/
+/* filter_mac() of filter.c one instruction at a time                   */
+/************************************************************************/
+static int32_t model_mac(int32_t acc, int16_t a, int16_t b)
+{
+	uint8_t A = (uint32_t)acc, B = (uint32_t)acc >> 8, C = (uint32_t)acc >> 16, D = (uint32_t)acc >> 24;
+	uint8_t al = a, ah = (uint16_t)a >> 8, bl = b, bh = (uint16_t)b >> 8;
+	int16_t mulsu;
+
+	/* muls ah, bh */
+	avr_mul((int8_t)ah * (int8_t)bh);
+	C = avr_adc(C, r0, 0);
+	D = avr_adc(D, r1, carry);
+	/* mul al, bl */
+	avr_mul(al * bl);
+	A = avr_adc(A, r0, 0);
+	B = avr_adc(B, r1, carry);
+	C = avr_adc(C, 0, carry);
+	D = avr_adc(D, 0, carry);
+	/* mulsu ah, bl, carry is bit 15 of the product */
+	mulsu = (int8_t)ah * bl;
+	avr_mul(mulsu);
+	carry = mulsu < 0;
+	D = avr_sbc0(D);
+	B = avr_adc(B, r0, 0);
+	C = avr_adc(C, r1, carry);
+	D = avr_adc(D, 0, carry);
+	/* mulsu bh, al */
+	mulsu = (int8_t)bh * al;
+	avr_mul(mulsu);
+	carry = mulsu < 0;
+	D = avr_sbc0(D);
+	B = avr_adc(B, r0, 0);
+	C = avr_adc(C, r1, carry);
+	D = avr_adc(D, 0, carry);
+
+	return (int32_t)((uint32_t)D << 24 | (uint32_t)C << 16 | (uint32_t)B << 8 | A);
+}
+
+/************************************************************************/
+/* Model of filter_mac() against C multiply, all pairs of edge values   */
+/* with a few sums and random values after                              */
+/************************************************************************/
+static void check_mac()
+{
+	static const int16_t edges[] = { -32768, -32767, -256, -255, -129, -128, -1, 0,
+									 1, 127, 128, 255, 256, 32767 };
+	static const int32_t sums[] = { 0, -1, 0x7FFFFFFF - 0x40000000, -0x40000000, 0x00FFFF00 };
+	unsigned i, j, k, checked = 0, wrong = 0;
+	int32_t expected;
+	int16_t a, b;
+
+	for(i=0;i<sizeof(edges)/sizeof(edges[0]);i++)
+		for(j=0;j<sizeof(edges)/sizeof(edges[0]);j++)
+			for(k=0;k<sizeof(sums)/sizeof(sums[0]);k++)
+			{
+				expected = (int32_t)((uint32_t)sums[k] + (uint32_t)((int32_t)edges[i] * edges[j]));
+				checked++;
+				if(model_mac(sums[k], edges[i], edges[j]) != expected && wrong++ < 5)
+					printf("FAIL filter_mac %ld + %d * %d: %ld\n", (long)sums[k], edges[i], edges[j],
+						   (long)model_mac(sums[k], edges[i], edges[j]));
+			}
+	srand(1);
+	for(i=0;i<100000;i++)
+	{
+		a = rand();
+		b = rand();
+		expected = (int32_t)((uint32_t)(int32_t)i + (uint32_t)((int32_t)a * b));
+		checked++;
+		if(model_mac(i, a, b) != expected && wrong++ < 5)
+			printf("FAIL filter_mac %u + %d * %d\n", i, a, b);
+	}
+	printf("%-34s %u checked, %u wrong\n", "filter_mac() AVR201 model", checked, wrong);
+	if(wrong)
+		failures++;
+}
+
+/************************************************************************/
+/* Biquads of RBJ Audio EQ Cookbook, b0 b1 b2 a1 a2 with a0 1           */
+/************************************************************************/
+static void design(double* c, double b0, double b1, double b2, double a0, double a1, double a2)
+{
+	c[0] = b0 / a0;
+	c[1] = b1 / a0;
+	c[2] = b2 / a0;
+	c[3] = a1 / a0;
+	c[4] = a2 / a0;
+}
+
+static void design_notch(double* c, double f0, double q)
+{
+	double w = 2 * M_PI * f0 / (double)FILTERBENCH_FS, alpha = sin(w) / (2 * q);
+
+	design(c, 1, -2 * cos(w), 1, 1 + alpha, -2 * cos(w), 1 - alpha);
+}
+
+static void design_lowpass(double* c, double f0, double q)
+{
+	double w = 2 * M_PI * f0 / (double)FILTERBENCH_FS, alpha = sin(w) / (2 * q);
+
+	design(c, (1 - cos(w)) / 2, 1 - cos(w), (1 - cos(w)) / 2, 1 + alpha, -2 * cos(w), 1 - alpha);
+}
+
+static void design_highpass(double* c, double f0, double q)
+{
+	double w = 2 * M_PI * f0 / (double)FILTERBENCH_FS, alpha = sin(w) / (2 * q);
+
+	design(c, (1 + cos(w)) / 2, -(1 + cos(w)), (1 + cos(w)) / 2, 1 + alpha, -2 * cos(w), 1 - alpha);
+}
+
+/************************************************************************/
+/* Floating point coefficients to Q14, and back so that the reference   */
+/* uses exactly the same coefficients                                   */
+/************************************************************************/
+static void quantize(filter_biquad_coef_t* q, double* c)
+{
+	q->b0 = FILTER_Q14(c[0]);
+	q->b1 = FILTER_Q14(c[1]);
+	q->b2 = FILTER_Q14(c[2]);
+	q->a1 = FILTER_Q14(-c[3]);
+	q->a2 = FILTER_Q14(-c[4]);
+	c[0] = q->b0 / 16384.0;
+	c[1] = q->b1 / 16384.0;
+	c[2] = q->b2 / 16384.0;
+	c[3] = -q->a1 / 16384.0;
+	c[4] = -q->a2 / 16384.0;
+}
+
+/************************************************************************/
+/* Reference biquad cascade in double, Direct Form I                    */
+/************************************************************************/
+static void reference_biquad(double (*c)[5], int stages, const double* in, double* out, int count)
+{
+	double state[8][4] = { { 0 } };
+	int n, s;
+
+	for(n=0;n<count;n++)
+	{
+		double x = in[n];
+
+		for(s=0;s<stages;s++)
+		{
+			double* z = state[s];
+			double y = c[s][0] * x + c[s][1] * z[0] + c[s][2] * z[1] - c[s][3] * z[2] - c[s][4] * z[3];
+
+			z[1] = z[0];
+			z[0] = x;
+			z[3] = z[2];
+			z[2] = y;
+			x = y;
+		}
+		out[n] = x;
+	}
+}
+
+/************************************************************************/
+/* Test signal as adc.c gives it, 0..2^ADC_RESULT_BITS - 1, and same in */
+/* Q15 of filter_from_adc(). Mix of f1 and f2 with a little noise.      */
+/************************************************************************/
+static uint16_t adc[SAMPLES];
+static int16_t fixed[SAMPLES];
+static double in[SAMPLES], out[SAMPLES];
+
+static void make_signal(double f1, double a1, double f2, double a2)
+{
+	double full = 1 << ADC_RESULT_BITS;
+	int n;
+
+	srand(1);
+	for(n=0;n<SAMPLES;n++)
+	{
+		double t = n / (double)FILTERBENCH_FS;
+		double v = 0.5 + a1 * sin(2 * M_PI * f1 * t) + a2 * sin(2 * M_PI * f2 * t);
+		v += (rand() / (double)RAND_MAX - 0.5) / full * 2;
+		adc[n] = v <= 0 ? 0 : v >= 1 ? full - 1 : (uint16_t)(v * full);
+	}
+	for(n=0;n<SAMPLES;n+=BLOCK)
+		filter_from_adc(&fixed[n], &adc[n], SAMPLES - n < BLOCK ? SAMPLES - n : BLOCK);
+	for(n=0;n<SAMPLES;n++)
+		in[n] = fixed[n];
+}
+
+/************************************************************************/
+/* Largest difference after settling, in Q15 LSB                        */
+/************************************************************************/
+static double compare(const char* name, double limit)
+{
+	double worst = 0;
+	int n;
+
+	for(n=SETTLE;n<SAMPLES;n++)
+	{
+		double d = fabs(fixed[n] - out[n]);
+		if(d > worst)
+			worst = d;
+	}
+	printf("%-34s max error %6.2f LSB", name, worst);
+	if(worst > limit)
+	{
+		printf("  FAIL, limit %.1f", limit);
+		failures++;
+	}
+	printf("\n");
+	return worst;
+}
+
+static double rms(const double* x)
+{
+	double sum = 0;
+	int n;
+
+	for(n=SETTLE;n<SAMPLES;n++)
+		sum += x[n] * x[n];
+	return sqrt(sum / (SAMPLES - SETTLE));
+}
+
+/************************************************************************/
+/* Runs cascade over the signal in blocks, returns ns per sample on PC  */
+/************************************************************************/
+static double run_biquad(const filter_biquad_coef_t* coef, int stages)
+{
+	filter_biquad_state_t state[8];
+	filter_biquad_t biquad;
+	clock_t start;
+	int n, round;
+
+	/* 20 rounds for a measurable time, signal generation included */
+	start = clock();
+	for(round=0;round<20;round++)
+	{
+		make_signal(0, 0, 0, 0);
+		filter_biquad_init(&biquad, coef, state, stages);
+		for(n=0;n<SAMPLES;n+=BLOCK)
+			filter_biquad_block(&biquad, &fixed[n], SAMPLES - n < BLOCK ? SAMPLES - n : BLOCK);
+	}
+	return (clock() - start) * 1e9 / CLOCKS_PER_SEC / (20.0 * SAMPLES);
+}
+
+static void print_coef(const char* name, const filter_biquad_coef_t* q)
+{
+	printf("\t{ %d, %d, %d, %d, %d },\t// %s\n", q->b0, q->b1, q->b2, q->a1, q->a2, name);
+}
+
+/************************************************************************/
+/* Biquad cascade against reference with signal of f1 and f2            */
+/************************************************************************/
+static void check_biquad(const char* name, double (*c)[5], int stages,
+						 double f1, double a1, double f2, double a2, double limit)
+{
+	filter_biquad_coef_t q[8];
+	filter_biquad_state_t state[8];
+	filter_biquad_t biquad;
+	int n, s;
+
+	for(s=0;s<stages;s++)
+		quantize(&q[s], c[s]);
+
+	make_signal(f1, a1, f2, a2);
+	reference_biquad(c, stages, in, out, SAMPLES);
+	filter_biquad_init(&biquad, q, state, stages);
+	for(n=0;n<SAMPLES;n+=BLOCK)
+		filter_biquad_block(&biquad, &fixed[n], SAMPLES - n < BLOCK ? SAMPLES - n : BLOCK);
+	compare(name, limit);
+}
+
+int main()
+{
+	double notch[1][5], lowpass[2][5], bandpass[2][5];
+	filter_biquad_coef_t q[2];
+	static int16_t fir_coef[(FIR_TAPS + 1) / 2];
+	static int16_t fir_delay[2 * FIR_TAPS];
+	double h[FIR_TAPS];
+	filter_fir_t fir;
+	double ns_notch, ns_lowpass, ns_fir, stopped, passed;
+	clock_t start;
+	int n, k, round;
+
+	printf("sample rate %d Hz, %d bit ADC samples\n\n", FILTERBENCH_FS, ADC_RESULT_BITS);
+
+	check_mac();
+
+	/* 50 Hz mains notch, 4th order Butterworth low-pass at 40 Hz and
+	 * 8..30 Hz band-pass of high-pass and low-pass */
+	design_notch(notch[0], 50, 5);
+	design_lowpass(lowpass[0], 40, 0.54119610);
+	design_lowpass(lowpass[1], 40, 1.3065630);
+	design_highpass(bandpass[0], 8, M_SQRT1_2);
+	design_lowpass(bandpass[1], 30, M_SQRT1_2);
+
+	check_biquad("notch 50 Hz, 10 Hz + 50 Hz", notch, 1, 10, 0.2, 50, 0.2, 4);
+	check_biquad("low-pass 40 Hz, 4th order", lowpass, 2, 5, 0.2, 120, 0.2, 4);
+	check_biquad("band-pass 8..30 Hz", bandpass, 2, 2, 0.2, 15, 0.2, 4);
+
+	/* notch removes mains: 50 Hz alone, output against input */
+	check_biquad("notch 50 Hz alone", notch, 1, 50, 0.4, 0, 0, 4);
+	stopped = rms(out);
+	passed = rms(in);
+	printf("%-34s %6.1f dB\n", "notch attenuation at 50 Hz", 20 * log10(stopped / passed));
+	if(stopped > passed / 100)
+	{
+		printf("FAIL notch attenuation under 40 dB\n");
+		failures++;
+	}
+
+	/* FIR low-pass, Hamming windowed sinc, cutoff 40 Hz */
+	for(k=0;k<FIR_TAPS;k++)
+	{
+		double m = k - (FIR_TAPS - 1) / 2.0;
+		double fc = 40.0 / FILTERBENCH_FS;
+		double sinc = m == 0 ? 2 * fc : sin(2 * M_PI * fc * m) / (M_PI * m);
+		h[k] = sinc * (0.54 - 0.46 * cos(2 * M_PI * k / (FIR_TAPS - 1)));
+	}
+	for(k=0;k<(FIR_TAPS + 1) / 2;k++)
+		fir_coef[k] = FILTER_Q15(h[k]);
+	for(k=0;k<FIR_TAPS;k++)
+	{
+		int i = k < (FIR_TAPS + 1) / 2 ? k : FIR_TAPS - 1 - k;
+		h[k] = fir_coef[i] / 32768.0;
+	}
+
+	make_signal(5, 0.2, 120, 0.2);
+	for(n=0;n<SAMPLES;n++)
+	{
+		double sum = 0;
+		for(k=0;k<FIR_TAPS && k<=n;k++)
+			sum += h[k] * in[n - k];
+		out[n] = sum;
+	}
+	filter_fir_init(&fir, fir_coef, fir_delay, FIR_TAPS);
+	for(n=0;n<SAMPLES;n+=BLOCK)
+		filter_fir_block(&fir, &fixed[n], SAMPLES - n < BLOCK ? SAMPLES - n : BLOCK);
+	compare("FIR 31 taps low-pass 40 Hz", 1);
+
+	/* ADC conversion there and back */
+	make_signal(3, 0.45, 0, 0);
+	for(n=0;n<SAMPLES;n+=BLOCK)
+	{
+		uint16_t back[BLOCK];
+		int count = SAMPLES - n < BLOCK ? SAMPLES - n : BLOCK;
+
+		filter_to_adc(back, &fixed[n], count);
+		for(k=0;k<count;k++)
+		{
+			/* 16 bit samples lose their lowest bit */
+			uint16_t expected = ADC_RESULT_BITS == 16 ? adc[n + k] & ~1 : adc[n + k];
+
+			if(back[k] != expected)
+			{
+				printf("FAIL filter_to_adc: %u, expected %u\n", back[k], expected);
+				failures++;
+				n = SAMPLES;
+				break;
+			}
+		}
+	}
+
+	/* time on this PC, only to compare changes */
+	quantize(&q[0], notch[0]);
+	ns_notch = run_biquad(q, 1);
+	quantize(&q[0], lowpass[0]);
+	quantize(&q[1], lowpass[1]);
+	ns_lowpass = run_biquad(q, 2);
+	start = clock();
+	for(round=0;round<20;round++)
+	{
+		make_signal(0, 0, 0, 0);
+		filter_fir_init(&fir, fir_coef, fir_delay, FIR_TAPS);
+		for(n=0;n<SAMPLES;n+=BLOCK)
+			filter_fir_block(&fir, &fixed[n], SAMPLES - n < BLOCK ? SAMPLES - n : BLOCK);
+	}
+	ns_fir = (clock() - start) * 1e9 / CLOCKS_PER_SEC / (20.0 * SAMPLES);
+	printf("\nPC time with signal generation: notch %.1f ns, low-pass %.1f ns, FIR %.1f ns per sample\n",
+		   ns_notch, ns_lowpass, ns_fir);
+
+	/* AVR estimate */
+	{
+		static const unsigned rates[] = { 128, 256, 1000 };
+		unsigned chain = 3 * FILTER_BIQUAD_CYCLES;
+		unsigned fir31 = FILTER_FIR_CYCLES(FIR_TAPS);
+		unsigned i;
+
+		printf("\nAVR at %lu Hz, estimated cycles per sample:\n", (unsigned long)F_CPU);
+		printf("  biquad stage %u, notch + 4th order low-pass %u, FIR %d taps %u\n",
+			   FILTER_BIQUAD_CYCLES, chain, FIR_TAPS, fir31);
+		printf("  channels at most, half of CPU left for the rest:\n");
+		for(i=0;i<sizeof(rates)/sizeof(rates[0]);i++)
+		{
+			unsigned long budget = F_CPU / 2 / rates[i];
+			printf("  %5u Hz: notch + low-pass %4lu, FIR %4lu\n",
+				   rates[i], budget / chain, budget / fir31);
+		}
+	}
+
+	/* coefficients for filter.h */
+	printf("\nQ14 coefficients at %d Hz:\n", FILTERBENCH_FS);
+	quantize(&q[0], notch[0]);
+	print_coef("notch 50 Hz, Q 5", &q[0]);
+	quantize(&q[0], lowpass[0]);
+	quantize(&q[1], lowpass[1]);
+	print_coef("low-pass 40 Hz, 1st of 2", &q[0]);
+	print_coef("low-pass 40 Hz, 2nd of 2", &q[1]);
+	quantize(&q[0], bandpass[0]);
+	quantize(&q[1], bandpass[1]);
+	print_coef("high-pass 8 Hz", &q[0]);
+	print_coef("low-pass 30 Hz", &q[1]);
+
+	if(failures)
+		printf("\n%d checks FAILED\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * host/formattest.c
+ * ----------------------------------------------------------------------------
+ * Number formatting of liquid_format.c on PC against snprintf(). Checks
+ * edge values of every formatter (0, 65535, -32768, INT32_MIN, INT32_MAX,
+ * fixed point with 0..10 decimals) with widths 0..16 and space and zero
+ * padding, and random values after them. Returned length must be the
+ * length of the text, and nothing may be written past the terminator.
+ *
+ * Build and run on PC, from repository root:
+ *
+ *   gcc -std=gnu99 -O2 -Wall -Ihost -I. -include host/lqsim_config.h \
+ *       -o formattest host/formattest.c liquid_format.c && ./formattest
+ *
+ * Exit status is 1 when any check fails.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "liquid.h"
+
+/* longest width checked, buffer has room for it and a guard after */
+#define WIDTH_MAX 16
+#define GUARD 0xA5
+
+static int failures;
+static unsigned checked;
+
+/* shadow buffer writes of liquid_format.c are not checked here */
+void lq_buffer_write_string(BYTE* data)
+{
+}
+
+/************************************************************************/
+/* Pads unpadded text the way lq_format_* does, minus sign stays in     */
+/* front of zeros                                                       */
+/************************************************************************/
+static void expected_pad(char* out, const char* text, unsigned width, char pad)
+{
+	unsigned length = strlen(text);
+	int negative = text[0] == '-';
+
+	if(pad == '0' && negative)
+		*out++ = *text++;
+	while(length < width)
+	{
+		*out++ = pad;
+		length++;
+	}
+	strcpy(out, text);
+}
+
+/************************************************************************/
+/* Compares result of a formatter to expected text                      */
+/************************************************************************/
+static void check(const char* name, BYTE* buffer, BYTE length, const char* expected)
+{
+	unsigned i;
+
+	checked++;
+	if(strcmp((char*)buffer, expected) || length != strlen(expected))
+	{
+		if(failures < 20)
+			printf("FAIL %s: \"%s\" (%u), expected \"%s\"\n", name, buffer, length, expected);
+		failures++;
+	}
+	for(i=strlen(expected)+1;i<WIDTH_MAX + 16;i++)
+		if(buffer[i] != GUARD)
+		{
+			if(failures < 20)
+				printf("FAIL %s: written past terminator at %u\n", name, i);
+			failures++;
+			break;
+		}
+}
+
+static void guard(BYTE* buffer)
+{
+	memset(buffer, GUARD, WIDTH_MAX + 16);
+}
+
+/************************************************************************/
+/* Fixed point text of value with decimals digits after the point       */
+/************************************************************************/
+static void expected_fixed(char* out, int32_t value, unsigned decimals)
+{
+	uint64_t magnitude = value < 0 ? -(int64_t)value : value;
+	uint64_t scale = 1;
+	unsigned i;
+
+	for(i=0;i<decimals;i++)
+		scale *= 10;
+	if(decimals == 0)
+		sprintf(out, "%ld", (long)value);
+	else
+		sprintf(out, "%s%llu.%0*llu", value < 0 ? "-" : "", (unsigned long long)(magnitude / scale),
+				decimals, (unsigned long long)(magnitude % scale));
+}
+
+/************************************************************************/
+/* Every formatter with one value, all widths and both pads             */
+/************************************************************************/
+static void check_value(int64_t value)
+{
+	BYTE buffer[WIDTH_MAX + 16];
+	char text[32], expected[WIDTH_MAX + 16];
+	static const char pads[] = { ' ', '0' };
+	unsigned width, p, decimals, digits;
+	char pad;
+
+	for(p=0;p<2;p++)
+		for(width=0;width<=WIDTH_MAX;width++)
+		{
+			pad = pads[p];
+			if(value >= 0 && value <= 255)
+			{
+				sprintf(text, "%u", (unsigned)value);
+				expected_pad(expected, text, width, pad);
+				guard(buffer);
+				check("u8", buffer, lq_format_u8(buffer, value, width, pad), expected);
+			}
+			if(value >= 0 && value <= 65535)
+			{
+				sprintf(text, "%u", (unsigned)value);
+				expected_pad(expected, text, width, pad);
+				guard(buffer);
+				check("u16", buffer, lq_format_u16(buffer, value, width, pad), expected);
+			}
+			if(value >= INT16_MIN && value <= INT16_MAX)
+			{
+				sprintf(text, "%d", (int)value);
+				expected_pad(expected, text, width, pad);
+				guard(buffer);
+				check("s16", buffer, lq_format_s16(buffer, value, width, pad), expected);
+			}
+			if(value >= 0 && value <= UINT32_MAX)
+			{
+				sprintf(text, "%lu", (unsigned long)value);
+				expected_pad(expected, text, width, pad);
+				guard(buffer);
+				check("u32", buffer, lq_format_u32(buffer, value, width, pad), expected);
+			}
+			if(value >= INT32_MIN && value <= INT32_MAX)
+			{
+				sprintf(text, "%ld", (long)value);
+				expected_pad(expected, text, width, pad);
+				guard(buffer);
+				check("s32", buffer, lq_format_s32(buffer, value, width, pad), expected);
+
+				for(decimals=0;decimals<=10;decimals++)
+				{
+					expected_fixed(text, value, decimals);
+					expected_pad(expected, text, width, pad);
+					guard(buffer);
+					check("fixed", buffer, lq_format_fixed(buffer, value, decimals, width, pad), expected);
+				}
+			}
+		}
+
+	/* hex has exactly digits digits of the low 16 bits */
+	for(digits=1;digits<=4;digits++)
+	{
+		sprintf(expected, "%0*X", digits, (unsigned)(value & ((1UL << (4 * digits)) - 1)));
+		guard(buffer);
+		check("hex", buffer, lq_format_hex(buffer, value, digits), expected);
+	}
+}
+
+int main()
+{
+	static const int64_t edges[] = { 0, 1, 9, 10, 99, 100, 255, 256, 9999, 10000, 32767, 32768,
+		65535, 65536, 99999, 100000, 999999999, 1000000000, INT32_MAX, 2147483648LL,
+		4294967295LL, -1, -9, -10, -255, -32767, -32768, -32769, -65535, -999999999,
+		-1000000000, -2147483647, INT32_MIN };
+	unsigned i;
+
+	for(i=0;i<sizeof(edges)/sizeof(edges[0]);i++)
+		check_value(edges[i]);
+
+	/* random values of every size */
+	srand(1);
+	for(i=0;i<20000;i++)
+	{
+		uint32_t random = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+		check_value((int64_t)(random >> (i % 32)) * (i & 1 ? -1 : 1));
+	}
+
+	printf("%u results, %s, %d failures\n", checked, failures ? "FAILED" : "OK", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * host/hd44780sim.c
+ * ----------------------------------------------------------------------------
+ * HD44780 controller model for host build of liquid, see hd44780sim.h.
+ * Instructions are from HD44780U datasheet Table 6.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "hd44780sim.h"
+
+#define HD44780SIM_US_TO_CYCLES(us) ((uint64_t)(us) * (F_CPU / 1000000UL))
+
+/* one line holds 40 characters in 2-line mode and 80 in 1-line mode */
+#define HD44780SIM_LINE 40
+
+static struct hd44780sim* hd44780sim_lcds[HD44780SIM_MAX];
+static BYTE hd44780sim_count;
+
+/************************************************************************/
+/* Power on state: internal reset of datasheet Figure 23                */
+/************************************************************************/
+void hd44780sim_init(struct hd44780sim* lcd, BYTE e_pin)
+{
+	memset(lcd, 0, sizeof(*lcd));
+	memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+	lcd->e_pin = e_pin;
+	lcd->entry_mode = LCD_INSTRUCTION_ENTRY_INCR;
+	lcd->function_set = LCD_INSTRUCTION_FS_DATA_LENGTH_8BIT;
+	if(hd44780sim_count < HD44780SIM_MAX)
+		hd44780sim_lcds[hd44780sim_count++] = lcd;
+}
+
+void hd44780sim_reset_stats(struct hd44780sim* lcd)
+{
+	lcd->strobes = 0;
+	lcd->instructions = 0;
+	lcd->data_writes = 0;
+	lcd->cgram_writes = 0;
+	lcd->reads = 0;
+	lcd->ignored = 0;
+}
+
+BYTE hd44780sim_busy(struct hd44780sim* lcd)
+{
+	return host_cycles < lcd->busy_until;
+}
+
+double hd44780sim_us(uint64_t cycles)
+{
+	return cycles / (F_CPU / 1000000.0);
+}
+
+/************************************************************************/
+/* Address counter after increment or decrement                         */
+/************************************************************************/
+static BYTE hd44780sim_next_address(struct hd44780sim* lcd, BYTE address, BYTE increment)
+{
+	if(lcd->cgram_selected)
+		return (address + (increment ? 1 : -1)) & 0x3F;
+
+	if(!(lcd->function_set & LCD_INSTRUCTION_FS_TWO_LINE))
+		return increment ? (address == 0x4F ? 0x00 : address + 1)
+						 : (address == 0x00 ? 0x4F : address - 1);
+
+	/* 2-line mode: 0x00..0x27 and 0x40..0x67 */
+	if(increment)
+	{
+		if(address == 0x27)
+			return 0x40;
+		if(address == 0x67)
+			return 0x00;
+		return address + 1;
+	}
+	if(address == 0x40)
+		return 0x27;
+	if(address == 0x00)
+		return 0x67;
+	return address - 1;
+}
+
+static void hd44780sim_shift_display(struct hd44780sim* lcd, BYTE left)
+{
+	BYTE line = (lcd->function_set & LCD_INSTRUCTION_FS_TWO_LINE) ? HD44780SIM_LINE : 2 * HD44780SIM_LINE;
+
+	/* shift left moves the contents left, so visible window moves right */
+	lcd->shift = left ? (lcd->shift + 1) % line : (lcd->shift + line - 1) % line;
+}
+
+/************************************************************************/
+/* Execute instruction                                                  */
+/************************************************************************/
+static void hd44780sim_instruction(struct hd44780sim* lcd, BYTE value)
+{
+	uint64_t execution = HD44780SIM_US_TO_CYCLES(LCD_EXECUTION_TIME_US);
+
+	lcd->instructions++;
+	if(value & LCD_INSTRUCTION_SET_DDRAM_ADDRESS)
+	{
+		lcd->address = value & 0x7F;
+		lcd->cgram_selected = 0;
+	}
+	else if(value & LCD_INSTRUCTION_SET_CGRAM_ADDRESS)
+	{
+		lcd->address = value & 0x3F;
+		lcd->cgram_selected = 1;
+	}
+	else if(value & LCD_INSTRUCTION_FUNCTION_SET)
+	{
+		/* DL changes interface length of the next transfer */
+		lcd->function_set = value & 0x1C;
+	}
+	else if(value & LCD_INSTRUCTION_CURSOR_DISPLAY_SHIFT)
+	{
+		if(value & LCD_INSTRUCTION_CDS_DISPLAY_SHIFT)
+			hd44780sim_shift_display(lcd, !(value & LCD_INSTRUCTION_CDS_RIGHT));
+		else
+			lcd->address = hd44780sim_next_address(lcd, lcd->address, value & LCD_INSTRUCTION_CDS_RIGHT);
+	}
+	else if(value & LCD_INSTRUCTION_DISPLAY_CONTROL)
+	{
+		lcd->display_control = value & 0x07;
+	}
+	else if(value & LCD_INSTRUCTION_ENTRY_MODE)
+	{
+		lcd->entry_mode = value & 0x03;
+	}
+	else if(value & LCD_INSTRUCTION_RETURN_HOME)
+	{
+		lcd->address = 0;
+		lcd->cgram_selected = 0;
+		lcd->shift = 0;
+		execution = HD44780SIM_US_TO_CYCLES(LCD_EXECUTION_TIME_LONG_US);
+	}
+	else if(value & LCD_INSTRUCTION_CLEAR_DISPLAY)
+	{
+		memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+		lcd->address = 0;
+		lcd->cgram_selected = 0;
+		lcd->shift = 0;
+		lcd->entry_mode |= LCD_INSTRUCTION_ENTRY_INCR;
+		execution = HD44780SIM_US_TO_CYCLES(LCD_EXECUTION_TIME_LONG_US);
+	}
+	lcd->busy_until = host_cycles + execution;
+}
+
+/************************************************************************/
+/* Write to data register                                               */
+/************************************************************************/
+static void hd44780sim_data(struct hd44780sim* lcd, BYTE value)
+{
+	BYTE increment = lcd->entry_mode & LCD_INSTRUCTION_ENTRY_INCR;
+
+	lcd->data_writes++;
+	if(lcd->cgram_selected)
+	{
+		lcd->cgram[lcd->address] = value & 0x1F;
+		lcd->cgram_writes++;
+	}
+	else
+		lcd->ddram[lcd->address] = value;
+	lcd->address = hd44780sim_next_address(lcd, lcd->address, increment);
+
+	/* entry mode shift moves display with the cursor */
+	if(!lcd->cgram_selected && (lcd->entry_mode & LCD_INSTRUCTION_ENTRY_SHIFT_CURSOR))
+		hd44780sim_shift_display(lcd, increment);
+	lcd->busy_until = host_cycles + HD44780SIM_US_TO_CYCLES(LCD_EXECUTION_TIME_US);
+}
+
+/************************************************************************/
+/* Byte for read: busy flag and address counter, or data at address     */
+/************************************************************************/
+static BYTE hd44780sim_read_value(struct hd44780sim* lcd, BYTE rs)
+{
+	if(!rs)
+		return (hd44780sim_busy(lcd) ? LCD_INSTRUCTION_BUSY_FLAG : 0) | (lcd->address & 0x7F);
+	return lcd->cgram_selected ? lcd->cgram[lcd->address] : lcd->ddram[lcd->address];
+}
+
+/************************************************************************/
+/* Received byte                                                        */
+/************************************************************************/
+static void hd44780sim_write(struct hd44780sim* lcd, BYTE value, BYTE rs)
+{
+	if(hd44780sim_busy(lcd))
+	{
+		lcd->ignored++;
+		return;
+	}
+	if(rs)
+		hd44780sim_data(lcd, value);
+	else
+		hd44780sim_instruction(lcd, value);
+}
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_8BIT
+#define HD44780SIM_BUS()				MCU_DATA_PORT
+#define HD44780SIM_DRIVE(value)			MCU_DATA_PIN = (value)
+#else
+/* DB4..DB7 only, DB0..DB3 read as zero in 8-bit interface mode */
+#define HD44780SIM_BUS()				(((MCU_DATA_PORT & LCD_DATA_MASK) >> LCD_DATA_SHIFT) << 4)
+#define HD44780SIM_DRIVE(value)			MCU_DATA_PIN = (MCU_DATA_PIN & ~LCD_DATA_MASK) | \
+											((((value) >> 4) & 0x0F) << LCD_DATA_SHIFT)
+#endif
+
+/************************************************************************/
+/* E edges of one controller                                            */
+/************************************************************************/
+static void hd44780sim_edge(struct hd44780sim* lcd, BYTE e)
+{
+	BYTE rs = (MCU_COMMAND_PORT >> PIN_LCD_RS) & 1;
+	BYTE read = (MCU_COMMAND_PORT >> PIN_LCD_RW) & 1;
+	BYTE eight_bit = lcd->function_set & LCD_INSTRUCTION_FS_DATA_LENGTH_8BIT;
+
+	if(e)
+	{
+		/* rising edge: controller drives data bus when reading */
+		lcd->strobes++;
+		if(read)
+		{
+			if(eight_bit || !lcd->nibble_second)
+				lcd->read_value = hd44780sim_read_value(lcd, rs);
+			HD44780SIM_DRIVE(lcd->nibble_second ? lcd->read_value << 4 : lcd->read_value);
+		}
+		return;
+	}
+
+	/* falling edge: data is latched */
+	if(!eight_bit && !lcd->nibble_second)
+	{
+		lcd->nibble_second = 1;
+		lcd->nibble_high = HD44780SIM_BUS() & 0xF0;
+		return;
+	}
+	lcd->nibble_second = 0;
+
+	if(read)
+	{
+		lcd->reads++;
+		if(rs)
+			lcd->address = hd44780sim_next_address(lcd, lcd->address,
+												  lcd->entry_mode & LCD_INSTRUCTION_ENTRY_INCR);
+		return;
+	}
+	hd44780sim_write(lcd, eight_bit ? HD44780SIM_BUS() : lcd->nibble_high | (HD44780SIM_BUS() >> 4), rs);
+}
+
+/************************************************************************/
+/* Look at the pins, called by host delays                              */
+/************************************************************************/
+void hd44780sim_sample()
+{
+	BYTE i;
+
+	for(i=0;i<hd44780sim_count;i++)
+	{
+		struct hd44780sim* lcd = hd44780sim_lcds[i];
+		BYTE e = (MCU_COMMAND_PORT >> lcd->e_pin) & 1;
+
+		if(e != lcd->e_last)
+		{
+			lcd->e_last = e;
+			hd44780sim_edge(lcd, e);
+		}
+	}
+}
+
+/************************************************************************/
+/* Visible characters of row, text must have room for LCD_COLUMNS + 1   */
+/************************************************************************/
+void hd44780sim_row(struct hd44780sim* lcd, BYTE row, char* text)
+{
+	BYTE column;
+
+	for(column=0;column<LCD_COLUMNS;column++)
+	{
+		BYTE address;
+
+		if(lcd->function_set & LCD_INSTRUCTION_FS_TWO_LINE)
+		{
+			/* rows 2 and 3 of 4-line display continue lines 0 and 1 */
+			BYTE position = ((row & 2) ? LCD_COLUMNS : 0) + column + lcd->shift;
+			address = ((row & 1) ? 0x40 : 0x00) + position % HD44780SIM_LINE;
+		}
+		else
+			address = (row * LCD_COLUMNS + column + lcd->shift) % (2 * HD44780SIM_LINE);
+		text[column] = lcd->ddram[address];
+	}
+	text[LCD_COLUMNS] = '\0';
+}
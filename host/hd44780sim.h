@@ -0,0 +1,76 @@
+/*
+ * host/hd44780sim.h
+ * ----------------------------------------------------------------------------
+ * HD44780 controller model for host build of liquid.
+ *
+ * Model watches RS, R/W, E and data pins of the wiring in liquid
+ * configuration (MCU_COMMAND_PORT, MCU_DATA_PORT, MCU_DATA_PIN) and works
+ * like the controller: instruction and data registers, DDRAM and CGRAM,
+ * address counter, entry mode, display shift, 8-bit and 4-bit interface and
+ * busy flag timing from LCD_EXECUTION_TIME_US. Every E strobe is counted.
+ * Writes while busy are ignored as by the real controller and counted in
+ * ignored, so timing errors show up as wrong screen contents.
+ *
+ * Parallel transports only, I2C backpack is not modelled.
+ *
+ * usage:
+ *
+	struct hd44780sim lcd;
+	char row[LCD_COLUMNS + 1];
+
+	hd44780sim_init(&lcd, PIN_LCD_E);
+	lq_port_configuration();
+	lq_init();
+	hd44780sim_row(&lcd, 0, row);
+	printf("%s %u strobes %.1f us\n", row, lcd.strobes, hd44780sim_us(host_cycles));
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef HD44780SIM_H
+#define HD44780SIM_H
+
+#include <stdint.h>
+#include "liquid.h"
+
+/* models which can be attached at the same time, one for each E pin */
+#define HD44780SIM_MAX 4
+
+struct hd44780sim
+{
+	BYTE e_pin;				/* E of this controller in MCU_COMMAND_PORT */
+	BYTE e_last;			/* E level at previous sample */
+
+	BYTE ddram[0x80];
+	BYTE cgram[0x40];
+	BYTE address;			/* address counter */
+	BYTE cgram_selected;	/* address counter points to CGRAM */
+	BYTE entry_mode;		/* I/D and S bits */
+	BYTE display_control;	/* D, C and B bits */
+	BYTE function_set;		/* DL, N and F bits */
+	BYTE shift;				/* display shift, 0..39 */
+
+	BYTE nibble_second;		/* 4-bit interface: next nibble is the lower one */
+	BYTE nibble_high;		/* upper nibble of write */
+	BYTE read_value;		/* byte being read */
+	uint64_t busy_until;	/* cycle when busy flag clears */
+
+	/* statistics */
+	uint32_t strobes;		/* E pulses */
+	uint32_t instructions;	/* executed instructions */
+	uint32_t data_writes;	/* written characters and CGRAM rows */
+	uint32_t cgram_writes;	/* written CGRAM rows */
+	uint32_t reads;			/* reads of busy flag and data */
+	uint32_t ignored;		/* writes while busy */
+};
+
+/* simulated time in CPU cycles, host/avr_host.c */
+extern uint64_t host_cycles;
+
+void hd44780sim_init(struct hd44780sim* lcd, BYTE e_pin);
+void hd44780sim_sample();
+void hd44780sim_reset_stats(struct hd44780sim* lcd);
+BYTE hd44780sim_busy(struct hd44780sim* lcd);
+void hd44780sim_row(struct hd44780sim* lcd, BYTE row, char* text);
+double hd44780sim_us(uint64_t cycles);
+
+#endif /* HD44780SIM_H */
@@ -0,0 +1,596 @@
+/*
+ * host/lqbench.c
+ * ----------------------------------------------------------------------------
+ * Liquid on simulated HD44780: checks screen contents and prints bus time
+ * of the basic operations. Run after every change of liquid to see that
+ * screen is still right and how much time the change saved.
+ *
+ * Build and run on PC, from repository root:
+ *
+ *   gcc -std=gnu99 -O2 -Wall -Ihost -I. -include host/lqsim_config.h \
+ *       -o lqbench host/lqbench.c host/hd44780sim.c host/avr_host.c \
+ *       liquid.c liquid_format.c liquid_scroll.c \
+ *       liquid_async.c liquid_refresh.c liquid_widget.c && ./lqbench
+ *
+ * Add -DLCD_TRANSPORT=0 for 8-bit transport and -DLCD_CONTROLLER=1 for
+ * KS0066 timing. -DLCD_DISPLAYS=4 runs the multi-display bench instead, 
+ * displays have E in PORTC bits 5..2. Leave liquid_refresh.c out then.
+ *
+ * Exit status is 1 when any check fails.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include "hd44780sim.h"
+
+static struct hd44780sim lcd;
+static int failures;
+
+/************************************************************************/
+/* Compare visible row to expected text                                 */
+/************************************************************************/
+static void check_lcd_row(struct hd44780sim* model, const char* name, BYTE row, const char* expected)
+{
+	char text[LCD_COLUMNS + 1];
+
+	hd44780sim_row(model, row, text);
+	if(strcmp(text, expected) != 0 || model->ignored)
+	{
+		printf("FAIL %s row %u: \"%s\", expected \"%s\", %u writes while busy\n",
+			   name, row, text, expected, model->ignored);
+		failures++;
+	}
+}
+
+static void check_row(const char* name, BYTE row, const char* expected)
+{
+	check_lcd_row(&lcd, name, row, expected);
+}
+
+/************************************************************************/
+/* Measurement over measured models, strobes and reads are summed       */
+/************************************************************************/
+static struct hd44780sim* measured = &lcd;
+static BYTE measured_count = 1;
+static uint64_t start;
+
+static void measure_start()
+{
+	BYTE i;
+
+	for(i=0;i<measured_count;i++)
+		hd44780sim_reset_stats(&measured[i]);
+	start = host_cycles;
+}
+
+static void measure_end(const char* name, unsigned count)
+{
+	double us = hd44780sim_us(host_cycles - start);
+	unsigned strobes = 0, reads = 0, writes = 0;
+	BYTE i;
+
+	for(i=0;i<measured_count;i++)
+	{
+		strobes += measured[i].strobes;
+		reads += measured[i].reads;
+		writes += measured[i].instructions + measured[i].data_writes;
+	}
+	printf("%-30s %10.1f us %6u strobes %5u reads %5u writes", name, us, strobes, reads, writes);
+	if(count)
+		printf(" %8.2f us each", us / count);
+	printf("\n");
+}
+
+/* expected window of scrolling text after steps, short text padded to 40 */
+static void scrolled(char* text, const char* source, unsigned steps)
+{
+	unsigned length = strlen(source), period = length < 40 ? 40 : length;
+	unsigned column;
+
+	for(column=0;column<LCD_COLUMNS;column++)
+	{
+		unsigned index = (steps + column) % period;
+		text[column] = index < length ? source[index] : ' ';
+	}
+	text[LCD_COLUMNS] = '\0';
+}
+
+/* lit pixel columns of a bar on the model, read back from DDRAM and CGRAM */
+static unsigned bar_level(BYTE row, BYTE width)
+{
+	char text[LCD_COLUMNS + 1];
+	unsigned level = 0;
+	BYTE cell, bits;
+
+	hd44780sim_row(&lcd, row, text);
+	for(cell=0;cell<width;cell++)
+	{
+		BYTE code = text[cell];
+
+		if(code == 0xFF)
+			level += LQ_BAR_STEPS;
+		else if(code < 16)
+			for(bits=lcd.cgram[(code & 7) * 8];bits;bits&=bits-1)
+				level++;
+	}
+	return level;
+}
+
+/* row text padded to display width */
+static void padded(char* text, const char* source)
+{
+	memset(text, ' ', LCD_COLUMNS);
+	memcpy(text, source, strlen(source) < LCD_COLUMNS ? strlen(source) : LCD_COLUMNS);
+	text[LCD_COLUMNS] = '\0';
+}
+
+#if LCD_DISPLAYS == 1
+/* interrupt handlers of liquid_async.c and liquid_refresh.c */
+void TIMER0_COMPA_vect(void);
+void TIMER1_COMPA_vect(void);
+
+/* bitmap of test glyph n, rows differ so that no widget glyph matches */
+static void glyph_bitmap(BYTE* bitmap, BYTE n)
+{
+	BYTE row;
+
+	for(row=0;row<8;row++)
+		bitmap[row] = (n + 3 * row + 1) & 0x1F;
+}
+
+/* CGRAM of the model holds test glyph n in slot */
+static void check_glyph_slot(const char* name, BYTE slot, BYTE n)
+{
+	BYTE bitmap[8];
+
+	glyph_bitmap(bitmap, n);
+	if(slot > 7 || memcmp(&lcd.cgram[slot * 8], bitmap, 8) != 0)
+	{
+		printf("FAIL %s: glyph %u not in CGRAM slot %u\n", name, n, slot);
+		failures++;
+	}
+}
+
+/* lq_glyph() of test glyph n returns expected slot */
+static BYTE check_glyph(const char* name, BYTE n, BYTE expected)
+{
+	BYTE bitmap[8], slot;
+
+	glyph_bitmap(bitmap, n);
+	slot = lq_glyph(bitmap);
+	if(slot != expected)
+	{
+		printf("FAIL %s: glyph %u in slot %u, expected %u\n", name, n, slot, expected);
+		failures++;
+	}
+	return slot;
+}
+
+/************************************************************************/
+/* Glyph cache of lq_glyph() with twelve glyphs for eight slots. Glyphs */
+/* on screen are never evicted, the least recently used glyph which is  */
+/* not on screen is, and a cached glyph is not uploaded again.          */
+/************************************************************************/
+static void check_glyph_cache()
+{
+	BYTE bitmap[8], slot[8], n, other;
+
+	lq_buffer_clear();
+	lq_flush();
+
+	/* glyphs 0..7 on row 0, each takes its own slot */
+	for(n=0;n<8;n++)
+	{
+		glyph_bitmap(bitmap, n);
+		slot[n] = lq_glyph(bitmap);
+		for(other=0;other<n;other++)
+			if(slot[n] > 7 || slot[n] == slot[other])
+			{
+				printf("FAIL lq_glyph: glyph %u in slot %u\n", n, slot[n]);
+				failures++;
+				return;
+			}
+		lq_buffer_write_char(slot[n]);
+	}
+	lq_flush();
+	for(n=0;n<8;n++)
+		check_glyph_slot("lq_glyph 8 on screen", slot[n], n);
+
+	/* all slots on screen, ninth glyph does not get one */
+	measure_start();
+	check_glyph("lq_glyph all on screen", 8, LQ_GLYPH_NONE);
+	lq_flush();
+	if(lcd.data_writes)
+	{
+		printf("FAIL lq_glyph all on screen: %u writes\n", lcd.data_writes);
+		failures++;
+	}
+
+	/* cells 1, 3 and 6 are cleared, then glyphs 1 and 6 are used again.
+	 * Slot of glyph 3 is the least recently used not on screen, then
+	 * those of 1 and 6, and the slot of glyph 8 after them. */
+	lq_buffer_goto(0, 1);
+	lq_buffer_write_char(' ');
+	lq_buffer_goto(0, 3);
+	lq_buffer_write_char(' ');
+	lq_buffer_goto(0, 6);
+	lq_buffer_write_char(' ');
+	check_glyph("lq_glyph cached", 1, slot[1]);
+	check_glyph("lq_glyph cached", 6, slot[6]);
+	check_glyph("lq_glyph LRU", 8, slot[3]);
+	check_glyph("lq_glyph LRU", 9, slot[1]);
+	check_glyph("lq_glyph LRU", 10, slot[6]);
+	check_glyph("lq_glyph LRU", 11, slot[3]);
+	check_glyph("lq_glyph LRU", 0, slot[0]);
+	lq_flush();
+
+	/* glyphs on screen kept their slots */
+	for(n=0;n<8;n++)
+		if(n != 1 && n != 3 && n != 6)
+			check_glyph_slot("lq_glyph on screen", slot[n], n);
+	check_glyph_slot("lq_glyph LRU", slot[3], 11);
+	check_glyph_slot("lq_glyph LRU", slot[1], 9);
+	check_glyph_slot("lq_glyph LRU", slot[6], 10);
+
+	/* cached glyphs to new cells: characters are written, CGRAM is not */
+	measure_start();
+	lq_buffer_goto(1, 0);
+	lq_buffer_write_char(check_glyph("lq_glyph cached", 9, slot[1]));
+	lq_buffer_write_char(check_glyph("lq_glyph cached", 4, slot[4]));
+	lq_buffer_write_char(check_glyph("lq_glyph cached", 11, slot[3]));
+	lq_flush();
+	measure_end("lq_glyph 3 cached", 3);
+	if(lcd.cgram_writes || lcd.data_writes != 3)
+	{
+		printf("FAIL lq_glyph cached: %u CGRAM rows, %u data writes\n",
+			   lcd.cgram_writes, lcd.data_writes);
+		failures++;
+	}
+
+	lq_buffer_clear();
+	lq_flush();
+}
+
+/************************************************************************/
+/* One second of a value changing at 200 Hz: flush after every change   */
+/* against 20 Hz refresh. Time runs in 50 us ticks of liquid_async.c.   */
+/************************************************************************/
+static void bench_refresh(BYTE refresh)
+{
+	const uint32_t tick = 50 * (F_CPU / 1000000UL);
+	unsigned t, value = 0;
+
+	if(refresh)
+	{
+		lq_refresh_start();
+		sei();
+	}
+	measure_start();
+	for(t=0;t<20000;t++)
+	{
+		/* producer every 5 ms */
+		if(t % 100 == 0)
+		{
+			lq_refresh_lock();
+			lq_buffer_goto(1, 0);
+			lq_buffer_write_u16(value++, 5);
+			lq_refresh_unlock();
+			if(!refresh)
+				lq_flush();
+		}
+		if(refresh && t % 1000 == 999)
+			TIMER1_COMPA_vect();
+		if(refresh && (TIMSK0 & (1<<OCIE0A)))
+			TIMER0_COMPA_vect();
+		host_delay_cycles(tick);
+	}
+	measure_end(refresh ? "200 Hz value, 20 Hz refresh" : "200 Hz value, flush each", 0);
+	if(refresh)
+	{
+		lq_refresh_stop();
+		while(!lq_idle())
+		{
+			TIMER0_COMPA_vect();
+			host_delay_cycles(tick);
+		}
+	}
+}
+#endif
+
+#if LCD_DISPLAYS > 1
+/************************************************************************/
+/* Displays one after another against interleaved lq_*_all()            */
+/************************************************************************/
+static int bench_multi()
+{
+	static struct hd44780sim models[LCD_DISPLAYS];
+	static lq_display_t displays[LCD_DISPLAYS];
+	lq_display_t* panels[LCD_DISPLAYS];
+	char row0[LCD_COLUMNS + 1], row1[LCD_COLUMNS + 1];
+	BYTE i;
+
+	printf("%d displays on simulated bus, transport %d, F_CPU %lu\n",
+		   LCD_DISPLAYS, LCD_TRANSPORT, (unsigned long)F_CPU);
+
+	measured = models;
+	measured_count = LCD_DISPLAYS;
+	lq_port_configuration();
+	for(i=0;i<LCD_DISPLAYS;i++)
+	{
+		hd44780sim_init(&models[i], 5 - i);
+		lq_display_init(&displays[i], 5 - i);
+		panels[i] = &displays[i];
+	}
+
+	measure_start();
+	for(i=0;i<LCD_DISPLAYS;i++)
+	{
+		lq_select(panels[i]);
+		lq_init();
+	}
+	measure_end("lq_init each", LCD_DISPLAYS);
+
+	measure_start();
+	lq_init_all(panels, LCD_DISPLAYS);
+	measure_end("lq_init_all", LCD_DISPLAYS);
+
+	/* different full screen to every display */
+	for(i=0;i<LCD_DISPLAYS;i++)
+	{
+		lq_select(panels[i]);
+		lq_buffer_write_string((BYTE*)"Display ");
+		lq_buffer_write_u16(i, 1);
+		lq_buffer_goto(1, 0);
+		lq_buffer_write_string((BYTE*)"ABCDEFGHIJKLMNOP");
+		lq_invalidate();
+	}
+	measure_start();
+	for(i=0;i<LCD_DISPLAYS;i++)
+	{
+		lq_select(panels[i]);
+		lq_flush();
+	}
+	measure_end("lq_flush each", LCD_DISPLAYS);
+
+	for(i=0;i<LCD_DISPLAYS;i++)
+	{
+		lq_select(panels[i]);
+		lq_invalidate();
+	}
+	measure_start();
+	lq_flush_all(panels, LCD_DISPLAYS);
+	measure_end("lq_flush_all", LCD_DISPLAYS);
+
+	for(i=0;i<LCD_DISPLAYS;i++)
+	{
+		char name[] = "display 0";
+
+		name[8] += i;
+		sprintf(row0, "Display %u       ", i);
+		padded(row1, "ABCDEFGHIJKLMNOP");
+		check_lcd_row(&models[i], name, 0, row0);
+		check_lcd_row(&models[i], name, 1, row1);
+	}
+
+	printf("%s, %d failures\n", failures ? "FAILED" : "OK", failures);
+	return failures ? 1 : 0;
+}
+#endif
+
+int main()
+{
+	char row0[LCD_COLUMNS + 1], row1[LCD_COLUMNS + 1];
+
+#if LCD_DISPLAYS > 1
+	return bench_multi();
+#endif
+
+	printf("liquid on simulated HD44780, transport %d, controller %d, F_CPU %lu\n",
+		   LCD_TRANSPORT, LCD_CONTROLLER, (unsigned long)F_CPU);
+
+	hd44780sim_init(&lcd, PIN_LCD_E);
+	lq_port_configuration();
+
+	measure_start();
+	lq_init();
+	measure_end("lq_init", 0);
+	padded(row0, "");
+	check_row("lq_init", 0, row0);
+	if(!(lcd.display_control & LCD_INSTRUCTION_DIS_DISPLAY_ON) ||
+	   (lcd.function_set & LCD_INSTRUCTION_FS_DATA_LENGTH_8BIT) != LCD_FUNCTION_SET_DATA_LENGTH)
+	{
+		printf("FAIL lq_init: display control %02X function set %02X\n",
+			   lcd.display_control, lcd.function_set);
+		failures++;
+	}
+
+	/* direct writes, busy flag waited after every byte */
+	measure_start();
+	lq_write_string((BYTE*)"0123456789ABCDEF");
+	measure_end("lq_write_string 16", 16);
+	padded(row0, "0123456789ABCDEF");
+	check_row("lq_write_string", 0, row0);
+
+	/* full redraw the old way */
+	measure_start();
+	lq_clear_display();
+	lq_write_string((BYTE*)"Temperature");
+	lq_set_ddram_address(LCD_ROW_ADDRESS(1));
+	lq_write_string((BYTE*)"23 C");
+	measure_end("clear + 2 rows", 15);
+	padded(row0, "Temperature");
+	padded(row1, "23 C");
+	check_row("clear + 2 rows", 0, row0);
+	check_row("clear + 2 rows", 1, row1);
+
+	/* same screen through shadow buffer */
+	lq_buffer_clear();
+	lq_buffer_write_string((BYTE*)"Temperature");
+	lq_buffer_goto(1, 0);
+	lq_buffer_write_string((BYTE*)"23 C");
+	lq_invalidate();
+	measure_start();
+	lq_flush();
+	measure_end("lq_flush full", LCD_ROWS * LCD_COLUMNS);
+	check_row("lq_flush full", 0, row0);
+	check_row("lq_flush full", 1, row1);
+
+	/* one changed number */
+	lq_buffer_goto(1, 0);
+	lq_buffer_write_u16(24, 2);
+	measure_start();
+	lq_flush();
+	measure_end("lq_flush 1 char", 1);
+	padded(row1, "24 C");
+	check_row("lq_flush 1 char", 1, row1);
+
+	measure_start();
+	lq_flush();
+	measure_end("lq_flush no change", 0);
+
+	/* scrolling: rewrite of the window per step against display shift */
+	{
+		static const char long_text[] = "Liquid scrolls long messages with display shift, one instruction per step +++ ";
+		static const char short_text[] = "Short ring";
+		unsigned step, steps = 100;
+
+		measure_start();
+		for(step=0;step<steps;step++)
+		{
+			scrolled(row0, long_text, step + 1);
+			lq_set_ddram_address(LCD_ROW_ADDRESS(0));
+			lq_write_string((BYTE*)row0);
+		}
+		measure_end("rewrite row, per step", steps);
+		check_row("rewrite row", 0, row0);
+
+		lq_scroll_text(0, (BYTE*)long_text);
+		lq_scroll_text(1, (BYTE*)short_text);
+		lq_scroll_start(1);
+		measure_start();
+		for(step=0;step<steps;step++)
+		{
+			lq_scroll_tick();
+			lq_scroll_update();
+		}
+		measure_end("lq_scroll long+short, per step", steps);
+		scrolled(row0, long_text, steps);
+		scrolled(row1, short_text, steps);
+		check_row("lq_scroll", 0, row0);
+		check_row("lq_scroll", 1, row1);
+
+		/* shadow buffer is right again after stop */
+		lq_scroll_stop();
+		lq_buffer_clear();
+		lq_buffer_write_string((BYTE*)"Stopped");
+		lq_flush();
+		padded(row0, "Stopped");
+		padded(row1, "");
+		check_row("lq_scroll_stop", 0, row0);
+		check_row("lq_scroll_stop", 1, row1);
+	}
+
+#if LCD_DISPLAYS == 1
+	/* fixed rate refresh, last value must be on screen */
+	lq_buffer_clear();
+	lq_flush();
+	bench_refresh(0);
+	bench_refresh(1);
+	padded(row0, "");
+	padded(row1, "  199");
+	check_row("lq_refresh", 0, row0);
+	check_row("lq_refresh", 1, row1);
+#endif
+
+	/* bar graph swept up and down a level at a time */
+	{
+		static const char* const names[] = { "lq_bar sweep, per step", "lq_bar jumps, per step" };
+		unsigned sweep, step, level = 0, steps = 2 * LCD_COLUMNS * LQ_BAR_STEPS;
+
+		lq_buffer_clear();
+		lq_flush();
+		for(sweep=0;sweep<2;sweep++)
+		{
+			measure_start();
+			for(step=0;step<steps;step++)
+			{
+				if(sweep == 0)
+					level = step < steps / 2 ? step + 1 : steps - step - 1;
+				else
+					level = (level * 37 + 11) % (LCD_COLUMNS * LQ_BAR_STEPS + 1);
+				lq_bar(0, 0, LCD_COLUMNS, level);
+				lq_flush();
+				if(bar_level(0, LCD_COLUMNS) != level)
+				{
+					printf("FAIL lq_bar level %u shows %u\n", level, bar_level(0, LCD_COLUMNS));
+					failures++;
+					break;
+				}
+			}
+			measure_end(names[sweep], steps);
+		}
+
+		/* scaled values reach both ends of the bar */
+		{
+			static const BYTE bits[] = { 8, 10, 12, 16 };
+			BYTE i;
+
+			for(i=0;i<sizeof(bits);i++)
+			{
+				uint16_t top = (1UL << bits[i]) - 1;
+
+				if(lq_bar_scale(0, bits[i], LCD_COLUMNS) != 0 || lq_bar_scale(1, bits[i], LCD_COLUMNS) != 1 ||
+				   lq_bar_scale(top, bits[i], LCD_COLUMNS) != LCD_COLUMNS * LQ_BAR_STEPS)
+				{
+					printf("FAIL lq_bar_scale %u bits\n", bits[i]);
+					failures++;
+				}
+			}
+		}
+	}
+
+	/* sparkline of 4 cells in slots 4..7, ring of 20 samples */
+	{
+		BYTE samples[4 * LQ_BAR_STEPS];
+		BYTE newest = 0, cell, x, line;
+		unsigned step;
+
+		memset(samples, 0, sizeof(samples));
+		lq_buffer_clear();
+		measure_start();
+		for(step=0;step<50;step++)
+		{
+			newest = newest == sizeof(samples) - 1 ? 0 : newest + 1;
+			samples[newest] = (step * 3) & 7;
+			lq_sparkline(1, LCD_COLUMNS - 4, 4, 4, samples, newest);
+			lq_flush();
+		}
+		measure_end("lq_sparkline 4 cells, per step", 50);
+
+		/* rightmost column of last cell is the newest sample */
+		for(cell=0;cell<4;cell++)
+			for(x=0;x<LQ_BAR_STEPS;x++)
+			{
+				BYTE sample = samples[(newest + 1 + cell * LQ_BAR_STEPS + x) % sizeof(samples)];
+
+				for(line=0;line<8;line++)
+				{
+					BYTE lit = (lcd.cgram[(4 + cell) * 8 + line] >> (4 - x)) & 1;
+					if(lit != (line == 7 - sample))
+					{
+						printf("FAIL lq_sparkline cell %u column %u row %u\n", cell, x, line);
+						failures++;
+					}
+				}
+			}
+		for(cell=0;cell<4;cell++)
+			lq_glyph_release(4 + cell);
+	}
+
+	check_glyph_cache();
+
+	printf("%s, %d failures\n", failures ? "FAILED" : "OK", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * host/lqsim_config.h
+ * ----------------------------------------------------------------------------
+ * Liquid configuration of host build. Included before every source file with
+ * gcc -include, the same way as the defines of an AVR project.
+ * Wiring is the default of hd44780lq.h: RS, R/W and E in PORTC, data in PORTD.
+ * Transport can be changed from command line with -DLCD_TRANSPORT=0.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef LQSIM_CONFIG_H
+#define LQSIM_CONFIG_H
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#ifndef LCD_TRANSPORT
+#define LCD_TRANSPORT 1
+#endif
+
+#define PIN_LCD_E 5
+#define PIN_LCD_RW 6
+#define PIN_LCD_RS 7
+#define MCU_COMMAND_DDR DDRC
+#define MCU_COMMAND_PORT PORTC
+#define MCU_DATA_DDR DDRD
+#define MCU_DATA_PORT PORTD
+#define MCU_DATA_PIN PIND
+
+#endif /* LQSIM_CONFIG_H */
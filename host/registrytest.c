@@ -0,0 +1,118 @@
+/*
+ * host/registrytest.c
+ * ----------------------------------------------------------------------------
+ * Device registry of tinyi2c_devices.c on PC. Bus is a model of
+ * tinyi2c_write_read() with one TC74 at 0x96, which counts the accesses
+ * that reach the bus. Checks that scan finds the device, that an absent
+ * device is probed with doubling back-off and that a device plugged in is
+ * found within TINYI2C_BACKOFF_MAX + 1 accesses.
+ *
+ * Build and run on PC, from repository root:
+ *
+ *   gcc -std=gnu99 -O2 -Wall -Ihost -I. -DF_CPU=16000000UL \
+ *       -include host/lqsim_config.h -o registrytest host/registrytest.c \
+ *       tinyi2c_devices.c host/avr_host.c host/hd44780sim.c && ./registrytest
+ *
+ * Exit status is 1 when any check fails.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <avr/io.h>
+#include "tinyi2c.h"
+
+#define ACCESSES 1000
+
+static int failures;
+
+/* bus model: device address (SLA+W) which answers and accesses on bus */
+static unsigned char bus_device = 0x96;
+static unsigned bus_accesses;
+
+unsigned char tinyi2c_write_read(unsigned char sla, unsigned char* write, unsigned char write_count,
+								 unsigned char* read, unsigned char read_count)
+{
+	bus_accesses++;
+	if((sla & ~I2CREAD) != bus_device)
+		return DEVICE_NOT_FOUND;
+	if(read_count)
+		read[0] = 25;
+	return 0;
+}
+
+/* bit rates are checked by host/tinyi2ctest.c */
+void tinyi2c_bit_rate(uint32_t scl_hz, unsigned char* twbr, unsigned char* twps)
+{
+	*twbr = 72;
+	*twps = 0;
+}
+
+static void check(const char* name, int ok)
+{
+	if(!ok)
+	{
+		printf("FAIL %s\n", name);
+		failures++;
+	}
+}
+
+/************************************************************************/
+/* Probes of an absent device when skip count doubles from 1 up to      */
+/* TINYI2C_BACKOFF_MAX                                                  */
+/************************************************************************/
+static unsigned expected_probes(unsigned accesses)
+{
+	unsigned probes = 0, skip = 1, next = 0, access;
+
+	for(access=0;access<accesses;access++)
+	{
+		if(access != next)
+			continue;
+		probes++;
+		next = access + skip + 1;
+		if(skip < TINYI2C_BACKOFF_MAX)
+			skip <<= 1;
+	}
+	return probes;
+}
+
+int main()
+{
+	tinyi2c_device_t found[8], sensor;
+	unsigned char value, count;
+	unsigned access, failed = 0;
+
+	/* scan probes every address once */
+	count = tinyi2c_scan(found, 8);
+	printf("scan: %u found, %u probes\n", count, bus_accesses);
+	check("scan", count == 1 && found[0].sla == 0x96 && found[0].present &&
+		  bus_accesses == TINYI2C_LAST_ADDRESS - TINYI2C_FIRST_ADDRESS + 1);
+
+	/* absent device */
+	tinyi2c_device_init(&sensor, 0x90, 100000);
+	bus_accesses = 0;
+	for(access=0;access<ACCESSES;access++)
+		if(tinyi2c_device_read_regs(&sensor, 0x00, &value, 1) == DEVICE_NOT_FOUND)
+			failed++;
+	printf("absent: %u reads, %u failed, %u on bus (%u expected)\n",
+		   ACCESSES, failed, bus_accesses, expected_probes(ACCESSES));
+	check("absent", failed == ACCESSES && bus_accesses == expected_probes(ACCESSES) &&
+		  sensor.errors == bus_accesses && sensor.last_error == DEVICE_NOT_FOUND && !sensor.present);
+
+	/* plugged in, found by the next probe */
+	bus_device = 0x90;
+	for(access=1;access<=TINYI2C_BACKOFF_MAX + 1;access++)
+		if(tinyi2c_device_read_regs(&sensor, 0x00, &value, 1) == 0)
+			break;
+	printf("plugged in: found after %u reads\n", access);
+	check("plugged in", access <= TINYI2C_BACKOFF_MAX + 1 && sensor.present && sensor.backoff == 1 && value == 25);
+
+	/* present device goes to the bus every time */
+	bus_accesses = 0;
+	for(access=0;access<10;access++)
+		tinyi2c_device_read_regs(&sensor, 0x00, &value, 1);
+	check("present", bus_accesses == 10);
+
+	printf("%s, %d failures\n", failures ? "FAILED" : "OK", failures);
+	return failures ? 1 : 0;
+}
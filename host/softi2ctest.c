@@ -0,0 +1,285 @@
+/*
+ * host/softi2ctest.c
+ * ----------------------------------------------------------------------------
+ * Software I2C of softi2c.h on PC. One bus "bus" is generated on PB0 (SCL)
+ * and PB1 (SDA). PINB of the bus is a function here: lines are open drain,
+ * low when the master sets its DDR bit or the slave model pulls them. The
+ * slave sees every edge at pin reads and delays and follows the bus bit
+ * by bit. It is at 0x96 with 16 registers, the first written byte is the
+ * register pointer, and it does not acknowledge data byte 0xFF.
+ *
+ * Checks START, repeated START and STOP of writes, reads and probes,
+ * acknowledges of address, data and last read byte, clock stretching by
+ * the slave and BUS_TIMEOUT with a slave which holds SCL low, after which
+ * the bus works again.
+ *
+ * Build and run on PC, from repository root:
+ *
+ *   gcc -std=gnu99 -O2 -Wall -Ihost -I. -DF_CPU=16000000UL \
+ *       -include host/lqsim_config.h -o softi2ctest host/softi2ctest.c \
+ *       host/avr_host.c host/hd44780sim.c && ./softi2ctest
+ *
+ * Exit status is 1 when any check fails.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+
+/* pin reads of softi2c.h go through the bus model */
+static uint8_t bus_pinb();
+#define PINB bus_pinb()
+
+#define SOFTI2C_NAME		bus
+#define SOFTI2C_SCL_PORT	B
+#define SOFTI2C_SCL_BIT		0
+#define SOFTI2C_SDA_PORT	B
+#define SOFTI2C_SDA_BIT		1
+#include "softi2c.h"
+
+#define SCL (1<<0)
+#define SDA (1<<1)
+#define SLAVE 0x96
+
+/* slave holds SCL low this long after a clock, or forever */
+#define STRETCH_FOREVER 0xFFFFFFFFUL
+
+extern void (*host_delay_hook)(void);
+
+static int failures;
+
+/* line levels the slave has seen, slave outputs */
+static unsigned char bus_scl = 1, bus_sda = 1;
+static unsigned char slave_scl_low, slave_sda_low;
+static uint32_t slave_stretch, stretch_after_address;
+static unsigned long pin_reads;
+
+/* slave state */
+#define SLAVE_IDLE 0     /* waits for START */
+#define SLAVE_ADDRESS 1  /* receives address */
+#define SLAVE_WRITTEN 2  /* receives data from master */
+#define SLAVE_READ 3     /* sends data to master */
+#define SLAVE_IGNORE 4   /* not addressed or read ended, waits for START or STOP */
+
+static unsigned char slave_state, slave_bit, slave_byte, slave_nack, slave_first;
+static unsigned char slave_registers[16];
+static unsigned char slave_pointer;
+static char bus_log[256];
+
+static void bus_trace(const char* text)
+{
+	strncat(bus_log, text, sizeof(bus_log) - strlen(bus_log) - 1);
+}
+
+static unsigned char scl_line()
+{
+	return !(DDRB & SCL) && !slave_scl_low;
+}
+
+static unsigned char sda_line()
+{
+	return !(DDRB & SDA) && !slave_sda_low;
+}
+
+/************************************************************************/
+/* SCL high: slave samples bit of master, or ACK of master after a byte */
+/* it sent                                                              */
+/************************************************************************/
+static void slave_scl_rise()
+{
+	if(slave_state == SLAVE_IDLE || slave_state == SLAVE_IGNORE)
+		return;
+	if(slave_bit < 8)
+	{
+		if(slave_state != SLAVE_READ)
+			slave_byte = (slave_byte << 1) | sda_line();
+	}
+	else if(slave_state == SLAVE_READ)
+	{
+		slave_nack = sda_line();
+		bus_trace(slave_nack ? "rN" : "rA");
+	}
+}
+
+/************************************************************************/
+/* SCL low: slave sets its SDA for the next bit or acknowledge          */
+/************************************************************************/
+static void slave_scl_fall()
+{
+	char text[8];
+
+	if(slave_state == SLAVE_IDLE || slave_state == SLAVE_IGNORE)
+		return;
+	slave_bit++;
+	if(slave_bit == 8)
+	{
+		/* byte done, acknowledge clock follows */
+		if(slave_state == SLAVE_ADDRESS)
+		{
+			sprintf(text, "[%02X]", slave_byte);
+			bus_trace(text);
+			slave_nack = (slave_byte & ~I2CREAD) != SLAVE;
+		}
+		else if(slave_state == SLAVE_WRITTEN)
+		{
+			sprintf(text, "w%02X", slave_byte);
+			bus_trace(text);
+			slave_nack = slave_byte == 0xFF;
+			if(!slave_nack && slave_first)
+				slave_pointer = slave_byte & 15;
+			else if(!slave_nack)
+				slave_registers[slave_pointer++ & 15] = slave_byte;
+			slave_first = 0;
+		}
+		slave_sda_low = slave_state != SLAVE_READ && !slave_nack;
+		return;
+	}
+	if(slave_bit == 9)
+	{
+		/* acknowledge clock done */
+		slave_bit = 0;
+		slave_sda_low = 0;
+		if(slave_nack)
+		{
+			slave_state = SLAVE_IGNORE;
+			return;
+		}
+		if(slave_state == SLAVE_ADDRESS)
+		{
+			slave_state = slave_byte & I2CREAD ? SLAVE_READ : SLAVE_WRITTEN;
+			slave_first = 1;
+			if(stretch_after_address)
+			{
+				slave_scl_low = 1;
+				slave_stretch = stretch_after_address;
+			}
+		}
+		if(slave_state == SLAVE_READ)
+			slave_byte = slave_registers[slave_pointer++ & 15];
+		else
+			slave_byte = 0;
+	}
+	if(slave_state == SLAVE_READ)
+		slave_sda_low = !((slave_byte << slave_bit) & 0x80);
+}
+
+/************************************************************************/
+/* Follows the lines: SCL falls first, then SDA changes (START or STOP  */
+/* when SCL is high), then SCL rises                                    */
+/************************************************************************/
+static void bus_update()
+{
+	unsigned char scl, sda;
+
+	if(slave_scl_low && slave_stretch != STRETCH_FOREVER && --slave_stretch == 0)
+		slave_scl_low = 0;
+
+	scl = scl_line();
+	if(bus_scl && !scl)
+	{
+		bus_scl = 0;
+		slave_scl_fall();
+	}
+	sda = sda_line();
+	if(sda != bus_sda)
+	{
+		bus_sda = sda;
+		if(bus_scl && !sda)
+		{
+			bus_trace(slave_state == SLAVE_IDLE ? "S" : "Sr");
+			/* SCL falls after START before the first bit */
+			slave_state = SLAVE_ADDRESS;
+			slave_bit = 0xFF;
+			slave_byte = 0;
+			slave_nack = 0;
+		}
+		else if(bus_scl)
+		{
+			bus_trace("P");
+			slave_state = SLAVE_IDLE;
+		}
+	}
+	scl = scl_line();
+	if(!bus_scl && scl)
+	{
+		bus_scl = 1;
+		slave_scl_rise();
+	}
+}
+
+static uint8_t bus_pinb()
+{
+	pin_reads++;
+	bus_update();
+	return (scl_line() ? SCL : 0) | (sda_line() ? SDA : 0);
+}
+
+static void check(const char* name, unsigned char status, unsigned char expected, const char* log)
+{
+	if(status != expected || (log && strcmp(bus_log, log)))
+	{
+		printf("FAIL %s: status %u, bus %s\n", name, status, bus_log);
+		failures++;
+	}
+	bus_log[0] = '\0';
+}
+
+int main()
+{
+	unsigned char data[3], i;
+	unsigned long reads;
+
+	for(i=0;i<16;i++)
+		slave_registers[i] = 0x10 + i;
+	host_delay_hook = bus_update;
+	bus_init();
+
+	check("write", bus_write_reg(0x96, 5, 0xAA), 0, "S[96]w05wAAP");
+	if(slave_registers[5] != 0xAA)
+	{
+		printf("FAIL write: register %02X\n", slave_registers[5]);
+		failures++;
+	}
+
+	check("read", bus_read_regs(0x96, 2, data, 3), 0, "S[96]w02Sr[97]rArArNP");
+	if(data[0] != 0x12 || data[1] != 0x13 || data[2] != 0x14)
+	{
+		printf("FAIL read: %02X %02X %02X\n", data[0], data[1], data[2]);
+		failures++;
+	}
+
+	check("absent device", bus_write_read(0x40, 0, 0, 0, 0), DEVICE_NOT_FOUND, "S[40]P");
+	check("data NACK", bus_write_reg(0x96, 1, 0xFF), DATA_NACK, "S[96]w01wFFP");
+
+	/* slave stretches the clock after both addresses */
+	stretch_after_address = 200;
+	check("stretched read", bus_read_regs(0x96, 2, data, 1), 0, "S[96]w02Sr[97]rNP");
+	if(data[0] != 0x12)
+	{
+		printf("FAIL stretched read: %02X\n", data[0]);
+		failures++;
+	}
+
+	/* slave holds SCL low for good, every wait ends in the timeout */
+	stretch_after_address = STRETCH_FOREVER;
+	reads = pin_reads;
+	check("stuck SCL", bus_read_regs(0x96, 2, data, 1), BUS_TIMEOUT, NULL);
+	reads = pin_reads - reads;
+	printf("stuck SCL: BUS_TIMEOUT after %lu pin reads, %lu per wait\n", reads,
+		   (unsigned long)SOFTI2C_STRETCH_LOOPS);
+	if(reads < SOFTI2C_STRETCH_LOOPS || reads > 20 * SOFTI2C_STRETCH_LOOPS)
+	{
+		printf("FAIL stuck SCL: waits are not bounded by TINYI2C_TIMEOUT_US\n");
+		failures++;
+	}
+
+	/* slave lets go, recovery frees the bus and it works again */
+	stretch_after_address = 0;
+	slave_scl_low = 0;
+	check("recover", bus_recover(), 0, NULL);
+	check("read after recovery", bus_read_regs(0x96, 2, data, 1), 0, "S[96]w02Sr[97]rNP");
+
+	printf("%s, %d failures\n", failures ? "FAILED" : "OK", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * host/tc74test.c
+ * ----------------------------------------------------------------------------
+ * TC74 driver of tc74.c on PC. Bus is a model of tinyi2c_write_read() with
+ * one TC74 at 0x96, which counts the accesses that reach the bus. Its
+ * first conversion after power up and after standby is done in
+ * FIRST_CONVERSION_MS. Checks that tc74_read() reads RWCR at most once per
+ * TC74_CONVERSION_MS while the conversion runs, gives TC74_CACHED without
+ * bus access between conversions, and that once a minute reads with
+ * tc74_read_sparse() wake the sensor, get a value and leave it in standby.
+ *
+ * Build and run on PC, from repository root:
+ *
+ *   gcc -std=gnu99 -O2 -Wall -Ihost -I. -DF_CPU=16000000UL \
+ *       -include host/lqsim_config.h -o tc74test host/tc74test.c tc74.c \
+ *       tinyi2c_devices.c host/avr_host.c host/hd44780sim.c && ./tc74test
+ *
+ * Exit status is 1 when any check fails.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <avr/io.h>
+#include "tc74.h"
+
+/* first conversion after power up or wake, longer than TC74_CONVERSION_MS */
+#define FIRST_CONVERSION_MS 300
+
+static int failures;
+
+/* sensor model: time in ms, start of conversions, registers */
+static uint32_t now;
+static uint32_t sensor_woken;
+static unsigned char sensor_pointer, sensor_shdn;
+static unsigned bus_accesses;
+
+unsigned char tinyi2c_write_read(unsigned char sla, unsigned char* write, unsigned char write_count,
+								 unsigned char* read, unsigned char read_count)
+{
+	bus_accesses++;
+	if((sla & ~I2CREAD) != TC74_ADDRESS(3))
+		return DEVICE_NOT_FOUND;
+	if(write_count)
+		sensor_pointer = write[0];
+	if(write_count > 1 && sensor_pointer == TC74_RWCR)
+	{
+		/* conversions start again when SHDN is cleared */
+		if(sensor_shdn && !(write[1] & TC74_SHDN))
+			sensor_woken = now;
+		sensor_shdn = write[1] & TC74_SHDN;
+	}
+	if(read_count)
+	{
+		if(sensor_pointer == TC74_RTR)
+			read[0] = (unsigned char)-5;
+		else
+			read[0] = sensor_shdn | (!sensor_shdn && now - sensor_woken >= FIRST_CONVERSION_MS ?
+									 TC74_DATA_RDY : 0);
+	}
+	return 0;
+}
+
+/* bit rates are checked by host/tinyi2ctest.c */
+void tinyi2c_bit_rate(uint32_t scl_hz, unsigned char* twbr, unsigned char* twps)
+{
+	*twbr = 72;
+	*twps = 0;
+}
+
+static void check(const char* name, int ok)
+{
+	if(!ok)
+	{
+		printf("FAIL %s\n", name);
+		failures++;
+	}
+}
+
+/************************************************************************/
+/* Reads every millisecond after power up                               */
+/************************************************************************/
+static void check_read()
+{
+	tc74_t sensor;
+	unsigned char status;
+	unsigned waiting = 0, readings = 0, cached = 0, bus_cached = 0, wrong = 0;
+	uint32_t first = 0, last = 0;
+	int8_t celsius;
+
+	now = 0;
+	sensor_woken = 0;
+	bus_accesses = 0;
+	tc74_init(&sensor, TC74_ADDRESS(3));
+	for(now=0;now<2000;now++)
+	{
+		unsigned before = bus_accesses;
+
+		status = tc74_read(&sensor, now, &celsius);
+		if(status == TC74_NOT_READY)
+			waiting = bus_accesses;
+		else if(status == 0)
+		{
+			if(!readings)
+				first = now;
+			else if(now - last < TC74_CONVERSION_MS)
+				wrong++;
+			last = now;
+			readings++;
+			if(celsius != -5)
+				wrong++;
+		}
+		else if(status == TC74_CACHED)
+		{
+			cached++;
+			if(bus_accesses != before)
+				bus_cached++;
+			if(celsius != -5)
+				wrong++;
+		}
+		else
+			wrong++;
+	}
+	printf("read: first reading at %lu ms after %u bus accesses, %u readings, %u cached\n",
+		   (unsigned long)first, waiting, readings, cached);
+	check("power up polls once per conversion", waiting <= FIRST_CONVERSION_MS / TC74_CONVERSION_MS + 1);
+	check("first reading", first >= FIRST_CONVERSION_MS && first < FIRST_CONVERSION_MS + TC74_CONVERSION_MS);
+	check("cached without bus", bus_cached == 0 && cached > 1500);
+	check("readings", readings >= (2000 - first) / TC74_CONVERSION_MS && wrong == 0);
+}
+
+/************************************************************************/
+/* Once a minute with tc74_read_sparse(), time counter wraps at 65536   */
+/************************************************************************/
+static void check_sparse()
+{
+	tc74_t sensor;
+	unsigned char status;
+	uint16_t logged_ms = 0;
+	unsigned logged = 0, per_minute = 0, most = 0, bus_cached = 0, before;
+	int8_t celsius;
+
+	now = 0;
+	sensor_woken = 0;
+	sensor_shdn = 0;
+	tc74_init(&sensor, TC74_ADDRESS(3));
+	for(now=0;now<10UL*60000 + 5000;now++)
+	{
+		if((uint16_t)((uint16_t)now - logged_ms) < 60000 && logged)
+			continue;
+		before = bus_accesses;
+		status = tc74_read_sparse(&sensor, (uint16_t)now, &celsius);
+		per_minute += bus_accesses - before;
+		if(status == 0)
+		{
+			logged++;
+			if(per_minute > most)
+				most = per_minute;
+			per_minute = 0;
+			check("standby after reading", sensor_shdn && celsius == -5);
+
+			/* soon after the reading it is cached */
+			before = bus_accesses;
+			status = tc74_read_sparse(&sensor, (uint16_t)(now + 1), &celsius);
+			if(status != TC74_CACHED || bus_accesses != before)
+				bus_cached++;
+		}
+		if(status != TC74_NOT_READY)
+			logged_ms = now;
+	}
+	printf("sparse: %u readings in 10 minutes, at most %u bus accesses per reading\n", logged, most);
+	check("sparse readings", logged == 11);
+	check("sparse bus accesses", most <= FIRST_CONVERSION_MS / TC74_CONVERSION_MS + 4);
+	check("sparse cached", bus_cached == 0);
+}
+
+int main()
+{
+	check_read();
+	check_sparse();
+
+	printf("%s, %d failures\n", failures ? "FAILED" : "OK", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * host/tinyi2ctest.c
+ * ----------------------------------------------------------------------------
+ * Checks of tinyi2c on PC. TWI registers are plain variables of
+ * host/avr_host.c.
+ *
+ * Bit rates: every rate asked from tinyi2c_init_hz() gives TWBR 10 or more
+ * and the closest SCL frequency which is not faster, unless the rate is
+ * faster than TWBR 10 allows or slower than TINYI2C_SCL_MIN_HZ. A byte
+ * always fits in TINYI2C_TIMEOUT_US.
+ *
+ * Interrupt driven transfers: a TWI model with one slave executes every
+ * TWCR command and calls TWI_vect. STOP keeps TWSTO set for a few steps or
+ * delays, a START written over it is logged as "!". Transfers are queued
+ * and read back, also ones submitted from the done callback and from the
+ * main loop while STOP is sent. A stuck bus is aborted by tinyi2c_wait()
+ * after the transfer time, and abort of a transfer which was finished
+ * after its timeout leaves the next one running.
+ *
+ * Build and run on PC, from repository root:
+ *
+ *   gcc -std=gnu99 -O2 -Wall -Ihost -I. -DF_CPU=16000000UL \
+ *       -include host/lqsim_config.h -o tinyi2ctest host/tinyi2ctest.c \
+ *       tinyi2c.c tinyi2c_async.c host/avr_host.c \
+ *       host/hd44780sim.c && ./tinyi2ctest
+ *
+ * Try also -DF_CPU=8000000UL. Exit status is 1 when any check fails.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "tinyi2c.h"
+
+/* simulated time of host/avr_host.c */
+extern uint64_t host_cycles;
+extern void (*host_delay_hook)(void);
+
+void TWI_vect(void);
+
+static int failures;
+
+/* SCL frequency of TWBR and prescaler bits */
+static uint32_t rate(uint32_t twbr, unsigned char twps)
+{
+	return F_CPU / (16 + (twbr << (1 + 2 * twps)));
+}
+
+/* exact SCL frequency of TWBR and prescaler bits is faster than hz */
+static int faster(uint32_t twbr, unsigned char twps, uint32_t hz)
+{
+	return F_CPU > (uint64_t)hz * (16 + (twbr << (1 + 2 * twps)));
+}
+
+/************************************************************************/
+/* Rates from 400 Hz to 1 MHz, about 1 % apart                          */
+/************************************************************************/
+static void check_bit_rates()
+{
+	uint32_t fastest = rate(10, 0), slowest = tinyi2c_init_hz(TINYI2C_SCL_MIN_HZ);
+	uint32_t hz, used;
+	unsigned checked = 0;
+
+	for(hz=400;hz<=1000000;hz+=hz/100 + 1)
+	{
+		unsigned char twbr, twps;
+
+		used = tinyi2c_init_hz(hz);
+		twbr = TWBR;
+		twps = TWSR & 3;
+		checked++;
+		if(twbr < 10 || used != rate(twbr, twps) || 9 * 1000000UL / used > TINYI2C_TIMEOUT_US)
+		{
+			printf("FAIL %lu Hz: TWBR %u prescaler %u gives %lu Hz\n",
+				   (unsigned long)hz, twbr, twps, (unsigned long)used);
+			failures++;
+			continue;
+		}
+		if(hz >= fastest)
+		{
+			if(used != fastest)
+			{
+				printf("FAIL %lu Hz: %lu Hz, not TWBR 10\n", (unsigned long)hz, (unsigned long)used);
+				failures++;
+			}
+			continue;
+		}
+		if(hz < TINYI2C_SCL_MIN_HZ)
+		{
+			if(used != slowest)
+			{
+				printf("FAIL %lu Hz: %lu Hz, not the slowest rate\n", (unsigned long)hz, (unsigned long)used);
+				failures++;
+			}
+			continue;
+		}
+		/* not faster than asked, and one TWBR step less would be */
+		if(faster(twbr, twps, hz) || (twbr > 10 && !faster(twbr - 1, twps, hz)))
+		{
+			printf("FAIL %lu Hz: %lu Hz is not the closest\n", (unsigned long)hz, (unsigned long)used);
+			failures++;
+		}
+	}
+	printf("bit rates: %u rates, %lu..%lu Hz at F_CPU %lu\n", checked,
+		   (unsigned long)slowest, (unsigned long)fastest, (unsigned long)F_CPU);
+
+	tinyi2c_init();
+	printf("TINYI2C_SCL_HZ %lu: %lu Hz, TWBR %u\n", (unsigned long)TINYI2C_SCL_HZ,
+		   (unsigned long)tinyi2c_scl_hz(), TWBR);
+	if(TWBR < 10 || tinyi2c_scl_hz() > TINYI2C_SCL_HZ)
+	{
+		printf("FAIL tinyi2c_init()\n");
+		failures++;
+	}
+}
+
+/* TWI model: slave 0x96 with 16 registers, first written byte is the
+ * register pointer. Stuck bus executes nothing. */
+#define SLAVE 0x96
+
+/* steps or delays while TWSTO stays set */
+#define TWI_STOP_STEPS 3
+
+static unsigned char slave_registers[16];
+static unsigned char slave_pointer;
+static unsigned char twi_started, twi_address, twi_mode, twi_stuck;
+static unsigned char twi_stopping, twi_restart;
+static char twi_log[256];
+
+static void twi_trace(const char* text)
+{
+	strncat(twi_log, text, sizeof(twi_log) - strlen(twi_log) - 1);
+}
+
+/************************************************************************/
+/* STOP on the bus, TWSTO is cleared when it is sent. START of STOP and */
+/* START together follows it.                                           */
+/************************************************************************/
+static void twi_tick()
+{
+	if(twi_stuck || !twi_stopping)
+		return;
+	if(!(TWCR & (1<<TWSTO)))
+	{
+		/* program wrote TWCR before STOP was sent */
+		twi_trace("!");
+		twi_stopping = 0;
+		return;
+	}
+	if(--twi_stopping)
+		return;
+	TWCR &= ~(1<<TWSTO);
+	twi_trace("P");
+	twi_started = 0;
+	twi_restart = (TWCR & (1<<TWSTA)) != 0;
+}
+
+/************************************************************************/
+/* Executes one TWCR command, returns 0 when there is none              */
+/************************************************************************/
+static int twi_step()
+{
+	unsigned char command;
+	char text[8];
+
+	if(twi_stopping)
+	{
+		twi_tick();
+		if(twi_stopping)
+			return !twi_stuck;
+	}
+	command = TWCR;
+	if(twi_stuck || !((command & (1<<TWINT)) || twi_restart))
+		return 0;
+	twi_restart = 0;
+	TWCR = command & ~(1<<TWINT);
+	if(command & (1<<TWSTO))
+	{
+		twi_stopping = TWI_STOP_STEPS;
+		return 1;
+	}
+	if(command & (1<<TWSTA))
+	{
+		twi_trace(twi_started ? "Sr" : "S");
+		TWSR = twi_started ? TW_REP_START : TW_START;
+		twi_started = 1;
+		twi_address = 1;
+	}
+	else if(twi_address)
+	{
+		unsigned char sla = TWDR;
+
+		sprintf(text, "[%02X]", sla);
+		twi_trace(text);
+		twi_address = 0;
+		twi_mode = (sla & 0xFE) != SLAVE ? 0 : (sla & 1) ? 2 : 3;
+		if(twi_mode == 0)
+			TWSR = (sla & 1) ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+		else
+			TWSR = (sla & 1) ? TW_MR_SLA_ACK : TW_MT_SLA_ACK;
+	}
+	else if(twi_mode == 3)
+	{
+		sprintf(text, "w%02X", TWDR);
+		twi_trace(text);
+		slave_pointer = TWDR & 15;
+		twi_mode = 1;
+		TWSR = TW_MT_DATA_ACK;
+	}
+	else if(twi_mode == 1)
+	{
+		sprintf(text, "w%02X", TWDR);
+		twi_trace(text);
+		slave_registers[slave_pointer++ & 15] = TWDR;
+		TWSR = TW_MT_DATA_ACK;
+	}
+	else if(twi_mode == 2)
+	{
+		TWDR = slave_registers[slave_pointer++ & 15];
+		twi_trace(command & (1<<TWEA) ? "rA" : "rN");
+		TWSR = command & (1<<TWEA) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+	}
+	if(TWCR & (1<<TWIE))
+		TWI_vect();
+	return 1;
+}
+
+static void twi_run()
+{
+	unsigned steps;
+
+	for(steps=0;steps<1000 && twi_step();steps++);
+}
+
+static void check_transfer(const char* name, tinyi2c_transfer_t* transfer, unsigned char status, const char* log)
+{
+	if(transfer->status != status || (log && strcmp(twi_log, log)))
+	{
+		printf("FAIL %s: status %u, bus %s\n", name, transfer->status, twi_log);
+		failures++;
+	}
+	twi_log[0] = '\0';
+}
+
+/* runs the model until STOP is being sent */
+static void twi_run_to_stop()
+{
+	unsigned steps;
+
+	for(steps=0;steps<1000 && !twi_stopping && twi_step();steps++);
+}
+
+/* done callback which submits one more transfer */
+static tinyi2c_transfer_t* submit_next;
+
+static void submit_from_done(tinyi2c_transfer_t* transfer)
+{
+	if(submit_next)
+		tinyi2c_submit(submit_next);
+	submit_next = 0;
+}
+
+/************************************************************************/
+/* Queued transfers and abort of a stuck bus                            */
+/************************************************************************/
+static void check_async()
+{
+	unsigned char reg = 2, data[6], values[3] = { 5, 0xAA, 0xBB };
+	tinyi2c_transfer_t read = { SLAVE, &reg, 1, data, 6 };
+	tinyi2c_transfer_t write = { SLAVE, values, 3 };
+	tinyi2c_transfer_t probe = { 0x40 };
+	uint64_t start;
+	unsigned i;
+
+	for(i=0;i<16;i++)
+		slave_registers[i] = 0x10 + i;
+	host_delay_hook = twi_tick;
+	tinyi2c_async_init();
+	sei();
+
+	tinyi2c_submit(&read);
+	twi_run();
+	check_transfer("read", &read, 0, "S[96]w02Sr[97]rArArArArArNP");
+	if(data[0] != 0x12 || data[5] != 0x17)
+	{
+		printf("FAIL read: %02X..%02X\n", data[0], data[5]);
+		failures++;
+	}
+
+	tinyi2c_submit(&write);
+	tinyi2c_submit(&probe);
+	twi_run();
+	check_transfer("write", &write, 0, NULL);
+	check_transfer("probe", &probe, DEVICE_NOT_FOUND, NULL);
+	if(slave_registers[5] != 0xAA || slave_registers[6] != 0xBB || !tinyi2c_idle())
+	{
+		printf("FAIL write: registers %02X %02X\n", slave_registers[5], slave_registers[6]);
+		failures++;
+	}
+
+	/* transfer submitted from done callback follows STOP of the one
+	 * before, not over it */
+	write.done = submit_from_done;
+	submit_next = &read;
+	tinyi2c_submit(&write);
+	twi_run();
+	write.done = 0;
+	check_transfer("write, read from callback", &write, 0, "S[96]w05wAAwBBPS[96]w02Sr[97]rArArArArArNP");
+	check_transfer("read from callback", &read, 0, NULL);
+
+	/* main loop submits while STOP is being sent */
+	tinyi2c_submit(&write);
+	twi_run_to_stop();
+	tinyi2c_submit(&probe);
+	twi_run();
+	check_transfer("write, probe during STOP", &write, 0, "S[96]w05wAAwBBPS[40]P");
+	check_transfer("probe during STOP", &probe, DEVICE_NOT_FOUND, NULL);
+
+	/* read finishes between its timeout and abort, write after it must
+	 * not be aborted */
+	tinyi2c_submit(&read);
+	tinyi2c_submit(&write);
+	for(i=0;i<1000 && read.status == TINYI2C_PENDING && twi_step();i++);
+	tinyi2c_abort(&read);
+	twi_run();
+	check_transfer("write after late abort", &write, 0, "S[96]w02Sr[97]rArArArArArNPS[96]w05wAAwBBP");
+	check_transfer("read before late abort", &read, 0, NULL);
+
+	/* read of 1 + 6 bytes gets stuck, waits 10 slots of TINYI2C_TIMEOUT_US
+	 * and the write after it runs when the bus works again */
+	twi_stuck = 1;
+	tinyi2c_submit(&read);
+	tinyi2c_submit(&write);
+	start = host_cycles;
+	tinyi2c_wait(&read);
+	twi_stuck = 0;
+	twi_started = 0;
+	twi_run();
+	start = (host_cycles - start) / (F_CPU / 1000000UL);
+	printf("stuck bus: aborted after %lu us\n", (unsigned long)start);
+	check_transfer("write after abort", &write, 0, "S[96]w05wAAwBBP");
+	check_transfer("stuck read", &read, BUS_TIMEOUT, NULL);
+	if(start < 10 * TINYI2C_TIMEOUT_US || start > 10 * TINYI2C_TIMEOUT_US + 200 || !(SREG & 0x80))
+	{
+		printf("FAIL stuck bus: wait was not 10 * TINYI2C_TIMEOUT_US\n");
+		failures++;
+	}
+}
+
+int main()
+{
+	check_bit_rates();
+	check_async();
+
+	printf("%s, %d failures\n", failures ? "FAILED" : "OK", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * host/util/delay.h
+ * ----------------------------------------------------------------------------
+ * Host build replacement of <util/delay.h>. Delays do not wait, they 
+ * advance simulated time by the same number of CPU cycles as on AVR and
+ * let simulated devices look at the port pins (host/avr_host.c).
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#include <stdint.h>
+
+#ifndef F_CPU
+# warning "F_CPU not defined for host <util/delay.h>"
+#define F_CPU 1000000UL
+#endif
+
+extern void host_delay_cycles(uint32_t cycles);
+
+#define __builtin_avr_delay_cycles(cycles) host_delay_cycles(cycles)
+
+static inline void _delay_us(double us)
+{
+	host_delay_cycles((uint32_t)(us * (F_CPU / 1000000.0) + 0.999));
+}
+
+static inline void _delay_ms(double ms)
+{
+	host_delay_cycles((uint32_t)(ms * (F_CPU / 1000.0) + 0.999));
+}
+
+#endif /* HOST_UTIL_DELAY_H */
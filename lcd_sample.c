@@ -5,230 +5,97 @@
  *  Author: pheinone
  */ 
 
-#include <avr/io.h>
-#include <util/delay.h>
-#include <stdlib.h>
-
 /************************************************************************/
 /* Porttiasetukset                                                      */
 /************************************************************************/
 // projektissa kytetn 4bittist lcd interfacea. 
 // LCD:n datavyl eli DB4-DB7 on kytketty ATmegan pinneihin PORTB0-PORTB3
 // RS on kytketty PORTB4, RW PORTB5, EN PORTB6
-#define LCD_PORT PORTB
-#define LCD_PORT_DIR DDRB
-#define EN 6
-#define RW 5
-#define RS 4
+// Samat mrittelyt on annettava mys liquid.c:lle, esim. projektin
+// asetuksissa (-D), koska kirjasto knnetn erikseen.
+#define LCD_TRANSPORT 1 // LCD_TRANSPORT_4BIT
+#define LCD_DATA_SHIFT 0
+#define MCU_COMMAND_DDR DDRB
+#define MCU_COMMAND_PORT PORTB
+#define MCU_DATA_DDR DDRB
+#define MCU_DATA_PORT PORTB
+#define MCU_DATA_PIN PINB
+#define PIN_LCD_E 6
+#define PIN_LCD_RW 5
+#define PIN_LCD_RS 4
+
+#include <avr/io.h>
+#include <util/delay.h>
+#include "liquid.h"
 
 /* MCU ohjelmointi on 80% datasheetien tulkintaa ja 20% kahvinjuontia.
- * Komentojen sek varsinaisen merkkidatan kirjoitus LCD:lle on 
- * ohjelmoitu HD44780 datasheetin sivun 33 kuvan "Example of 4-Bit Data 
- * Transfer Timing Sequence" mukaan. Kuvassa RS signaali on 1 eli 
- * kirjoitetaan dataa. Komennon kirjoittamisessa RS on vastaavasti 0.
+ * LCD:n 4bittinen ajuri on liquid-kirjastossa (liquid_bus.h). Se kirjoittaa
+ * nibblet HD44780 datasheetin sivun 33 kuvan "Example of 4-Bit Data 
+ * Transfer Timing Sequence" mukaan alle mikrosekunnin E-pulssilla ja
+ * lukee busy flagin PINB:st, joten merkki vie noin 40us eik 10ms.
  * HD44780 datasheet: http://www.sparkfun.com/datasheets/LCD/HD44780.pdf
  */
 
-/* esitelln prototyypit, ettei tule void paluuarvoja miss ei pitisi.
- * avr-gcc pillastuu ilman nit. 
+/* TC74A3 lmptila-anturi on I2C-vylll (PD0 SCL, PD1 SDA). Ajuri
+ * tc74.c lukee sen tinyi2c:n kautta ja vlimuistittaa lukeman, koska TC74
+ * tekee uuden mittauksen vain noin 8 kertaa sekunnissa.
  */
-void lcd_init();
-void write_cmd(unsigned char cmd);
-void write_data(unsigned char data);
-void signal_e();
-void wait_bf();
-void write_string(char *str);
-void i2c_init2();
-unsigned char read_temp();
+#include "tc74.h"
 
 int main()
 {
-	// portin suunnaksi lht, tuloa tarvitaan esim. kun kysytn 
-	// LCD:lt busyflagia (BF)
-	LCD_PORT_DIR = 0xff;
+	tc74_t anturi;
+	int8_t lampotila;
+	uint16_t aika_ms = 0;
+	unsigned char tila;
+	BYTE teksti[7], pituus;
 	
-	// alustetaan lcd
-	lcd_init();
+	// alustetaan lcd, liquid asettaa portin suunnat
+	lq_port_configuration();
+	lq_init();
 	
-	// alustetaan i2c vyl
-	i2c_init2();
+	// alustetaan i2c vyl, 100 kHz F_CPU:sta laskettuna
+	tinyi2c_init();
+	tc74_init(&anturi, TC74_ADDRESS(3));
 	
-	write_cmd(0x01); // nytn tyhjennys
-	
-	// kirjoitetaan "Lmptila: 24 C"
-	write_data('L');
-	write_data(0b11100001); //
-	write_data('m');
-	write_data('p');
-	write_data(0b11101111); //
-	write_data('t');
-	write_data('i');
-	write_data('l');
-	write_data('a');
-	write_data(':');
+	// kirjoitetaan "Lmptila: 24 C" varjopuskuriin, lq_flush() lhett
+	// LCD:lle vain muuttuneet merkit
+	lq_buffer_write_string((BYTE*)"L\xE1mp\xEFtila:"); // \xE1 on  ja \xEF 
 	
 	while(1)
 	{
-		write_cmd(1<<7 | 10); // siirrytn positioon 10 ekalle riville
-		unsigned char lampotila_sensorilta = read_temp();
-		unsigned char buffer[7];
-		unsigned char debug_buffer[7]; 
-		itoa(lampotila_sensorilta, debug_buffer, 10);
+		lq_buffer_goto(0, 10); // siirrytn positioon 10 ekalle riville
 		
-		/* TC74 datasheetin Taulukossa kuvataan lmptilan digitalisointi
+		/* tc74_read() ky vylll vain kun uusi mittaus voi olla valmis,
+		 * muuten se palauttaa edellisen lukeman ja tilan TC74_CACHED. 
+		 * TC74 datasheetin Taulukossa kuvataan lmptilan digitalisointi
 		 * TABLE 4-4: TEMPERATURE-TO-DIGITAL VALUE CONVERSION 
-		 * -65...+130C
-		 * 0-127 = + alue ja 128-256 on - alue
+		 * -65...+130C, kahden komplementti eli int8_t suoraan
 		 */
-		if (lampotila_sensorilta > 127) {
-			write_data('-');
-			lampotila_sensorilta = ~lampotila_sensorilta+1;
+		tila = tc74_read(&anturi, aika_ms, &lampotila);
+		if(tila == 0 || tila == TC74_CACHED)
+		{
+			// etumerkki ja luku tasataan oikealle neljn merkkiin,
+			// jolloin "C" pttyy aina ensimmisen rivin sarakkeeseen 15
+			pituus = lq_format_s16(teksti, lampotila, 0, ' ') + (lampotila > 0);
+			while(pituus++ < 4)
+				lq_buffer_write_char(' ');
+			if(lampotila > 0)
+				lq_buffer_write_char('+');
+			lq_buffer_write_string(teksti);
+			lq_buffer_write_char(0b11011111); //aste-merkki
+			lq_buffer_write_char('C');
 		}
-		else if(lampotila_sensorilta>0)
+		else
 		{
-			write_data('+');
+			// anturia ei lydy tai ensimminen mittaus on kesken. Viiva
+			// tytetn kentn levyiseksi (+130C), ettei vanhan lukeman
+			// merkkej j nkyviin
+			lq_buffer_write_string((BYTE*)"--    ");
 		}
-		itoa(lampotila_sensorilta, buffer, 10);
-		write_string(buffer);
-		write_data(0b11011111); //aste-merkki
-		write_data('C');
 		
-		write_cmd(1<<7 | 18); // siirrytn positioon 1 toiselle riville
-		write_string(debug_buffer);
-		_delay_ms(1000);
-	}
-}
-
-/************************************************************************/
-/* LCD:n alustus                                                        */
-/************************************************************************/
-void lcd_init()
-{
-	/* 4bit moodiin resetointi 
-	 * datasheet sivu 46: Figure 24, 4-Bit Interface
-	 * Resetointibitit voi lhett mys yhten 4 bitin pakettina
-	 * kerrallaan mutta kytetn tss samaa funktiota kuin
-	 * LCD:n asetusbiteiss. Lopputulos on sama.
-	 */
-	write_cmd(0x03);
-	write_cmd(0x03);
-	write_cmd(0x03);
-	write_cmd(0x02);
-		
-	/* LCD:n asetusbitit.
-	 * datasheet sivu 42: Table 12 4-Bit Operation ja sivu 24 Instructions
-	 * 4bit moodissa vain DB7-DB4 on kytss.
-	 */
-	write_cmd(0x20); // 4bit mode on annettava viel kerran
-	write_cmd(0x0C); // nytt plle, kursori piiloon.
-	//demomode: 
-	//write_cmd(0x0F); // nytt plle ja demon vuoksi kursori vilkkumaan.
-	write_cmd(0x06); // entry moodi: kirjoitus ja kursorisuunta oikealle
-	write_cmd(0x01); // nytn tyhjennys
-
-}
-
-/************************************************************************/
-/* Lhetetn komento (instruction) vyllle ja signaloidaan E          */
-/* jotta komento siirtyy LCD:n komentorekisteriin (IR)                  */
-/* RS=0, valittuna IR eli komentorekisteri.                             */
-/************************************************************************/
-void write_cmd(unsigned char cmd)
-{
-	wait_bf();  // ei vlttmtn
-	LCD_PORT = (cmd>>4 & 0x0F); // eniten merkitsevt 4bitti
-	signal_e();
-	
-	LCD_PORT = (cmd & 0x0F); // vhiten merkitsevt 4bitti
-	signal_e();
-}
-
-/************************************************************************/
-/* Lhetetn data vyllle ja signaloidaan E jotta data siirtyy        */
-/* LCD:n datarekisterii (DR). RS=1, eli valittuna datarekisteri.        */
-/************************************************************************/
-void write_data(unsigned char data)
-{
-	wait_bf(); //ei vlttmtn
-	LCD_PORT = (data>>4 & 0x0F)|(1<<RS); // eniten merkitsevt 4bitti
-	signal_e();
-	
-	LCD_PORT = (data & 0x0F)|(1<<RS); // vhiten merkitsevt 4bitti
-	signal_e();
-}
-
-/************************************************************************/
-/* lhetetn E-signaali, vylll oleva tieto kirjoitetaan lcd:lle     */ 
-/* E-signaalin laskevalla reunalla.										*/
-/************************************************************************/
-void signal_e()
-{
-	LCD_PORT |= (1<<EN);
-	_delay_ms(5);
-	LCD_PORT &= ~(1<<EN); // komennetaan LCD:t lukemaan vyllt
-}
-
-/************************************************************************/
-/* Tarkistetaan ja odotetaan, ett edellinen komento suoritetaan        */
-/* luetaan tm statusrekisterin ylimmst bitist, BF				    */
-/************************************************************************/
-void wait_bf()
-{
-	LCD_PORT_DIR = 0xF0; // datapinnit tuloksi, koska luetaan busy flagia
-	LCD_PORT |= (1<<RW); //RW=1
-	LCD_PORT &= ~(1<<RS);//RS=0
-
-	while (LCD_PORT >= 0x80) //0x80 on Busy flag, datasheet sivu 24.
-	{
-		 signal_e();
-	}
-	LCD_PORT_DIR = 0xFF; // asetetaan kaikki pinnit takaisin lhdiksi
-}
-
-/************************************************************************/
-/* Kirjoittaa merkkijonon merkki kerrallaan                             */
-/************************************************************************/
-void write_string(char *str)
-{
-	while(*str > 0)
-	{
-		write_data(*str++);
+		lq_flush();
+		_delay_ms(100);
+		aika_ms += 100;
 	}
 }
-
-/************************************************************************/
-/* Alustetaan I2C-vyl                                                 */
-/************************************************************************/
-void i2c_init2()
-{
-	DDRD = DDRD & 0xfc; // scl & sda portit tuloiksi
-	PORTD |= (1<<PD1); // pull-up bit 1, SDA
-	PORTD |= (1<<PD0); // pull-up bit 0, SCL
-	TWSR = 0x00; //prescaler=1
-	TWBR = 0x04; // clockfreq = 2mhz/(16+2*4*4^1) = ~41,5khz	
-}
-
-/************************************************************************/
-/* luetaan i2c-vyllt TC74 lmptila                                  */
-/* TC74 A3, 5.0V AT			                                            */
-// model: 11103GU                                                       */
-/************************************************************************/
-unsigned char read_temp()
-{
-	char vastaus;
-	TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN);
-	while (!(TWCR & (1<<TWINT)));
-	
-	// TC74 osoite vylll
-	TWDR = 0x97;
-	
-	TWCR = (1<<TWINT)|(1<<TWEN);
-	while (!(TWCR & (1<<TWINT)));
-	
-	TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWEA);
-	while (!(TWCR & (1<<TWINT)));
-	
-	vastaus = TWDR;
-	return vastaus;
-}
-
@@ -35,8 +35,58 @@
  */
 
 #include "liquid.h"
-#include <stdlib.h>
+#include "liquid_bus.h"
+#include <string.h>
 
+/* lq_display_t address field: DDRAM address, CGRAM address with 
+ * LQ_ADDRESS_CGRAM or LQ_ADDRESS_UNKNOWN */
+#define LQ_ADDRESS_CGRAM 0x80
+#define LQ_ADDRESS_UNKNOWN 0xFF
+
+/* State of the display. With one display it is here, with LCD_DISPLAYS > 1
+ * application owns them and lq_select() tells which one is used. See 
+ * lq_display_t in liquid.h for the fields. A constant address makes the 
+ * single display case as fast as plain static variables.
+ */
+#if LCD_DISPLAYS > 1
+static lq_display_t* lq_current;
+
+/* E of selected display (or displays) for LCD_SET_CLOCK_ENABLED_HIGH/LOW */
+BYTE lq_e_mask;
+#else
+static lq_display_t lq_display =
+{
+	.glyph_lru = { 0, 1, 2, 3, 4, 5, 6, 7 },
+	.cgram_unknown = 0xFF,
+	.address = LQ_ADDRESS_UNKNOWN
+};
+#define lq_current (&lq_display)
+#endif
+
+
+/************************************************************************/
+/* Write byte to instruction (LQ_INSTRUCTION) or data (LQ_DATA)         */
+/* register of LCD. Does not wait until LCD has executed it.            */
+/************************************************************************/
+void lq_write_raw(BYTE value, BYTE mode)
+{
+	lq_bus_write(value, mode);
+}
+
+/************************************************************************/
+/* Wait until LCD has executed the write                                */
+/************************************************************************/
+#if LCD_BUS_BLIND
+static inline void lq_wait_executed(BYTE value, BYTE mode)
+{
+	/* transport is slower than LCD, only clear display and return home
+	 * (instructions with bits 2..7 zero) must be waited for */
+	if(mode == LQ_INSTRUCTION && value < LCD_INSTRUCTION_ENTRY_MODE)
+		_delay_us(LCD_EXECUTION_TIME_LONG_US);
+}
+#else
+#define lq_wait_executed(value, mode) lq_waitbusy()
+#endif
 
 /************************************************************************/
 /* Write command to LCD                                                 */
@@ -44,25 +94,9 @@
 /************************************************************************/
 void lq_write_instruction(BYTE instruction)
 {
-	LCD_SET_INSTRUCTION_MODE;
-	MCU_SET_DATA_OUT;
-	LCD_SET_WRITE_MODE;
-	
-	/* we must enable LCD every time before command write */
-	LCD_SET_CLOCK_ENABLED_HIGH;
-	
-	/* give some time to slow LCD to read the databus */
-	_delay_us(15);
-	
-	MCU_DATA_PORT = instruction;
-	
-	/* Disable LCD again by setting no voltage to command signals */
-	LCD_SET_CLOCK_ENABLED_LOW;
-	
-	/* Allow some more delay */
-	_delay_us(5);
-	
-	lq_waitbusy();
+	lq_current->address = LQ_ADDRESS_UNKNOWN;
+	lq_write_raw(instruction, LQ_INSTRUCTION);
+	lq_wait_executed(instruction, LQ_INSTRUCTION);
 }
 
 /************************************************************************/
@@ -70,25 +104,19 @@ void lq_write_instruction(BYTE instruction)
 /************************************************************************/
 void lq_write_data(BYTE data)
 {
-	LCD_SET_DATA_MODE;
-	MCU_SET_DATA_OUT;
-	LCD_SET_WRITE_MODE;
-	
-	/* we must enable LCD every time before command write */
-	LCD_SET_CLOCK_ENABLED_HIGH;
-	
-	/* give some time to slow LCD to read the databus */
-	_delay_us(15);
-	
-	MCU_DATA_PORT = data;
-	
-	/* Disable LCD again by setting no voltage to command signals */
-	LCD_SET_CLOCK_ENABLED_LOW;
-	
-	/* Allow some more delay */
-	_delay_us(5);
-	
-	lq_waitbusy();	
+	lq_current->address = LQ_ADDRESS_UNKNOWN;
+	lq_write_raw(data, LQ_DATA);
+	lq_wait_executed(data, LQ_DATA);
+}
+
+/************************************************************************/
+/* Write to a bus stream and wait, lq_flush() output for lq_flush_with() */
+/************************************************************************/
+static BYTE lq_stream_write_and_wait(BYTE value, BYTE mode)
+{
+	lq_bus_stream_write(value, mode);
+	lq_wait_executed(value, mode);
+	return 1;
 }
 
 /************************************************************************/
@@ -97,12 +125,19 @@ void lq_write_data(BYTE data)
 void lq_write_string(BYTE* data)
 {
 	uint16_t i=0;
+	
+	lq_current->address = LQ_ADDRESS_UNKNOWN;
+	
+	/* whole string is one stream, with I2C transport one transaction */
+	lq_bus_stream_begin();
+	
 	/* write char until terminator mark */
 	while(data[i] !='\0')
 	{
-		lq_write_data(data[i]);
+		lq_stream_write_and_wait(data[i], LQ_DATA);
 		i++;
 	}
+	lq_bus_stream_end();
 }	
 
 /************************************************************************/
@@ -110,8 +145,9 @@ void lq_write_string(BYTE* data)
 /************************************************************************/
 void lq_write_16bit_number(long number)
 {
-	char num[16];
-	itoa(number,num,10);
+	/* long is 32 bits, itoa() truncated it to int */
+	BYTE num[12];
+	lq_format_s32(num,number,0,' ');
 	lq_write_string(num);
 }
 
@@ -138,6 +174,250 @@ void lq_waitbusy()
 void lq_clear_display()
 {
 	lq_write_instruction(LCD_INSTRUCTION_CLEAR_DISPLAY);
+	
+	/* clear writes spaces to all DDRAM, so the shadow is known again */
+	memset(lq_current->sent, ' ', sizeof(lq_current->sent));
+	lq_current->sent_valid = 1;
+}
+
+/************************************************************************/
+/* Set DDRAM address, next data write goes to this address              */
+/************************************************************************/
+void lq_set_ddram_address(BYTE address)
+{
+	lq_write_instruction(LCD_INSTRUCTION_SET_DDRAM_ADDRESS | address);
+}
+
+/************************************************************************/
+/* Clears the shadow buffer. Nothing is sent before lq_flush()          */
+/************************************************************************/
+void lq_buffer_clear()
+{
+	memset(lq_current->screen, ' ', sizeof(lq_current->screen));
+	memset(lq_current->glyph_refs, 0, sizeof(lq_current->glyph_refs));
+	lq_current->cursor = 0;
+}
+
+/************************************************************************/
+/* Moves shadow buffer cursor to given row and column                   */
+/************************************************************************/
+void lq_buffer_goto(BYTE row, BYTE column)
+{
+	if(row >= LCD_ROWS || column >= LCD_COLUMNS)
+		return;
+	lq_current->cursor = row * LCD_COLUMNS + column;
+}
+
+/************************************************************************/
+/* Write character to shadow buffer                                     */
+/************************************************************************/
+void lq_buffer_write_char(BYTE data)
+{
+	lq_display_t* display = lq_current;
+	
+	/* characters beyond the last cell are dropped */
+	if(display->cursor >= sizeof(display->screen))
+		return;
+	
+	/* keep count of glyphs on screen, codes 8..15 are same as 0..7 */
+	if(display->screen[display->cursor] < 16)
+		display->glyph_refs[display->screen[display->cursor] & 7]--;
+	if(data < 16)
+		display->glyph_refs[data & 7]++;
+	
+	display->screen[display->cursor++] = data;
+}
+
+/************************************************************************/
+/* Write string to shadow buffer                                        */
+/************************************************************************/
+void lq_buffer_write_string(BYTE* data)
+{
+	while(*data != '\0')
+	{
+		lq_buffer_write_char(*data++);
+	}
+}
+
+/************************************************************************/
+/* Write 16 bit number to shadow buffer                                 */
+/************************************************************************/
+void lq_buffer_write_16bit_number(long number)
+{
+	BYTE num[12];
+	lq_format_s32(num,number,0,' ');
+	lq_buffer_write_string(num);
+}
+
+/************************************************************************/
+/* Forget what has been sent, next lq_flush() rewrites every cell.      */
+/* Call this after writing to LCD with lq_write_* functions.            */
+/************************************************************************/
+void lq_invalidate()
+{
+	lq_current->sent_valid = 0;
+	lq_current->cgram_unknown = 0xFF;
+	lq_current->address = LQ_ADDRESS_UNKNOWN;
+}
+
+/************************************************************************/
+/* Returns character code (0..7) showing the 5x8 glyph, bitmap is eight */
+/* rows of five bits. Glyph is uploaded to CGRAM by the next lq_flush() */
+/* only when it is not there already. When all slots are on screen      */
+/* returns LQ_GLYPH_NONE.                                               */
+/************************************************************************/
+BYTE lq_glyph(const BYTE* bitmap)
+{
+	lq_display_t* display = lq_current;
+	BYTE i, slot, mask;
+	
+	/* already in CGRAM */
+	for(i=0;i<8;i++)
+	{
+		slot = display->glyph_lru[i];
+		if((display->glyph_used & (1<<slot)) && memcmp(display->cgram[slot], bitmap, 8) == 0)
+			goto found;
+	}
+	
+	/* evict least recently used slot which is not on screen, 
+	 * free slots are never used so they are at the end */
+	for(i=8;i>0;)
+	{
+		i--;
+		slot = display->glyph_lru[i];
+		mask = 1<<slot;
+		if(!(display->glyph_reserved & mask) && display->glyph_refs[slot] == 0)
+		{
+			memcpy(display->cgram[slot], bitmap, 8);
+			display->glyph_used |= mask;
+			goto found;
+		}
+	}
+	return LQ_GLYPH_NONE;
+	
+found:
+	/* move to front of LRU list */
+	for(;i>0;i--)
+		display->glyph_lru[i] = display->glyph_lru[i-1];
+	display->glyph_lru[0] = slot;
+	return slot;
+}
+
+/************************************************************************/
+/* Reserves CGRAM slot for the glyph, lq_glyph() does not use it.       */
+/* Changing glyph of a slot on screen changes all cells showing it,     */
+/* only changed rows are uploaded.                                      */
+/************************************************************************/
+void lq_glyph_define(BYTE slot, const BYTE* bitmap)
+{
+	slot &= 7;
+	lq_current->glyph_reserved |= (1<<slot);
+	lq_current->glyph_used &= ~(1<<slot);
+	memcpy(lq_current->cgram[slot], bitmap, 8);
+}
+
+/************************************************************************/
+/* Returns reserved slot to lq_glyph()                                  */
+/************************************************************************/
+void lq_glyph_release(BYTE slot)
+{
+	lq_current->glyph_reserved &= ~(1<<(slot & 7));
+}
+
+/************************************************************************/
+/* Sends changed cells of the shadow buffer to the LCD                  */
+/************************************************************************/
+void lq_flush()
+{
+	lq_bus_stream_begin();
+	lq_flush_with(lq_stream_write_and_wait);
+	lq_bus_stream_end();
+}
+
+/************************************************************************/
+/* Sends changed cells of the shadow buffer with given write function.  */
+/* Stops and returns 0 if write function returns 0, remaining cells     */
+/* are sent by the next flush. Returns 1 when all cells are sent.       */
+/************************************************************************/
+BYTE lq_flush_with(BYTE (*write)(BYTE value, BYTE mode))
+{
+	lq_display_t* display = lq_current;
+	BYTE row, column, address, slot;
+	BYTE *screen = display->screen;
+	BYTE *sent = display->sent;
+	BYTE *cgram = display->cgram[0];
+	BYTE *cgram_sent = display->cgram_sent[0];
+	
+	/* unknown LCD contents are marked different from every wanted cell,
+	 * so a flush interrupted by the write function continues from where
+	 * it stopped */
+	if(!display->sent_valid)
+	{
+		for(address=0;address<sizeof(display->sent);address++)
+			display->sent[address] = ~display->screen[address];
+		display->sent_valid = 1;
+	}
+	
+	/* glyphs first, so that cells never show a half uploaded glyph. Only 
+	 * slots in use are uploaded. CGRAM address counter increments like 
+	 * DDRAM, changed rows in a run need one set CGRAM address. 
+	 */
+	for(slot=0;slot<8;slot++)
+	{
+		if(!((display->glyph_used | display->glyph_reserved) & (1<<slot)))
+		{
+			cgram += 8;
+			cgram_sent += 8;
+			continue;
+		}
+		if(display->cgram_unknown & (1<<slot))
+		{
+			for(row=0;row<8;row++)
+				cgram_sent[row] = ~cgram[row];
+			display->cgram_unknown &= ~(1<<slot);
+		}
+		for(row=0,address=slot<<3;row<8;row++,address++,cgram++,cgram_sent++)
+		{
+			if(*cgram == *cgram_sent)
+				continue;
+			
+			if(display->address != (LQ_ADDRESS_CGRAM | address))
+			{
+				if(!write(LCD_INSTRUCTION_SET_CGRAM_ADDRESS | address, LQ_INSTRUCTION))
+					return 0;
+				display->address = LQ_ADDRESS_CGRAM | address;
+			}
+			
+			if(!write(*cgram, LQ_DATA))
+				return 0;
+			*cgram_sent = *cgram;
+			display->address++;
+		}
+	}
+	
+	for(row=0;row<LCD_ROWS;row++)
+	{
+		address = LCD_ROW_ADDRESS(row);
+		for(column=0;column<LCD_COLUMNS;column++,address++,screen++,sent++)
+		{
+			if(*screen == *sent)
+				continue;
+			
+			/* adjacent changed cells are one run with one set DDRAM address */
+			if(display->address != address)
+			{
+				if(!write(LCD_INSTRUCTION_SET_DDRAM_ADDRESS | address, LQ_INSTRUCTION))
+					return 0;
+				display->address = address;
+			}
+			
+			if(!write(*screen, LQ_DATA))
+				return 0;
+			*sent = *screen;
+			display->address++;
+		}
+	}
+	return 1;
 }
 
 /************************************************************************/
@@ -146,23 +426,66 @@ void lq_clear_display()
 void lq_port_configuration()
 {
 	_delay_ms(20);
-	MCU_SET_DATA_OUT;
-	LCD_INIT_PORTS;
-	LCD_SET_INSTRUCTION_MODE;
-	LCD_SET_CLOCK_ENABLED_LOW;
+	lq_bus_configure();
 	_delay_ms(5);
 }
 
+#if LCD_DISPLAYS > 1
+/* displays initialized together by lq_init_all() */
+static lq_display_t** lq_init_list;
+static BYTE lq_init_count;
+#endif
+
 /************************************************************************/
-/* Initializes the LCD                                                  */
-/* See more from datasheet "Initializing by Internal Reset Circuit"     */
+/* Write instruction of lq_init() and wait until it is executed. With   */
+/* several displays it is written to all at once and each is waited,    */
+/* so the 1.52 ms of clear and home is spent once.                      */
 /************************************************************************/
-void lq_init()
+static void lq_init_instruction(BYTE instruction)
+{
+#if LCD_DISPLAYS > 1
+	BYTE i, all = lq_e_mask;
+	
+	lq_write_raw(instruction, LQ_INSTRUCTION);
+	
+	/* busy flag can be read only from one display at a time */
+	for(i=0;i<lq_init_count;i++)
+	{
+		lq_e_mask = lq_init_list[i]->e_mask;
+		lq_wait_executed(instruction, LQ_INSTRUCTION);
+	}
+	lq_e_mask = all;
+#else
+	lq_write_instruction(instruction);
+#endif
+}
+
+/************************************************************************/
+/* Shadow state of selected display after lq_init_sequence()            */
+/************************************************************************/
+static void lq_init_state()
+{
+	/* clear wrote spaces to all DDRAM */
+	memset(lq_current->sent, ' ', sizeof(lq_current->sent));
+	lq_current->sent_valid = 1;
+	lq_buffer_clear();
+	
+	/* CGRAM has random contents after power on */
+	lq_current->cgram_unknown = 0xFF;
+	lq_current->address = LQ_ADDRESS_UNKNOWN;
+}
+
+/************************************************************************/
+/* Reset sequence and settings                                          */
+/* See more from datasheet "Initializing by Instruction", Figure 23    */
+/* and 24                                                               */
+/************************************************************************/
+static void lq_init_sequence()
 {
 	/* 1. Display clear
 	   2. Function set:
-	      DL = 1; 8-bit interface data
-	      N = 0; 1-line display
+	      DL = 1; 8-bit interface data (DL = 0 with 4-bit and I2C transports)
+	      N = 0; 1-line display (N = 1; 2-line display when LCD_ROWS > 1)
 	      F = 0; 5  8 dot character font
 	   3. Display on/off control:
 	      D = 0; Display off
@@ -173,33 +496,84 @@ void lq_init()
 	      S = 0; No shift
 	*/
 	_delay_ms(200);
+	
+	/* Function set 8-bit three times, busy flag can not be checked yet.
+	 * LCD may be in 4-bit mode waiting for the lower nibble, so only the
+	 * upper nibble is written. After this LCD is in 8-bit mode. 
+	 */
 	for(int repeat=0;repeat<3;repeat++)
 	{
-		lq_write_instruction(LCD_INSTRUCTION_RETURN_HOME);
+		lq_bus_write_nibble((LCD_INSTRUCTION_FUNCTION_SET | 
+							 LCD_INSTRUCTION_FS_DATA_LENGTH_8BIT) >> 4);
 		_delay_ms(10);
 	}
 	
-	_delay_ms(40);
-	lq_write_instruction(LCD_INSTRUCTION_CLEAR_DISPLAY);
+#if LCD_TRANSPORT != LCD_TRANSPORT_8BIT
+	/* Function set 4-bit, still as 8-bit instruction. From now on 
+	 * all instructions are written as two nibbles. */
+	lq_bus_write_nibble(LCD_INSTRUCTION_FUNCTION_SET >> 4);
+	_delay_ms(1);
+#endif
 	
-	lq_write_instruction(LCD_INSTRUCTION_FUNCTION_SET | 
-						 LCD_INSTRUCTION_FS_DATA_LENGTH_8BIT | 
-		                 LCD_INSTRUCTION_FS_ONE_LINE |
-						 LCD_INSTRUCTION_FS_FONT_5X10_DOTS);
+	lq_init_instruction(LCD_INSTRUCTION_FUNCTION_SET | 
+						LCD_FUNCTION_SET_DATA_LENGTH | 
+						LCD_FUNCTION_SET_LINES);
 						 
-	lq_write_instruction(LCD_INSTRUCTION_DISPLAY_CONTROL |
-						 LCD_INSTRUCTION_DIS_DISPLAY_ON |
-						 LCD_INSTRUCTION_DIS_CURSOR_ON |
-						 LCD_INSTRUCTION_DIS_CURSOR_NO_BLINK);
-	
-	lq_write_instruction(LCD_INSTRUCTION_ENTRY_MODE |
-					     LCD_INSTRUCTION_ENTRY_INCR |
-						 LCD_INSTRUCTION_ENTRY_SHIFT_CURSOR);
+	lq_init_instruction(LCD_INSTRUCTION_DISPLAY_CONTROL |
+						LCD_INSTRUCTION_DIS_DISPLAY_ON |
+						LCD_INSTRUCTION_DIS_CURSOR_ON |
+						LCD_INSTRUCTION_DIS_CURSOR_NO_BLINK);
+	
+	/* display must not shift with writes, shadow buffer cells are mapped
+	 * to fixed DDRAM addresses */
+	lq_init_instruction(LCD_INSTRUCTION_ENTRY_MODE |
+					    LCD_INSTRUCTION_ENTRY_INCR |
+						LCD_INSTRUCTION_ENTRY_NOSHIFT_CURSOR);
 						 
-	lq_write_instruction(LCD_INSTRUCTION_CLEAR_DISPLAY);
+	lq_init_instruction(LCD_INSTRUCTION_CLEAR_DISPLAY);
+	lq_init_instruction(LCD_INSTRUCTION_RETURN_HOME);
+}
+
+
+/************************************************************************/
+/* Initializes the LCD (the selected one with LCD_DISPLAYS > 1)         */
+/************************************************************************/
+void lq_init()
+{
+#if LCD_DISPLAYS > 1
+	lq_init_list = &lq_current;
+	lq_init_count = 1;
+#endif
+	lq_init_sequence();
+	lq_init_state();
+}
+
+#if LCD_DISPLAYS > 1
+/************************************************************************/
+/* Initializes count displays at the same time. E of all displays is    */
+/* raised together, so the 230 ms reset sequence is done once. Selected */
+/* display does not change.                                             */
+/************************************************************************/
+void lq_init_all(lq_display_t** displays, BYTE count)
+{
+	lq_display_t* selected = lq_current;
+	BYTE i;
+	
+	lq_init_list = displays;
+	lq_init_count = count;
+	lq_e_mask = 0;
+	for(i=0;i<count;i++)
+		lq_e_mask |= displays[i]->e_mask;
+	lq_init_sequence();
 	
-	lq_write_instruction(LCD_INSTRUCTION_RETURN_HOME);
+	for(i=0;i<count;i++)
+	{
+		lq_select(displays[i]);
+		lq_init_state();
+	}
+	lq_select(selected);
 }
+#endif
 
 
 /************************************************************************/
@@ -207,15 +581,78 @@ void lq_init()
 /************************************************************************/
 BYTE lq_read_instruction()
 {
-	LCD_SET_INSTRUCTION_MODE;
-	MCU_SET_DATA_IN;
-	LCD_SET_READ_MODE;
-	LCD_SET_CLOCK_ENABLED_HIGH;
-	_delay_us(15);
-	char ret = MCU_DATA_PORT;
-	LCD_SET_CLOCK_ENABLED_LOW;
-	_delay_us(15);
-	return ret;
+	return lq_bus_read(LQ_INSTRUCTION);
 }
 
 
+
+#if LCD_DISPLAYS > 1
+/************************************************************************/
+/* Initializes state of display with E in MCU_COMMAND_PORT bit e_pin.   */
+/* LCD itself is initialized by lq_init() or lq_init_all().             */
+/************************************************************************/
+void lq_display_init(lq_display_t* display, BYTE e_pin)
+{
+	BYTE slot;
+	
+	memset(display, 0, sizeof(*display));
+	for(slot=0;slot<8;slot++)
+		display->glyph_lru[slot] = slot;
+	display->cgram_unknown = 0xFF;
+	display->address = LQ_ADDRESS_UNKNOWN;
+	display->e_mask = (1<<e_pin);
+	
+	MCU_COMMAND_PORT &= ~display->e_mask;
+	MCU_COMMAND_DDR |= display->e_mask;
+}
+
+/************************************************************************/
+/* All following lq_* calls use this display                            */
+/************************************************************************/
+void lq_select(lq_display_t* display)
+{
+	lq_current = display;
+	lq_e_mask = display->e_mask;
+}
+
+/* set by lq_flush_all() before each turn of a display */
+static BYTE lq_turn_written;
+
+/************************************************************************/
+/* Write for lq_flush_all(): one write per turn and only when LCD is    */
+/* not busy, otherwise returns 0 and the flush continues next turn.     */
+/************************************************************************/
+static BYTE lq_write_turn(BYTE value, BYTE mode)
+{
+	if(lq_turn_written || (lq_read_instruction() & LCD_INSTRUCTION_BUSY_FLAG))
+		return 0;
+	lq_write_raw(value, mode);
+	lq_turn_written = 1;
+	return 1;
+}
+
+/************************************************************************/
+/* Flushes count displays interleaved. Each display gets one write per  */
+/* turn, so while one executes a write the bus serves the others and    */
+/* total time follows bus time instead of the sum of execution times.   */
+/* Selected display does not change.                                    */
+/************************************************************************/
+void lq_flush_all(lq_display_t** displays, BYTE count)
+{
+	lq_display_t* selected = lq_current;
+	BYTE i, pending;
+	
+	do
+	{
+		pending = 0;
+		for(i=0;i<count;i++)
+		{
+			lq_select(displays[i]);
+			lq_turn_written = 0;
+			if(!lq_flush_with(lq_write_turn))
+				pending = 1;
+		}
+	} while(pending);
+	lq_select(selected);
+}
+#endif
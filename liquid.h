@@ -19,7 +19,7 @@
  * ----------------------------------------------------------------------------
  *
  * Title:	Liquid, LCD driver for HD44780 interface. (liquid.h, hd44780lq.h
- *                                                               and liquid.c)
+ *                                 liquid_bus.h, liquid.c and liquid_format.c)
  * Created:	7.3.2013 23:35
  * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
  *
@@ -45,8 +45,24 @@
 	// set ATmega command and data ports and directions, defaults below
 	#define MCU_COMMAND_DDR DDRC
 	#define MCU_COMMAND_PORT PORTC
-	#define MCU_DATA_DDR DDRB
+	#define MCU_DATA_DDR DDRD
 	#define MCU_DATA_PORT PORTD
+	#define MCU_DATA_PIN PIND
+	
+	// display geometry, defaults below
+	#define LCD_COLUMNS 16
+	#define LCD_ROWS 2
+	
+	// controller variant for bus timing, HD44780 by default. 
+	// 1 is KS0066 and 2 ST7066, see hd44780lq.h. F_CPU must be set.
+	#define LCD_CONTROLLER 1
+	
+	// transport, 8-bit parallel by default. 1 is 4-bit parallel and
+	// 2 PCF8574 I2C backpack, see hd44780lq.h
+	#define LCD_TRANSPORT 0
+	
+	// several displays with own E pins on parallel bus, see lq_select()
+	#define LCD_DISPLAYS 2
 	
 	int main()
 	{
@@ -57,11 +73,38 @@
 		_delay_ms(2000);
 		lq_write_16bit_number(2^16-1);
 		
+		// status screen redrawn through the shadow buffer, only changed
+		// characters are sent to LCD and no clear is needed between frames
+		lq_buffer_clear();
+		lq_buffer_write_string("Counter:");
+		
+		// custom glyph, uploaded to CGRAM once by lq_flush()
+		static const BYTE a_ring[8] = LQ_GLYPH_A_RING;
+		lq_buffer_write_char(lq_glyph(a_ring));
+		long counter = 0;
 		while(1)
 		{
+			lq_buffer_goto(1, 0);
+			lq_buffer_write_16bit_number(counter++);
+			lq_flush();
 		}			
 		
-	}		
+	}
+	
+	// with LCD_DISPLAYS 2, displays with E in bits 3 and 4
+	lq_display_t left, right;
+	lq_display_t* panels[] = { &left, &right };
+	
+	lq_port_configuration();
+	lq_display_init(&left, 3);
+	lq_display_init(&right, 4);
+	lq_init_all(panels, 2);
+	
+	lq_select(&left);
+	lq_buffer_write_string("Left");
+	lq_select(&right);
+	lq_buffer_write_string("Right");
+	lq_flush_all(panels, 2);
  */
 
 
@@ -74,6 +117,35 @@
 
 typedef unsigned char BYTE;
 
+/* State of one display: shadow buffer, CGRAM shadow and glyph cache. 
+ * Fields are private to liquid.c. With LCD_DISPLAYS > 1 declare one per
+ * display and initialize with lq_display_init(). All displays have the 
+ * geometry of LCD_COLUMNS and LCD_ROWS.
+ */
+typedef struct
+{
+	BYTE screen[LCD_ROWS * LCD_COLUMNS];	/* what application wants to see */
+	BYTE sent[LCD_ROWS * LCD_COLUMNS];		/* what has been written to LCD */
+	BYTE cursor;				/* next cell of lq_buffer_write_char() */
+	BYTE sent_valid;			/* zero when LCD contents are unknown */
+	BYTE cgram[8][8];			/* CGRAM shadow, eight 5x8 glyphs */
+	BYTE cgram_sent[8][8];
+	BYTE glyph_used;			/* bit per slot holding a cached glyph */
+	BYTE glyph_reserved;		/* bit per slot of lq_glyph_define() */
+	BYTE glyph_lru[8];			/* slots, most recently used first */
+	BYTE glyph_refs[8];			/* cells of screen showing the slot */
+	BYTE cgram_unknown;			/* bit per slot with unknown CGRAM */
+	BYTE address;				/* LCD address counter if known */
+#if LCD_DISPLAYS > 1
+	BYTE e_mask;				/* E pin in MCU_COMMAND_PORT */
+#endif
+} lq_display_t;
+
+/* register selection for lq_write_raw() and lq_write_async() */
+#define LQ_INSTRUCTION 0
+#define LQ_DATA 1
+
+void lq_write_raw(BYTE value, BYTE mode);
 void lq_write_instruction(BYTE instruction);
 void lq_write_data(BYTE data);
 void lq_write_string(BYTE* data);
@@ -83,5 +155,86 @@ void lq_clear_display();
 void lq_port_configuration();
 void lq_init();
 BYTE lq_read_instruction();
+void lq_set_ddram_address(BYTE address);
+
+/* shadow buffer, see lq_flush() */
+void lq_buffer_clear();
+void lq_buffer_goto(BYTE row, BYTE column);
+void lq_buffer_write_char(BYTE data);
+void lq_buffer_write_string(BYTE* data);
+void lq_buffer_write_16bit_number(long number);
+void lq_invalidate();
+void lq_flush();
+BYTE lq_flush_with(BYTE (*write)(BYTE value, BYTE mode));
+
+#if LCD_DISPLAYS > 1
+/* several displays on one bus. All lq_* functions use the selected 
+ * display. Select only when lq_idle(), asynchronous writes and scrolling
+ * text go to whichever display is selected. */
+extern BYTE lq_e_mask;
+void lq_display_init(lq_display_t* display, BYTE e_pin);
+void lq_select(lq_display_t* display);
+void lq_init_all(lq_display_t** displays, BYTE count);
+void lq_flush_all(lq_display_t** displays, BYTE count);
+#endif
+
+/* CGRAM glyphs, see lq_glyph(). Bitmaps are eight rows of five bits. */
+#define LQ_GLYPH_NONE 0xFF
+
+/* Finnish and Swedish letters missing from the character ROM. ROM has 
+ * lower case a and o with diaeresis at 0xE1 and 0xEF, degree sign at 0xDF.
+ * usage: static const BYTE a_ring[8] = LQ_GLYPH_A_RING;
+ */
+#define LQ_GLYPH_A_RING			{ 0x04, 0x0A, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00 }
+#define LQ_GLYPH_CAPITAL_A_RING	{ 0x04, 0x0A, 0x04, 0x0E, 0x11, 0x1F, 0x11, 0x00 }
+#define LQ_GLYPH_CAPITAL_A_DIAERESIS { 0x0A, 0x00, 0x0E, 0x11, 0x1F, 0x11, 0x11, 0x00 }
+#define LQ_GLYPH_CAPITAL_O_DIAERESIS { 0x0A, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E, 0x00 }
+
+BYTE lq_glyph(const BYTE* bitmap);
+void lq_glyph_define(BYTE slot, const BYTE* bitmap);
+void lq_glyph_release(BYTE slot);
+
+/* bar graph and sparkline, see liquid_widget.c. Five pixel columns per cell */
+#define LQ_BAR_STEPS 5
+
+uint16_t lq_bar_scale(uint16_t value, BYTE bits, BYTE width);
+void lq_bar(BYTE row, BYTE column, BYTE width, uint16_t level);
+void lq_sparkline(BYTE row, BYTE column, BYTE first_slot, BYTE cells,
+				  const BYTE* samples, BYTE newest);
+
+/* number formatting without division, see liquid_format.c */
+BYTE lq_format_u8(BYTE* buffer, uint8_t value, BYTE width, char pad);
+BYTE lq_format_u16(BYTE* buffer, uint16_t value, BYTE width, char pad);
+BYTE lq_format_s16(BYTE* buffer, int16_t value, BYTE width, char pad);
+BYTE lq_format_u32(BYTE* buffer, uint32_t value, BYTE width, char pad);
+BYTE lq_format_s32(BYTE* buffer, int32_t value, BYTE width, char pad);
+BYTE lq_format_fixed(BYTE* buffer, int32_t value, BYTE decimals, BYTE width, char pad);
+BYTE lq_format_hex(BYTE* buffer, uint16_t value, BYTE digits);
+void lq_buffer_write_u16(uint16_t value, BYTE width);
+void lq_buffer_write_s16(int16_t value, BYTE width);
+void lq_buffer_write_fixed(int32_t value, BYTE decimals, BYTE width);
+
+/* asynchronous writes drained by timer interrupt, see liquid_async.c */
+void lq_async_init();
+BYTE lq_write_async(BYTE value, BYTE mode);
+BYTE lq_write_async_nowait(BYTE value, BYTE mode);
+BYTE lq_write_string_async(BYTE* data);
+BYTE lq_flush_async();
+BYTE lq_idle();
+
+/* scrolling text with display shift, see liquid_scroll.c */
+void lq_scroll_text(BYTE row, BYTE* text);
+void lq_scroll_start(BYTE period);
+void lq_scroll_stop();
+void lq_scroll_tick();
+BYTE lq_scroll_step_with(BYTE (*write)(BYTE value, BYTE mode));
+BYTE lq_scroll_update_with(BYTE (*write)(BYTE value, BYTE mode));
+void lq_scroll_update();
+
+/* fixed rate refresh of the shadow buffer by timer, see liquid_refresh.c */
+void lq_refresh_start();
+void lq_refresh_stop();
+void lq_refresh_lock();
+void lq_refresh_unlock();
 
 #endif /* LIQUID_H_ */
\ No newline at end of file
@@ -0,0 +1,241 @@
+/*
+ * liquid_async.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of controlling a 16x2 
+ * Alphanumeric LCD using ATmega 8 bit Microcontrollers. 
+ * Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Liquid, asynchronous LCD writes (liquid_async.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * lq_write_instruction() and lq_write_data() wait with lq_waitbusy() until
+ * LCD has executed the write, so the main loop stops for the whole string.
+ * Here writes are put to a ring buffer and Timer0 compare match interrupt
+ * writes one byte per tick to the LCD. Tick is longer than execution time 
+ * of a normal write, so busy flag is not read at all. After clear display 
+ * and return home the interrupt skips ticks until 1.52 ms has passed.
+ *
+ * Timer0 is used in CTC mode with prescaler 8 and interrupt is enabled only
+ * when queue has something to write. Add this file to project to use it, 
+ * it reserves TIMER0_COMPA_vect.
+ *
+ * Do not mix blocking lq_write_* functions with asynchronous writes before
+ * lq_idle() returns 1, both would drive the same data bus.
+ *
+ * Only 8-bit and 4-bit transports work here. With LCD_TRANSPORT_I2C one 
+ * byte is a whole blocking TWI transfer, which does not belong to an 
+ * interrupt and would collide with transfers of tinyi2c_async.c.
+ *
+ * usage:
+ *
+	lq_port_configuration();
+	lq_init();
+	lq_async_init();
+	sei();
+	
+	while(1)
+	{
+		lq_buffer_goto(0, 0);
+		lq_buffer_write_16bit_number(adc_value);
+		
+		// returns immediately, changed cells go out in background
+		lq_flush_async();
+		
+		// ADC, I2C etc. work here
+	}
+ */
+
+#include "liquid.h"
+#include <avr/interrupt.h>
+
+/* Tick in microseconds, one queued byte is written per tick. Must be longer
+ * than LCD_EXECUTION_TIME_US.
+ */
+#ifndef LQ_ASYNC_TICK_US
+#define LQ_ASYNC_TICK_US 50
+#endif
+
+/* Queue size in bytes, must be power of two. 32 is enough for a changed 
+ * 16 character row and its set DDRAM address. 
+ */
+#ifndef LQ_ASYNC_QUEUE_SIZE
+#define LQ_ASYNC_QUEUE_SIZE 32
+#endif
+
+/* What lq_write_async() does when queue is full:
+ * LQ_ASYNC_QUEUE_FULL_WAIT waits until interrupt has made room. Interrupts
+ *                          must be enabled, otherwise the wait never ends.
+ * LQ_ASYNC_QUEUE_FULL_DROP returns 0 and the byte is not written.
+ */
+#define LQ_ASYNC_QUEUE_FULL_WAIT 0
+#define LQ_ASYNC_QUEUE_FULL_DROP 1
+
+#ifndef LQ_ASYNC_QUEUE_FULL
+#define LQ_ASYNC_QUEUE_FULL LQ_ASYNC_QUEUE_FULL_WAIT
+#endif
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_I2C
+# error "liquid_async.c can not be used with LCD_TRANSPORT_I2C"
+#endif
+
+#if LQ_ASYNC_TICK_US <= LCD_EXECUTION_TIME_US
+# error "LQ_ASYNC_TICK_US must be longer than LCD execution time"
+#endif
+
+#if (LQ_ASYNC_QUEUE_SIZE & (LQ_ASYNC_QUEUE_SIZE - 1)) != 0 || LQ_ASYNC_QUEUE_SIZE > 128
+# error "LQ_ASYNC_QUEUE_SIZE must be power of two and at most 128"
+#endif
+
+/* Timer0 compare value for one tick with prescaler 8 */
+#define LQ_ASYNC_OCR0A ((F_CPU / 8UL) * LQ_ASYNC_TICK_US / 1000000UL - 1)
+
+#if LQ_ASYNC_OCR0A > 255 || LQ_ASYNC_OCR0A < 1
+# error "LQ_ASYNC_TICK_US does not fit to Timer0 with prescaler 8 at this F_CPU"
+#endif
+
+/* ticks to skip after clear display and return home */
+#define LQ_ASYNC_LONG_TICKS ((LCD_EXECUTION_TIME_LONG_US + LQ_ASYNC_TICK_US - 1) / LQ_ASYNC_TICK_US)
+
+#define LQ_ASYNC_MASK (LQ_ASYNC_QUEUE_SIZE - 1)
+
+/* Ring buffer, interrupt reads from tail and lq_write_async() adds to head.
+ * Both indexes are bytes so they are read and written atomically.
+ */
+static BYTE lq_queue_value[LQ_ASYNC_QUEUE_SIZE];
+static BYTE lq_queue_mode[LQ_ASYNC_QUEUE_SIZE];
+static volatile BYTE lq_queue_head;
+static volatile BYTE lq_queue_tail;
+
+/* ticks left before LCD is ready for next byte */
+static volatile BYTE lq_hold_ticks;
+
+/************************************************************************/
+/* Initializes Timer0 for asynchronous writes                           */
+/************************************************************************/
+void lq_async_init()
+{
+	lq_queue_head = 0;
+	lq_queue_tail = 0;
+	lq_hold_ticks = 0;
+	
+	/* CTC mode, counter is cleared on compare match with OCR0A */
+	TCCR0A = (1<<WGM01);
+	OCR0A = LQ_ASYNC_OCR0A;
+	
+	/* prescaler 8 */
+	TCCR0B = (1<<CS01);
+}
+
+/************************************************************************/
+/* Put byte to queue. mode is LQ_INSTRUCTION or LQ_DATA.                */
+/* Returns 0 if queue was full, whatever LQ_ASYNC_QUEUE_FULL is, so     */
+/* this can be used in interrupts.                                      */
+/************************************************************************/
+BYTE lq_write_async_nowait(BYTE value, BYTE mode)
+{
+	BYTE head = lq_queue_head;
+	BYTE next = (head + 1) & LQ_ASYNC_MASK;
+	
+	if(next == lq_queue_tail)
+		return 0;
+	
+	lq_queue_value[head] = value;
+	lq_queue_mode[head] = mode;
+	lq_queue_head = next;
+	
+	/* start draining, interrupt disables itself when queue is empty */
+	TIMSK0 |= (1<<OCIE0A);
+	return 1;
+}
+
+/************************************************************************/
+/* Put byte to queue. mode is LQ_INSTRUCTION or LQ_DATA.                */
+/* Returns 0 if queue was full and LQ_ASYNC_QUEUE_FULL_DROP is in use.  */
+/************************************************************************/
+BYTE lq_write_async(BYTE value, BYTE mode)
+{
+	while(!lq_write_async_nowait(value, mode))
+	{
+#if LQ_ASYNC_QUEUE_FULL == LQ_ASYNC_QUEUE_FULL_DROP
+		return 0;
+#endif
+	}
+	return 1;
+}
+
+/************************************************************************/
+/* Put string to queue. Returns 0 if all did not fit.                   */
+/************************************************************************/
+BYTE lq_write_string_async(BYTE* data)
+{
+	while(*data != '\0')
+	{
+		if(!lq_write_async(*data++, LQ_DATA))
+			return 0;
+	}
+	return 1;
+}
+
+/************************************************************************/
+/* Put changed cells of the shadow buffer to queue. Returns 0 if all    */
+/* did not fit, rest of them are sent by the next flush.                */
+/************************************************************************/
+BYTE lq_flush_async()
+{
+	return lq_flush_with(lq_write_async);
+}
+
+/************************************************************************/
+/* Returns 1 when queue is empty and LCD has executed the last write    */
+/************************************************************************/
+BYTE lq_idle()
+{
+	/* interrupt disables itself one tick after the last write, when
+	 * also the execution time of that write has passed */
+	return !(TIMSK0 & (1<<OCIE0A));
+}
+
+/************************************************************************/
+/* Timer0 compare match, writes one byte per tick                       */
+/************************************************************************/
+ISR(TIMER0_COMPA_vect)
+{
+	BYTE tail, value;
+	
+	/* previous write is still executing in LCD */
+	if(lq_hold_ticks)
+	{
+		lq_hold_ticks--;
+		return;
+	}
+	
+	tail = lq_queue_tail;
+	if(tail == lq_queue_head)
+	{
+		/* nothing to do, stop ticking until next lq_write_async() */
+		TIMSK0 &= ~(1<<OCIE0A);
+		return;
+	}
+	
+	value = lq_queue_value[tail];
+	lq_write_raw(value, lq_queue_mode[tail]);
+	lq_queue_tail = (tail + 1) & LQ_ASYNC_MASK;
+	
+	/* clear display and return home are the only instructions with
+	 * bit 2..7 zero, they take 1.52 ms instead of 37 us */
+	if(lq_queue_mode[tail] == LQ_INSTRUCTION && value < LCD_INSTRUCTION_ENTRY_MODE)
+		lq_hold_ticks = LQ_ASYNC_LONG_TICKS - 1;
+}
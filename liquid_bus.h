@@ -0,0 +1,357 @@
+/*
+ * liquid_bus.h
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of controlling a 16x2
+ * Alphanumeric LCD using ATmega 8 bit Microcontrollers.
+ * Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Liquid, LCD bus transports (liquid_bus.h)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * Lowest level of liquid. Every transport implements the same functions:
+ *
+ * lq_bus_configure()          set MCU ports (or I2C) for the LCD
+ * lq_bus_write(value, mode)   write byte to instruction or data register
+ * lq_bus_write_nibble(nibble) write upper four bits of an instruction only,
+ *                             used by the reset sequence in lq_init()
+ * lq_bus_read(mode)           read busy flag and address or data register
+ * lq_bus_stream_begin()       start a run of writes, lq_bus_stream_write()
+ * lq_bus_stream_write(value, mode)
+ * lq_bus_stream_end()         and end it. I2C transport sends the run in one
+ *                             transaction, parallel transports write as usual
+ *
+ * LCD_BUS_BLIND is 1 when writes of the transport are slower than LCD
+ * execution time, so busy flag does not need to be read.
+ *
+ * Transport is selected with LCD_TRANSPORT (see hd44780lq.h) at compile time
+ * and functions are static inline, so there is no runtime dispatch. This
+ * header is included only by liquid.c.
+ *
+ * 4-bit transfers are done upper nibble first, see HD44780 datasheet
+ * Figure 9, 4-Bit Transfer Example.
+ */
+
+
+#ifndef LIQUID_BUS_H_
+#define LIQUID_BUS_H_
+
+#include "liquid.h"
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_8BIT
+
+/************************************************************************/
+/* 8-bit parallel                                                       */
+/************************************************************************/
+
+static inline void lq_bus_configure()
+{
+	MCU_SET_DATA_OUT;
+	LCD_INIT_PORTS;
+	LCD_SET_INSTRUCTION_MODE;
+	LCD_SET_CLOCK_ENABLED_LOW;
+}
+
+static inline void lq_bus_write(BYTE value, BYTE mode)
+{
+	if(mode == LQ_DATA)
+		LCD_SET_DATA_MODE;
+	else
+		LCD_SET_INSTRUCTION_MODE;
+	MCU_SET_DATA_OUT;
+	LCD_SET_WRITE_MODE;
+	MCU_DATA_PORT = value;
+
+	/* RS and R/W must be stable before E rises */
+	LCD_DELAY_NS(LCD_T_AS_NS);
+
+	/* we must enable LCD every time before command write */
+	LCD_SET_CLOCK_ENABLED_HIGH;
+
+	/* data is on the bus already, so data set-up time is covered
+	 * by the enable pulse width */
+	LCD_DELAY_NS(LCD_T_PW_NS);
+
+	/* LCD latches data on the falling edge */
+	LCD_SET_CLOCK_ENABLED_LOW;
+
+	/* keep E low rest of the enable cycle, this covers also data hold time */
+	LCD_DELAY_NS(LCD_T_CYC_NS - LCD_T_PW_NS);
+}
+
+static inline void lq_bus_write_nibble(BYTE nibble)
+{
+	lq_bus_write(nibble << 4, LQ_INSTRUCTION);
+}
+
+static inline BYTE lq_bus_read(BYTE mode)
+{
+	BYTE value;
+
+	if(mode == LQ_DATA)
+		LCD_SET_DATA_MODE;
+	else
+		LCD_SET_INSTRUCTION_MODE;
+	MCU_SET_DATA_IN;
+	LCD_SET_READ_MODE;
+	LCD_DELAY_NS(LCD_T_AS_NS);
+	LCD_SET_CLOCK_ENABLED_HIGH;
+
+	/* wait until LCD drives the data, plus one cycle for the input
+	 * synchronizer of the port */
+	LCD_DELAY_NS(LCD_T_DDR_NS);
+	__builtin_avr_delay_cycles(1);
+
+	/* input is read from PIN register, PORT holds only the pull-ups */
+	value = MCU_DATA_PIN;
+
+	LCD_DELAY_NS(LCD_T_PW_NS - LCD_T_DDR_NS);
+	LCD_SET_CLOCK_ENABLED_LOW;
+	LCD_DELAY_NS(LCD_T_CYC_NS - LCD_T_PW_NS);
+	return value;
+}
+
+#elif LCD_TRANSPORT == LCD_TRANSPORT_4BIT
+
+/************************************************************************/
+/* 4-bit parallel                                                       */
+/************************************************************************/
+
+static inline void lq_bus_configure()
+{
+	MCU_SET_DATA_OUT;
+	LCD_INIT_PORTS;
+	LCD_SET_INSTRUCTION_MODE;
+	LCD_SET_CLOCK_ENABLED_LOW;
+}
+
+/* put lower four bits of nibble to DB4..DB7 and strobe E */
+static inline void lq_bus_put_nibble(BYTE nibble)
+{
+	MCU_DATA_PORT = (MCU_DATA_PORT & ~LCD_DATA_MASK) | ((nibble & 0x0F) << LCD_DATA_SHIFT);
+	LCD_DELAY_NS(LCD_T_AS_NS);
+	LCD_SET_CLOCK_ENABLED_HIGH;
+	LCD_DELAY_NS(LCD_T_PW_NS);
+	LCD_SET_CLOCK_ENABLED_LOW;
+	LCD_DELAY_NS(LCD_T_CYC_NS - LCD_T_PW_NS);
+}
+
+/* strobe E and read DB4..DB7 to lower four bits */
+static inline BYTE lq_bus_get_nibble()
+{
+	BYTE nibble;
+
+	LCD_DELAY_NS(LCD_T_AS_NS);
+	LCD_SET_CLOCK_ENABLED_HIGH;
+	LCD_DELAY_NS(LCD_T_DDR_NS);
+	__builtin_avr_delay_cycles(1);
+	nibble = (MCU_DATA_PIN & LCD_DATA_MASK) >> LCD_DATA_SHIFT;
+	LCD_DELAY_NS(LCD_T_PW_NS - LCD_T_DDR_NS);
+	LCD_SET_CLOCK_ENABLED_LOW;
+	LCD_DELAY_NS(LCD_T_CYC_NS - LCD_T_PW_NS);
+	return nibble;
+}
+
+static inline void lq_bus_write(BYTE value, BYTE mode)
+{
+	if(mode == LQ_DATA)
+		LCD_SET_DATA_MODE;
+	else
+		LCD_SET_INSTRUCTION_MODE;
+	MCU_SET_DATA_OUT;
+	LCD_SET_WRITE_MODE;
+	lq_bus_put_nibble(value >> 4);
+	lq_bus_put_nibble(value);
+}
+
+static inline void lq_bus_write_nibble(BYTE nibble)
+{
+	LCD_SET_INSTRUCTION_MODE;
+	MCU_SET_DATA_OUT;
+	LCD_SET_WRITE_MODE;
+	lq_bus_put_nibble(nibble);
+}
+
+static inline BYTE lq_bus_read(BYTE mode)
+{
+	BYTE value;
+
+	if(mode == LQ_DATA)
+		LCD_SET_DATA_MODE;
+	else
+		LCD_SET_INSTRUCTION_MODE;
+	MCU_SET_DATA_IN;
+	LCD_SET_READ_MODE;
+	value = lq_bus_get_nibble() << 4;
+	value |= lq_bus_get_nibble();
+	return value;
+}
+
+#endif
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_8BIT || LCD_TRANSPORT == LCD_TRANSPORT_4BIT
+
+/************************************************************************/
+/* Parallel bus has no framing, stream is only writes                   */
+/************************************************************************/
+
+#define LCD_BUS_BLIND 0
+
+static inline void lq_bus_stream_begin()
+{
+}
+
+static inline void lq_bus_stream_write(BYTE value, BYTE mode)
+{
+	lq_bus_write(value, mode);
+}
+
+static inline void lq_bus_stream_end()
+{
+}
+
+#elif LCD_TRANSPORT == LCD_TRANSPORT_I2C
+
+/************************************************************************/
+/* PCF8574 I2C backpack                                                 */
+/*                                                                      */
+/* One I2C byte takes at least 22 us even at 400 kHz, which is far more */
+/* than any bus timing of LCD, so no delays are needed between outputs. */
+/************************************************************************/
+
+#include "tinyi2c.h"
+
+#if LCD_I2C_BLIND && TINYI2C_SCL_HZ > LCD_I2C_SCL_HZ
+# warning "tinyi2c_init() would set the LCD bus faster than LCD_I2C_SCL_HZ"
+#endif
+
+/* control outputs for a register, backlight is kept on */
+#define LCD_I2C_CONTROL(mode) ((((mode) == LQ_DATA) ? (1<<LCD_I2C_RS) : 0) | (1<<LCD_I2C_BACKLIGHT))
+
+/* output nibble in upper four bits with E high and then low,
+ * LCD latches it on the falling edge */
+static inline void lq_bus_put_nibble(BYTE output)
+{
+	tinyi2c__write(output | (1<<LCD_I2C_E));
+	tinyi2c__write(output);
+}
+
+static inline void lq_bus_configure()
+{
+	/* not faster than LCD_I2C_SCL_HZ which blind timing is checked for */
+	tinyi2c_init_hz(LCD_I2C_SCL_HZ);
+	tinyi2c_start(LCD_I2C_ADDRESS | I2CWRITE);
+	tinyi2c__write(LCD_I2C_CONTROL(LQ_INSTRUCTION));
+	tinyi2c_stop();
+}
+
+static inline void lq_bus_write(BYTE value, BYTE mode)
+{
+	BYTE control = LCD_I2C_CONTROL(mode);
+
+	tinyi2c_start(LCD_I2C_ADDRESS | I2CWRITE);
+	lq_bus_put_nibble((value & 0xF0) | control);
+	lq_bus_put_nibble((value << 4) | control);
+	tinyi2c_stop();
+}
+
+static inline void lq_bus_write_nibble(BYTE nibble)
+{
+	tinyi2c_start(LCD_I2C_ADDRESS | I2CWRITE);
+	lq_bus_put_nibble((nibble << 4) | LCD_I2C_CONTROL(LQ_INSTRUCTION));
+	tinyi2c_stop();
+}
+
+/* PCF8574 outputs are quasi-bidirectional, data bits are written high
+ * so that LCD can pull them down. Nibble is read while E is high. */
+static inline BYTE lq_bus_get_nibble(BYTE control)
+{
+	BYTE nibble;
+
+	tinyi2c_start(LCD_I2C_ADDRESS | I2CWRITE);
+	tinyi2c__write(0xF0 | control | (1<<LCD_I2C_E));
+	tinyi2c_stop();
+
+	tinyi2c_start(LCD_I2C_ADDRESS | I2CREAD);
+	nibble = tinyi2c_readbyte_not_ack() & 0xF0;
+	tinyi2c_stop();
+
+	tinyi2c_start(LCD_I2C_ADDRESS | I2CWRITE);
+	tinyi2c__write(0xF0 | control);
+	tinyi2c_stop();
+	return nibble;
+}
+
+#if LCD_I2C_BLIND
+
+#define LCD_BUS_BLIND 1
+
+/* START and address once, then four expander bytes per LCD byte. 
+ * Strings and flushes go out as one I2C transaction, at 100 kHz one 
+ * character takes 360 us of which only the acknowledge bits are overhead.
+ */
+static inline void lq_bus_stream_begin()
+{
+	tinyi2c_start(LCD_I2C_ADDRESS | I2CWRITE);
+}
+
+static inline void lq_bus_stream_write(BYTE value, BYTE mode)
+{
+	BYTE control = LCD_I2C_CONTROL(mode);
+
+	lq_bus_put_nibble((value & 0xF0) | control);
+	lq_bus_put_nibble((value << 4) | control);
+}
+
+static inline void lq_bus_stream_end()
+{
+	tinyi2c_stop();
+}
+
+#else
+
+#define LCD_BUS_BLIND 0
+
+/* busy flag is read between writes, every byte needs its own transaction */
+static inline void lq_bus_stream_begin()
+{
+}
+
+static inline void lq_bus_stream_write(BYTE value, BYTE mode)
+{
+	lq_bus_write(value, mode);
+}
+
+static inline void lq_bus_stream_end()
+{
+}
+
+#endif /* LCD_I2C_BLIND */
+
+static inline BYTE lq_bus_read(BYTE mode)
+{
+	BYTE control = LCD_I2C_CONTROL(mode) | (1<<LCD_I2C_RW);
+	BYTE value;
+
+	value = lq_bus_get_nibble(control);
+	value |= lq_bus_get_nibble(control) >> 4;
+	return value;
+}
+
+#else
+# error "unknown LCD_TRANSPORT for \"liquid_bus.h\""
+#endif /* LCD_TRANSPORT */
+
+#endif /* LIQUID_BUS_H_ */
@@ -0,0 +1,286 @@
+/*
+ * liquid_format.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of controlling a 16x2
+ * Alphanumeric LCD using ATmega 8 bit Microcontrollers.
+ * Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Liquid, number formatting (liquid_format.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * AVR has no divide instruction. itoa() and ultoa() divide by 10 once per
+ * digit with __udivmodhi4 or __udivmodsi4, which loop over every bit of
+ * the value. Here each digit is found by subtracting its power of ten
+ * until the value gets smaller, which is at most 9 rounds of compare and
+ * subtract per digit and usually fewer. format_example.c measures cycles
+ * of both with Timer1 on the target.
+ *
+ * Formatters write right aligned to at least width characters, padded with
+ * pad (' ' or '0'). Width 0 means no padding. Result is terminated with '\0'
+ * and length without terminator is returned. Longest results without 
+ * padding, buffer needs one more for the terminator:
+ *
+ *	lq_format_u8		3	255
+ *	lq_format_u16		5	65535
+ *	lq_format_s16		6	-32768
+ *	lq_format_u32		10	4294967295
+ *	lq_format_s32		11	-2147483648
+ *	lq_format_fixed		13	-0.2147483648 (10 decimals)
+ *	lq_format_hex		digits
+ *
+ * Longer width gives width characters. host/formattest.c checks results
+ * against printf on PC.
+ *
+ * usage:
+ *
+	BYTE text[14];
+
+	lq_format_u16(text, adc, 4, ' ');           // " 512"
+	lq_format_fixed(text, -1234, 2, 7, ' ');    // " -12.34"
+	lq_format_hex(text, 0xBEEF, 4);             // "BEEF"
+
+	// directly to shadow buffer, no buffer of your own needed
+	lq_buffer_write_u16(adc, 4);
+	lq_buffer_write_fixed(temperature_centi, 2, 6);
+ */
+
+#include "liquid.h"
+
+/* powers of ten for the digits above ones */
+static const uint16_t lq_pow10_16[] = { 10000, 1000, 100, 10 };
+static const uint32_t lq_pow10_32[] = { 1000000000UL, 100000000UL, 10000000UL,
+										1000000UL, 100000UL, 10000UL, 1000UL,
+										100UL, 10UL };
+
+/************************************************************************/
+/* Digits of 16 bit value without leading zeros, at least min_digits.   */
+/* Returns number of digits.                                            */
+/************************************************************************/
+static BYTE lq_digits_u16(BYTE* digits, uint16_t value, BYTE min_digits)
+{
+	BYTE i, digit, count = 0;
+
+	for(i=0;i<sizeof(lq_pow10_16)/sizeof(lq_pow10_16[0]);i++)
+	{
+		uint16_t power = lq_pow10_16[i];
+		digit = '0';
+		while(value >= power)
+		{
+			value -= power;
+			digit++;
+		}
+		/* 4 - i digits are left after this one */
+		if(count || digit != '0' || min_digits > 4 - i)
+			digits[count++] = digit;
+	}
+	digits[count++] = '0' + value;
+	return count;
+}
+
+/************************************************************************/
+/* Digits of 32 bit value, 16 bit subtraction is used when it fits.     */
+/************************************************************************/
+static BYTE lq_digits_u32(BYTE* digits, uint32_t value, BYTE min_digits)
+{
+	BYTE i, digit, count = 0;
+
+	if(value <= 0xFFFF && min_digits <= 5)
+		return lq_digits_u16(digits, (uint16_t)value, min_digits);
+
+	/* digits from 10^9 to 10^4, after that the rest is below 10000 */
+	for(i=0;i<6;i++)
+	{
+		uint32_t power = lq_pow10_32[i];
+		digit = '0';
+		while(value >= power)
+		{
+			value -= power;
+			digit++;
+		}
+		/* 9 - i digits are left after this one */
+		if(count || digit != '0' || min_digits > 9 - i)
+			digits[count++] = digit;
+	}
+
+	/* once a digit is written all four following digits are needed */
+	return count + lq_digits_u16(digits + count, (uint16_t)value, count ? 4 : min_digits);
+}
+
+/************************************************************************/
+/* Copy sign and digits right aligned to width                          */
+/************************************************************************/
+static BYTE lq_format_pad(BYTE* buffer, BYTE* digits, BYTE count, BYTE negative,
+						  BYTE width, char pad)
+{
+	BYTE length = count + negative;
+	BYTE* out = buffer;
+
+	if(negative && pad == '0')
+		*out++ = '-';
+	while(length < width)
+	{
+		*out++ = pad;
+		length++;
+	}
+	if(negative && pad != '0')
+		*out++ = '-';
+	while(count--)
+		*out++ = *digits++;
+	*out = '\0';
+	return length;
+}
+
+/************************************************************************/
+/* Unsigned 8 bit                                                       */
+/************************************************************************/
+BYTE lq_format_u8(BYTE* buffer, uint8_t value, BYTE width, char pad)
+{
+	return lq_format_u16(buffer, value, width, pad);
+}
+
+/************************************************************************/
+/* Unsigned 16 bit                                                      */
+/************************************************************************/
+BYTE lq_format_u16(BYTE* buffer, uint16_t value, BYTE width, char pad)
+{
+	BYTE digits[5];
+	BYTE count = lq_digits_u16(digits, value, 1);
+	return lq_format_pad(buffer, digits, count, 0, width, pad);
+}
+
+/************************************************************************/
+/* Signed 16 bit                                                        */
+/************************************************************************/
+BYTE lq_format_s16(BYTE* buffer, int16_t value, BYTE width, char pad)
+{
+	BYTE digits[5];
+	BYTE negative = value < 0;
+
+	/* -32768 has no positive counterpart, but as unsigned it is right */
+	uint16_t magnitude = negative ? -(uint16_t)value : (uint16_t)value;
+	BYTE count = lq_digits_u16(digits, magnitude, 1);
+	return lq_format_pad(buffer, digits, count, negative, width, pad);
+}
+
+/************************************************************************/
+/* Unsigned 32 bit                                                      */
+/************************************************************************/
+BYTE lq_format_u32(BYTE* buffer, uint32_t value, BYTE width, char pad)
+{
+	BYTE digits[10];
+	BYTE count = lq_digits_u32(digits, value, 1);
+	return lq_format_pad(buffer, digits, count, 0, width, pad);
+}
+
+/************************************************************************/
+/* Signed 32 bit                                                        */
+/************************************************************************/
+BYTE lq_format_s32(BYTE* buffer, int32_t value, BYTE width, char pad)
+{
+	BYTE digits[10];
+	BYTE negative = value < 0;
+	uint32_t magnitude = negative ? -(uint32_t)value : (uint32_t)value;
+	BYTE count = lq_digits_u32(digits, magnitude, 1);
+	return lq_format_pad(buffer, digits, count, negative, width, pad);
+}
+
+/************************************************************************/
+/* Fixed point, value has decimals digits after the decimal point.      */
+/* For example value 1234 with 2 decimals is "12.34" and 5 is "0.05".   */
+/* decimals is at most 10.                                              */
+/************************************************************************/
+BYTE lq_format_fixed(BYTE* buffer, int32_t value, BYTE decimals, BYTE width, char pad)
+{
+	BYTE digits[12];
+	BYTE negative = value < 0;
+	uint32_t magnitude = negative ? -(uint32_t)value : (uint32_t)value;
+	BYTE count, i;
+
+	if(decimals == 0)
+		return lq_format_s32(buffer, value, width, pad);
+
+	/* at least one digit before the point, with 10 decimals it is always
+	 * 0 and all ten digits of the value are decimals */
+	if(decimals > 9)
+	{
+		digits[0] = '0';
+		count = 1 + lq_digits_u32(digits + 1, magnitude, 10);
+	}
+	else
+		count = lq_digits_u32(digits, magnitude, decimals + 1);
+
+	/* move decimals right and put the point in between */
+	for(i=count;i>count-decimals;i--)
+		digits[i] = digits[i-1];
+	digits[count-decimals] = '.';
+	return lq_format_pad(buffer, digits, count + 1, negative, width, pad);
+}
+
+/************************************************************************/
+/* Hexadecimal, exactly digits (1..4) upper case digits                 */
+/************************************************************************/
+BYTE lq_format_hex(BYTE* buffer, uint16_t value, BYTE digits)
+{
+	BYTE i, nibble;
+
+	for(i=digits;i>0;i--)
+	{
+		nibble = value & 0x0F;
+		buffer[i-1] = nibble < 10 ? '0' + nibble : 'A' - 10 + nibble;
+		value >>= 4;
+	}
+	buffer[digits] = '\0';
+	return digits;
+}
+
+/************************************************************************/
+/* Write unsigned 16 bit number right aligned to shadow buffer          */
+/************************************************************************/
+void lq_buffer_write_u16(uint16_t value, BYTE width)
+{
+	BYTE text[LCD_COLUMNS + 1 > 6 ? LCD_COLUMNS + 1 : 6];
+
+	if(width > LCD_COLUMNS)
+		width = LCD_COLUMNS;
+	lq_format_u16(text, value, width, ' ');
+	lq_buffer_write_string(text);
+}
+
+/************************************************************************/
+/* Write signed 16 bit number right aligned to shadow buffer            */
+/************************************************************************/
+void lq_buffer_write_s16(int16_t value, BYTE width)
+{
+	BYTE text[LCD_COLUMNS + 1 > 7 ? LCD_COLUMNS + 1 : 7];
+
+	if(width > LCD_COLUMNS)
+		width = LCD_COLUMNS;
+	lq_format_s16(text, value, width, ' ');
+	lq_buffer_write_string(text);
+}
+
+/************************************************************************/
+/* Write fixed point number right aligned to shadow buffer              */
+/************************************************************************/
+void lq_buffer_write_fixed(int32_t value, BYTE decimals, BYTE width)
+{
+	BYTE text[LCD_COLUMNS + 1 > 14 ? LCD_COLUMNS + 1 : 14];
+
+	if(width > LCD_COLUMNS)
+		width = LCD_COLUMNS;
+	lq_format_fixed(text, value, decimals, width, ' ');
+	lq_buffer_write_string(text);
+}
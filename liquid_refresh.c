@@ -0,0 +1,160 @@
+/*
+ * liquid_refresh.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of controlling a 16x2 
+ * Alphanumeric LCD using ATmega 8 bit Microcontrollers. 
+ * Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Liquid, fixed rate refresh (liquid_refresh.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * Application writes only to the shadow buffer (lq_buffer_* functions), as
+ * often as it wants. Timer1 compare match interrupt flushes the buffer at
+ * LQ_REFRESH_HZ. Shadow buffer is the back buffer and what has been sent
+ * is the front buffer. Between two ticks a cell can change any number of
+ * times, only the value seen by the tick is written. Bus load is at most 
+ * one full screen per tick however often values change.
+ *
+ * Interrupt puts changed cells to the queue of liquid_async.c with 
+ * lq_write_async_nowait(), Timer0 interrupt writes them to LCD. When the
+ * queue is full the rest is sent by the next tick. Full 16x2 screen needs
+ * 34 bytes, set LQ_ASYNC_QUEUE_SIZE to 64 if whole screen changes at once.
+ *
+ * Main loop never waits for LCD. Interrupt can not run in the middle of
+ * main loop code, so it sees the buffer only between two instructions of
+ * main loop. Updates of several cells which must appear together go 
+ * between lq_refresh_lock() and lq_refresh_unlock(), ticks are skipped 
+ * while locked. lq_glyph() and lq_glyph_define() must also be locked.
+ *
+ * While refresh runs do not call lq_flush*() or lq_write_*(), interrupt is
+ * the only writer of LCD. One display only (LCD_DISPLAYS 1). Add this 
+ * file and liquid_async.c to project, together they reserve 
+ * TIMER0_COMPA_vect and TIMER1_COMPA_vect (TIMER3_COMPA_vect with 
+ * LQ_REFRESH_TIMER 3).
+ *
+ * usage:
+ *
+	lq_port_configuration();
+	lq_init();
+	lq_refresh_start();
+	sei();
+	
+	while(1)
+	{
+		// any rate, at most 20 frames per second go to LCD
+		lq_refresh_lock();
+		lq_buffer_goto(1, 0);
+		lq_buffer_write_u16(adc_value, 4);
+		lq_refresh_unlock();
+	}
+ */
+
+#include "liquid.h"
+#include <avr/interrupt.h>
+
+/* Frames per second */
+#ifndef LQ_REFRESH_HZ
+#define LQ_REFRESH_HZ 20
+#endif
+
+/* Timer of the tick, 1 or 3 (ATmega32U4 only). Timer1 is used also by
+ * some ADC auto trigger sources, Timer3 leaves it free. */
+#ifndef LQ_REFRESH_TIMER
+#define LQ_REFRESH_TIMER 1
+#endif
+
+#if LCD_DISPLAYS > 1
+# error "liquid_refresh.c supports one display"
+#endif
+
+/* CTC mode with prescaler 64, compare value for one tick */
+#define LQ_REFRESH_OCR ((F_CPU / 64UL) / LQ_REFRESH_HZ - 1)
+
+#if LQ_REFRESH_OCR > 65535 || LQ_REFRESH_OCR < 1
+# error "LQ_REFRESH_HZ does not fit to 16 bit timer with prescaler 64 at this F_CPU"
+#endif
+
+#if LQ_REFRESH_TIMER == 3
+#define LQ_REFRESH_TCCRA TCCR3A
+#define LQ_REFRESH_TCCRB TCCR3B
+#define LQ_REFRESH_TCNT TCNT3
+#define LQ_REFRESH_OCRA OCR3A
+#define LQ_REFRESH_TIMSK TIMSK3
+#define LQ_REFRESH_OCIEA OCIE3A
+#define LQ_REFRESH_TCCRB_CTC_64 ((1<<WGM32) | (1<<CS31) | (1<<CS30))
+#define LQ_REFRESH_vect TIMER3_COMPA_vect
+#else
+#define LQ_REFRESH_TCCRA TCCR1A
+#define LQ_REFRESH_TCCRB TCCR1B
+#define LQ_REFRESH_TCNT TCNT1
+#define LQ_REFRESH_OCRA OCR1A
+#define LQ_REFRESH_TIMSK TIMSK1
+#define LQ_REFRESH_OCIEA OCIE1A
+#define LQ_REFRESH_TCCRB_CTC_64 ((1<<WGM12) | (1<<CS11) | (1<<CS10))
+#define LQ_REFRESH_vect TIMER1_COMPA_vect
+#endif
+
+/* nonzero while application updates the buffer */
+static volatile BYTE lq_refresh_locked;
+
+/************************************************************************/
+/* Starts refresh. Initializes asynchronous writes, interrupts must be  */
+/* enabled with sei().                                                  */
+/************************************************************************/
+void lq_refresh_start()
+{
+	lq_async_init();
+	lq_refresh_locked = 0;
+	
+	LQ_REFRESH_TCCRA = 0;
+	LQ_REFRESH_TCNT = 0;
+	LQ_REFRESH_OCRA = LQ_REFRESH_OCR;
+	LQ_REFRESH_TCCRB = LQ_REFRESH_TCCRB_CTC_64;
+	LQ_REFRESH_TIMSK |= (1<<LQ_REFRESH_OCIEA);
+}
+
+/************************************************************************/
+/* Stops refresh. Queued writes are still written, wait for lq_idle()   */
+/* before writing LCD directly.                                         */
+/************************************************************************/
+void lq_refresh_stop()
+{
+	LQ_REFRESH_TIMSK &= ~(1<<LQ_REFRESH_OCIEA);
+	LQ_REFRESH_TCCRB = 0;
+}
+
+/************************************************************************/
+/* Buffer is not sent until lq_refresh_unlock(), locks can be nested    */
+/************************************************************************/
+void lq_refresh_lock()
+{
+	lq_refresh_locked++;
+}
+
+void lq_refresh_unlock()
+{
+	lq_refresh_locked--;
+}
+
+/************************************************************************/
+/* Refresh tick: queue changed cells                                    */
+/************************************************************************/
+ISR(LQ_REFRESH_vect)
+{
+	if(lq_refresh_locked)
+		return;
+	lq_flush_with(lq_write_async_nowait);
+}
@@ -0,0 +1,268 @@
+/*
+ * liquid_scroll.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of controlling a 16x2 
+ * Alphanumeric LCD using ATmega 8 bit Microcontrollers. 
+ * Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Liquid, scrolling text with display shift (liquid_scroll.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * DDRAM has 40 characters per line in 2-line mode (80 in 1-line mode) and
+ * LCD shows 16 of them. Display shift instruction moves the visible window
+ * one character along the line, so a text loaded once to DDRAM scrolls with
+ * one instruction per step instead of rewriting 16 characters. Line is a
+ * ring, after character 39 comes 0.
+ *
+ * Text shorter than the line is padded with spaces to its length and the
+ * ring scrolls it forever without any other writes. Longer text (up to 255)
+ * is paged in: after the shift the next character is written to the DDRAM
+ * cell which just went out of the window on the left. That cell is hidden
+ * until the ring comes around again, so a step costs the shift, set DDRAM
+ * address and one data write.
+ *
+ * Display shift moves all lines together, also lines without scroll text.
+ * Shadow buffer of liquid.c does not know about the shift, so do not use
+ * lq_flush() between lq_scroll_text() and lq_scroll_stop(). 4-line displays
+ * continue lines 0 and 1 on rows 2 and 3, they show the same rings.
+ *
+ * Step rate comes from a timer: call lq_scroll_tick() from a periodic
+ * interrupt. It only counts, steps are written by lq_scroll_update() in 
+ * the main loop, so the interrupt never touches the LCD bus.
+ *
+ * usage:
+ *
+	lq_scroll_text(0, "Liquid scrolls long messages with display shift +++ ");
+	lq_scroll_text(1, "Row 1 ring");
+	
+	// 10 ms timer tick, step every 300 ms
+	lq_scroll_start(30);
+	
+	while(1)
+	{
+		lq_scroll_update();			// or lq_scroll_update_with(lq_write_async)
+		// other work
+	}
+	
+	ISR(TIMER1_COMPA_vect)
+	{
+		lq_scroll_tick();
+	}
+ */
+
+#include "liquid.h"
+#include <string.h>
+
+/* DDRAM characters per line, 1-line mode has one line of 80 */
+#if LCD_ROWS > 1
+#define LQ_SCROLL_LINE 40
+#define LQ_SCROLL_LINES 2
+#else
+#define LQ_SCROLL_LINE 80
+#define LQ_SCROLL_LINES 1
+#endif
+
+/* text of each line, NULL when line does not scroll */
+static BYTE* lq_scroll_texts[LQ_SCROLL_LINES];
+static BYTE lq_scroll_lengths[LQ_SCROLL_LINES];
+
+/* text index shown in leftmost column of the window */
+static BYTE lq_scroll_positions[LQ_SCROLL_LINES];
+
+/* display shift, DDRAM column shown in leftmost column of LCD */
+static BYTE lq_scroll_shift;
+
+/* lines whose outgoing cell is not written yet after the last shift */
+static BYTE lq_scroll_pending;
+
+/* steps are counted by lq_scroll_tick() to lq_scroll_ticked and by 
+ * lq_scroll_update() to lq_scroll_done. Each has one writer, so the
+ * difference is the number of pending steps without disabling interrupts.
+ */
+static BYTE lq_scroll_period;
+static BYTE lq_scroll_ticks;
+static volatile BYTE lq_scroll_ticked;
+static BYTE lq_scroll_done;
+
+/************************************************************************/
+/* Character at text index, short text is padded to line with spaces   */
+/************************************************************************/
+static BYTE lq_scroll_char(BYTE line, uint16_t index)
+{
+	BYTE length = lq_scroll_lengths[line];
+
+	if(length < LQ_SCROLL_LINE)
+	{
+		index %= LQ_SCROLL_LINE;
+		return index < length ? lq_scroll_texts[line][index] : ' ';
+	}
+	return lq_scroll_texts[line][index % length];
+}
+
+/* blocking write for the lq_*_with functions */
+static BYTE lq_scroll_write(BYTE value, BYTE mode)
+{
+	if(mode == LQ_DATA)
+		lq_write_data(value);
+	else
+		lq_write_instruction(value);
+	return 1;
+}
+
+/************************************************************************/
+/* Load text to line 0 or 1 (only 0 on 1-line LCD) and scroll it from  */
+/* the beginning.                                                       */
+/* Text must stay in memory while it scrolls. NULL stops the line,      */
+/* its DDRAM keeps the old characters.                                  */
+/************************************************************************/
+void lq_scroll_text(BYTE row, BYTE* text)
+{
+	BYTE line = row & (LQ_SCROLL_LINES - 1);
+	BYTE column, address;
+	size_t length;
+
+	lq_scroll_texts[line] = text;
+	lq_scroll_pending &= ~(1 << line);
+	if(text == NULL)
+		return;
+	length = strlen((char*)text);
+	lq_scroll_lengths[line] = length > 255 ? 255 : length;
+	lq_scroll_positions[line] = 0;
+
+	/* window may already be shifted by the other line, so text starts from
+	 * the current shift. Address counter does not wrap inside the line,
+	 * so the ring is written in two runs. */
+	address = lq_scroll_shift;
+	lq_set_ddram_address(LCD_ROW_ADDRESS(line) + address);
+	for(column=0;column<LQ_SCROLL_LINE;column++)
+	{
+		if(address == LQ_SCROLL_LINE)
+		{
+			address = 0;
+			lq_set_ddram_address(LCD_ROW_ADDRESS(line));
+		}
+		lq_write_data(lq_scroll_char(line, column));
+		address++;
+	}
+}
+
+/************************************************************************/
+/* Scroll one step with lq_scroll_tick() every period ticks. 0 stops.   */
+/************************************************************************/
+void lq_scroll_start(BYTE period)
+{
+	lq_scroll_period = period;
+}
+
+/************************************************************************/
+/* Stop scrolling and return display to unshifted state. Shadow buffer  */
+/* is invalidated, so next lq_flush() redraws the screen.               */
+/************************************************************************/
+void lq_scroll_stop()
+{
+	BYTE line;
+
+	lq_scroll_period = 0;
+	for(line=0;line<LQ_SCROLL_LINES;line++)
+		lq_scroll_texts[line] = NULL;
+	lq_scroll_pending = 0;
+	lq_scroll_shift = 0;
+	lq_scroll_done = lq_scroll_ticked;
+	lq_write_instruction(LCD_INSTRUCTION_RETURN_HOME);
+	lq_invalidate();
+}
+
+/************************************************************************/
+/* Timer tick, call from periodic interrupt                             */
+/************************************************************************/
+void lq_scroll_tick()
+{
+	if(lq_scroll_period == 0)
+		return;
+	if(++lq_scroll_ticks >= lq_scroll_period)
+	{
+		lq_scroll_ticks = 0;
+		lq_scroll_ticked++;
+	}
+}
+
+/************************************************************************/
+/* One step to the left with write function. Returns 0 if write failed, */
+/* the same step can then be done again.                                */
+/************************************************************************/
+BYTE lq_scroll_step_with(BYTE (*write)(BYTE value, BYTE mode))
+{
+	BYTE line;
+
+	/* shift is done once, a step that failed in the writes below is
+	 * finished without shifting again */
+	if(lq_scroll_pending == 0)
+	{
+		if(!write(LCD_INSTRUCTION_CURSOR_DISPLAY_SHIFT | LCD_INSTRUCTION_CDS_DISPLAY_SHIFT | LCD_INSTRUCTION_CDS_LEFT, LQ_INSTRUCTION))
+			return 0;
+
+		lq_scroll_shift = lq_scroll_shift == LQ_SCROLL_LINE - 1 ? 0 : lq_scroll_shift + 1;
+		for(line=0;line<LQ_SCROLL_LINES;line++)
+		{
+			BYTE length = lq_scroll_lengths[line];
+			BYTE period = length < LQ_SCROLL_LINE ? LQ_SCROLL_LINE : length;
+
+			lq_scroll_positions[line] = lq_scroll_positions[line] + 1 == period ? 0 : lq_scroll_positions[line] + 1;
+			if(lq_scroll_texts[line] != NULL && length > LQ_SCROLL_LINE)
+				lq_scroll_pending |= 1 << line;
+		}
+	}
+
+	/* long text: the cell left of the new window start went out of view,
+	 * it is the last one of the ring and gets the character LQ_SCROLL_LINE
+	 * - 1 after the window start. Short text is already there. */
+	for(line=0;line<LQ_SCROLL_LINES;line++)
+	{
+		BYTE address = lq_scroll_shift == 0 ? LQ_SCROLL_LINE - 1 : lq_scroll_shift - 1;
+
+		if(!(lq_scroll_pending & (1 << line)))
+			continue;
+		if(!write(LCD_INSTRUCTION_SET_DDRAM_ADDRESS | (LCD_ROW_ADDRESS(line) + address), LQ_INSTRUCTION))
+			return 0;
+		if(!write(lq_scroll_char(line, lq_scroll_positions[line] + LQ_SCROLL_LINE - 1), LQ_DATA))
+			return 0;
+		lq_scroll_pending &= ~(1 << line);
+	}
+	return 1;
+}
+
+/************************************************************************/
+/* Write pending steps with write function. Returns 0 if write failed,  */
+/* rest of the steps are written by the next update.                    */
+/************************************************************************/
+BYTE lq_scroll_update_with(BYTE (*write)(BYTE value, BYTE mode))
+{
+	while(lq_scroll_done != lq_scroll_ticked)
+	{
+		if(!lq_scroll_step_with(write))
+			return 0;
+		lq_scroll_done++;
+	}
+	return 1;
+}
+
+/************************************************************************/
+/* Write pending steps, waits each write to execute                     */
+/************************************************************************/
+void lq_scroll_update()
+{
+	lq_scroll_update_with(lq_scroll_write);
+}
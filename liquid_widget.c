@@ -0,0 +1,135 @@
+/*
+ * liquid_widget.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of controlling a 16x2 
+ * Alphanumeric LCD using ATmega 8 bit Microcontrollers. 
+ * Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Liquid, bar graph and sparkline widgets (liquid_widget.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * Widgets draw to the shadow buffer and CGRAM shadow, lq_flush() (or 
+ * lq_flush_async() or refresh of liquid_refresh.c) sends only what changed.
+ *
+ * Bar graph: character cell is five pixel columns wide, so a bar of width
+ * cells has width * 5 + 1 levels (0..80 on 16 columns). Full cells are the
+ * ROM block 0xFF, the partly filled cell is one of four glyphs with 1..4 
+ * columns lit from lq_glyph(). Moving the bar by one level changes at most
+ * two cells and the four glyphs stay in CGRAM cache when there is room, so
+ * a step costs two or three LCD writes.
+ *
+ * Sparkline: cells glyphs of reserved CGRAM slots (lq_glyph_define()), each
+ * shows five samples as dots of height 0..7. Slots first_slot .. 
+ * first_slot + cells - 1 are reserved, leave at least four slots for bar
+ * graphs. Only changed glyph rows are uploaded.
+ *
+ * usage:
+ *
+	// ADC 10-bit value to 80 levels and to a 4 cell sparkline of 20 samples
+	BYTE samples[20];
+	BYTE newest = 0;
+	
+	lq_bar(0, 0, 16, lq_bar_scale(adc, 10, 16));
+	
+	newest = newest == 19 ? 0 : newest + 1;
+	samples[newest] = adc >> 7;
+	lq_sparkline(1, 12, 4, 4, samples, newest);
+	lq_flush();
+ */
+
+#include "liquid.h"
+#include <string.h>
+
+/* ROM character with all pixels lit */
+#define LQ_WIDGET_FULL 0xFF
+
+/************************************************************************/
+/* Scales value of bits bits to bar level of width cells by shifting,   */
+/* no division. Rounds up, so the largest value is a full bar and only  */
+/* 0 is empty. For example 10 bit ADC value to 16 cells is              */
+/* (value * 80 + 1023) >> 10. Value must have more levels than the bar. */
+/************************************************************************/
+uint16_t lq_bar_scale(uint16_t value, BYTE bits, BYTE width)
+{
+	return ((uint32_t)value * (width * LQ_BAR_STEPS) + (1UL << bits) - 1) >> bits;
+}
+
+/************************************************************************/
+/* Horizontal bar of width cells starting at row and column, level is   */
+/* 0..width * LQ_BAR_STEPS lit pixel columns from left.                 */
+/************************************************************************/
+void lq_bar(BYTE row, BYTE column, BYTE width, uint16_t level)
+{
+	BYTE cell, partial, glyph;
+	BYTE bitmap[8];
+	
+	lq_buffer_goto(row, column);
+	for(cell=0;cell<width;cell++)
+	{
+		if(level >= LQ_BAR_STEPS)
+		{
+			lq_buffer_write_char(LQ_WIDGET_FULL);
+			level -= LQ_BAR_STEPS;
+			continue;
+		}
+		
+		partial = level;
+		level = 0;
+		if(partial == 0)
+		{
+			lq_buffer_write_char(' ');
+			continue;
+		}
+		
+		/* 1..4 columns lit from the left, bit 4 is the leftmost pixel */
+		memset(bitmap, (0x1F << (LQ_BAR_STEPS - partial)) & 0x1F, sizeof(bitmap));
+		glyph = lq_glyph(bitmap);
+		
+		/* all slots on screen, round to nearest ROM character */
+		if(glyph == LQ_GLYPH_NONE)
+			glyph = partial > LQ_BAR_STEPS / 2 ? LQ_WIDGET_FULL : ' ';
+		lq_buffer_write_char(glyph);
+	}
+}
+
+/************************************************************************/
+/* Sparkline of cells glyphs at row and column using CGRAM slots from   */
+/* first_slot. samples is a ring of cells * 5 values 0..7, newest is    */
+/* the index of the newest sample, which is drawn rightmost.            */
+/************************************************************************/
+void lq_sparkline(BYTE row, BYTE column, BYTE first_slot, BYTE cells,
+				  const BYTE* samples, BYTE newest)
+{
+	BYTE count = cells * LQ_BAR_STEPS;
+	BYTE index = newest + 1 == count ? 0 : newest + 1;
+	BYTE cell, x;
+	BYTE bitmap[8];
+	
+	lq_buffer_goto(row, column);
+	for(cell=0;cell<cells;cell++)
+	{
+		memset(bitmap, 0, sizeof(bitmap));
+		
+		/* oldest sample first, value 7 on the top row */
+		for(x=0;x<LQ_BAR_STEPS;x++)
+		{
+			bitmap[7 - (samples[index] & 7)] |= 0x10 >> x;
+			index = index + 1 == count ? 0 : index + 1;
+		}
+		lq_glyph_define(first_slot + cell, bitmap);
+		lq_buffer_write_char(first_slot + cell);
+	}
+}
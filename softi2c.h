@@ -0,0 +1,414 @@
+/*
+ * softi2c.h
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of I2C Bus driver for
+ * ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Software I2C Master Mode interface (softi2c.h)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * TWI has one bus on fixed pins. Devices with the same fixed address, for
+ * example several TC74 with the same address, need buses of their own.
+ * This header makes an I2C master on any two port pins, the bus functions
+ * are generated for each include. Pins are compile time constants, so 
+ * every SCL and SDA change is one sbi or cbi instruction of the DDR
+ * register and every read one sbic/sbis of the PIN register.
+ *
+ * Lines are open drain like in the TWI: PORT bit is zero, line is driven
+ * low by setting DDR bit to output and released by setting it to input.
+ * External pull-up resistors are needed, the internal ones are too weak 
+ * above 100 kHz and are not used.
+ *
+ * Functions are the same as in tinyi2c and return the same error codes.
+ * Slave may stretch the clock (hold SCL low) at most TINYI2C_TIMEOUT_US
+ * per bit, then BUS_TIMEOUT is returned. Losing arbitration is detected 
+ * when a released SDA reads low. Estimated instruction overhead is taken
+ * off the half period delay, at 16 MHz the fastest clock is about 1 MHz.
+ * Interrupts only make clocks longer, which I2C allows.
+ *
+ * Before including define the bus:
+ *
+ * SOFTI2C_NAME       prefix of the generated functions
+ * SOFTI2C_SCL_PORT   port letter of SCL, e.g. B
+ * SOFTI2C_SCL_BIT    bit of SCL in the port
+ * SOFTI2C_SDA_PORT   port letter of SDA
+ * SOFTI2C_SDA_BIT    bit of SDA in the port
+ * SOFTI2C_HZ         SCL frequency, default 100000
+ *
+ * The definitions are removed at the end of this header, so next bus can
+ * be defined and this header included again. Generated functions are
+ * static, include buses only in the file which uses them.
+ *
+ * usage:
+ *
+ *	// two TC74A3 (address 0x96) on buses of their own
+ *	#define SOFTI2C_NAME		left
+ *	#define SOFTI2C_SCL_PORT	B
+ *	#define SOFTI2C_SCL_BIT		0
+ *	#define SOFTI2C_SDA_PORT	B
+ *	#define SOFTI2C_SDA_BIT		1
+ *	#include "softi2c.h"
+ *
+ *	#define SOFTI2C_NAME		right
+ *	#define SOFTI2C_SCL_PORT	B
+ *	#define SOFTI2C_SCL_BIT		2
+ *	#define SOFTI2C_SDA_PORT	B
+ *	#define SOFTI2C_SDA_BIT		3
+ *	#define SOFTI2C_HZ		400000UL
+ *	#include "softi2c.h"
+ *
+ *	unsigned char t1, t2;
+ *
+ *	left_init();
+ *	right_init();
+ *	left_read_regs(0x96, 0x00, &t1, 1);
+ *	right_read_regs(0x96, 0x00, &t2, 1);
+ */
+
+#include <avr/io.h>
+#include <util/delay.h>
+#include "tinyi2c.h"
+
+#ifndef SOFTI2C_H
+#define SOFTI2C_H
+
+#define SOFTI2C_CAT2(a, b) a ## b
+#define SOFTI2C_CAT(a, b) SOFTI2C_CAT2(a, b)
+
+/* CPU cycles of pin change, pin test and loop in one half clock, 
+ * estimated from generated code. Subtracted from the delay. */
+#define SOFTI2C_OVERHEAD_CYCLES 8
+
+/* rounds of the clock stretching wait, about 6 cycles each */
+#define SOFTI2C_STRETCH_LOOPS ((F_CPU / 1000000UL) * TINYI2C_TIMEOUT_US / 6)
+
+#if SOFTI2C_STRETCH_LOOPS > 65535 || SOFTI2C_STRETCH_LOOPS < 1
+# error "TINYI2C_TIMEOUT_US does not fit to 16 bit loop counter at this F_CPU"
+#endif
+
+#endif /* SOFTI2C_H */
+
+/************************************************************************/
+/* Bus definition                                                       */
+/************************************************************************/
+
+#ifndef SOFTI2C_NAME
+# error "SOFTI2C_NAME not defined for \"softi2c.h\""
+#endif
+
+#if !defined(SOFTI2C_SCL_PORT) || !defined(SOFTI2C_SCL_BIT)
+# error "SOFTI2C_SCL_PORT and SOFTI2C_SCL_BIT not defined for \"softi2c.h\""
+#endif
+
+#if !defined(SOFTI2C_SDA_PORT) || !defined(SOFTI2C_SDA_BIT)
+# error "SOFTI2C_SDA_PORT and SOFTI2C_SDA_BIT not defined for \"softi2c.h\""
+#endif
+
+#ifndef SOFTI2C_HZ
+#define SOFTI2C_HZ 100000UL
+#endif
+
+/* name of generated function, e.g. SOFTI2C_FN(start) is left_start */
+#define SOFTI2C_FN(name) SOFTI2C_CAT(SOFTI2C_NAME, SOFTI2C_CAT(_, name))
+
+#define SOFTI2C_SCL_DDR SOFTI2C_CAT(DDR, SOFTI2C_SCL_PORT)
+#define SOFTI2C_SCL_OUT SOFTI2C_CAT(PORT, SOFTI2C_SCL_PORT)
+#define SOFTI2C_SCL_IN  SOFTI2C_CAT(PIN, SOFTI2C_SCL_PORT)
+#define SOFTI2C_SDA_DDR SOFTI2C_CAT(DDR, SOFTI2C_SDA_PORT)
+#define SOFTI2C_SDA_OUT SOFTI2C_CAT(PORT, SOFTI2C_SDA_PORT)
+#define SOFTI2C_SDA_IN  SOFTI2C_CAT(PIN, SOFTI2C_SDA_PORT)
+
+/* CPU cycles of half SCL period */
+#define SOFTI2C_HALF_CYCLES (F_CPU / (2 * SOFTI2C_HZ))
+
+/* status of the last readbyte function of this bus */
+static unsigned char SOFTI2C_FN(status);
+
+/************************************************************************/
+/* Lines, one instruction each                                          */
+/************************************************************************/
+
+static inline void SOFTI2C_FN(scl_low)()
+{
+	SOFTI2C_SCL_DDR |= (1<<SOFTI2C_SCL_BIT);
+}
+
+static inline void SOFTI2C_FN(sda_low)()
+{
+	SOFTI2C_SDA_DDR |= (1<<SOFTI2C_SDA_BIT);
+}
+
+static inline void SOFTI2C_FN(sda_release)()
+{
+	SOFTI2C_SDA_DDR &= ~(1<<SOFTI2C_SDA_BIT);
+}
+
+static inline unsigned char SOFTI2C_FN(sda_is_high)()
+{
+	return (SOFTI2C_SDA_IN & (1<<SOFTI2C_SDA_BIT)) != 0;
+}
+
+/* half of SCL period */
+static inline void SOFTI2C_FN(delay)()
+{
+#if SOFTI2C_HALF_CYCLES > SOFTI2C_OVERHEAD_CYCLES
+	__builtin_avr_delay_cycles(SOFTI2C_HALF_CYCLES - SOFTI2C_OVERHEAD_CYCLES);
+#endif
+}
+
+/* Release SCL and wait until it is high, slave may hold it low while it 
+ * is not ready (clock stretching). Returns 0 or BUS_TIMEOUT. */
+static inline unsigned char SOFTI2C_FN(scl_release)()
+{
+	uint16_t loops = SOFTI2C_STRETCH_LOOPS;
+	
+	SOFTI2C_SCL_DDR &= ~(1<<SOFTI2C_SCL_BIT);
+	while(!(SOFTI2C_SCL_IN & (1<<SOFTI2C_SCL_BIT)))
+	{
+		if(--loops == 0)
+			return BUS_TIMEOUT;
+	}
+	return 0;
+}
+
+/************************************************************************/
+/* Bits and bytes. SCL is low between bits, SDA changes only then.      */
+/************************************************************************/
+
+/* Write one bit. Returns 0, BUS_TIMEOUT or ARBITRATION_LOST when other 
+ * master keeps SDA low while this one sends 1. */
+static inline unsigned char SOFTI2C_FN(write_bit)(unsigned char bit)
+{
+	if(bit)
+		SOFTI2C_FN(sda_release)();
+	else
+		SOFTI2C_FN(sda_low)();
+	SOFTI2C_FN(delay)();
+	if(SOFTI2C_FN(scl_release)())
+		return BUS_TIMEOUT;
+	if(bit && !SOFTI2C_FN(sda_is_high)())
+		return ARBITRATION_LOST;
+	SOFTI2C_FN(delay)();
+	SOFTI2C_FN(scl_low)();
+	return 0;
+}
+
+/* Read one bit to bit 0 of *bit. Returns 0 or BUS_TIMEOUT. */
+static inline unsigned char SOFTI2C_FN(read_bit)(unsigned char* bit)
+{
+	SOFTI2C_FN(sda_release)();
+	SOFTI2C_FN(delay)();
+	if(SOFTI2C_FN(scl_release)())
+		return BUS_TIMEOUT;
+	*bit = (*bit << 1) | SOFTI2C_FN(sda_is_high)();
+	SOFTI2C_FN(delay)();
+	SOFTI2C_FN(scl_low)();
+	return 0;
+}
+
+/* Write byte and read acknowledge. Returns 0, DATA_NACK or error. */
+static inline unsigned char SOFTI2C_FN(_write)(unsigned char data)
+{
+	unsigned char i, status, nack = 0;
+	
+	for(i=0;i<8;i++)
+	{
+		status = SOFTI2C_FN(write_bit)(data & 0x80);
+		if(status)
+			return status;
+		data <<= 1;
+	}
+	
+	/* slave pulls SDA low for ACK */
+	status = SOFTI2C_FN(read_bit)(&nack);
+	if(status)
+		return status;
+	return (nack & 1) ? DATA_NACK : 0;
+}
+
+/* Read byte and send ACK (ack 1) or NOT ACK (ack 0) */
+static inline unsigned char SOFTI2C_FN(readbyte)(unsigned char ack)
+{
+	unsigned char i, data = 0;
+	
+	SOFTI2C_FN(status) = 0;
+	for(i=0;i<8 && !SOFTI2C_FN(status);i++)
+		SOFTI2C_FN(status) = SOFTI2C_FN(read_bit)(&data);
+	if(!SOFTI2C_FN(status))
+		SOFTI2C_FN(status) = SOFTI2C_FN(write_bit)(!ack);
+	SOFTI2C_FN(sda_release)();
+	return data;
+}
+
+/************************************************************************/
+/* tinyi2c functions                                                    */
+/************************************************************************/
+
+/* Bus Lines released, PORT bits zero so DDR alone drives the lines */
+static inline void SOFTI2C_FN(init)()
+{
+	SOFTI2C_SCL_DDR &= ~(1<<SOFTI2C_SCL_BIT);
+	SOFTI2C_SDA_DDR &= ~(1<<SOFTI2C_SDA_BIT);
+	SOFTI2C_SCL_OUT &= ~(1<<SOFTI2C_SCL_BIT);
+	SOFTI2C_SDA_OUT &= ~(1<<SOFTI2C_SDA_BIT);
+}
+
+/* START, or repeated START if bus is already ours, and address with
+ * data direction. Returns 0 or error code like tinyi2c_start(). */
+static inline unsigned char SOFTI2C_FN(start)(unsigned char sla)
+{
+	unsigned char status;
+	
+	/* both lines high, SCL low here before repeated START */
+	SOFTI2C_FN(sda_release)();
+	SOFTI2C_FN(delay)();
+	if(SOFTI2C_FN(scl_release)())
+		return BUS_TIMEOUT;
+	if(!SOFTI2C_FN(sda_is_high)())
+		return ARBITRATION_LOST;
+	SOFTI2C_FN(delay)();
+	
+	/* START: SDA goes low while SCL is high */
+	SOFTI2C_FN(sda_low)();
+	SOFTI2C_FN(delay)();
+	SOFTI2C_FN(scl_low)();
+	
+	status = SOFTI2C_FN(_write)(sla);
+	return status == DATA_NACK ? DEVICE_NOT_FOUND : status;
+}
+
+static inline unsigned char SOFTI2C_FN(readbyte_ack)()
+{
+	return SOFTI2C_FN(readbyte)(1);
+}
+
+static inline unsigned char SOFTI2C_FN(readbyte_not_ack)()
+{
+	return SOFTI2C_FN(readbyte)(0);
+}
+
+/* STOP: SDA goes high while SCL is high. Returns 0 or BUS_TIMEOUT. */
+static inline unsigned char SOFTI2C_FN(stop)()
+{
+	unsigned char status;
+	
+	SOFTI2C_FN(sda_low)();
+	SOFTI2C_FN(delay)();
+	status = SOFTI2C_FN(scl_release)();
+	SOFTI2C_FN(delay)();
+	SOFTI2C_FN(sda_release)();
+	SOFTI2C_FN(delay)();
+	return status;
+}
+
+/* Clock up to 9 times until slave releases SDA, then STOP. Returns 0 
+ * if bus is free, STATUS_ERROR if a line is still low. */
+static inline unsigned char SOFTI2C_FN(recover)()
+{
+	unsigned char clocks;
+	
+	SOFTI2C_FN(sda_release)();
+	for(clocks=0;clocks<9 && !SOFTI2C_FN(sda_is_high)();clocks++)
+	{
+		SOFTI2C_FN(scl_low)();
+		SOFTI2C_FN(delay)();
+		SOFTI2C_FN(scl_release)();
+		SOFTI2C_FN(delay)();
+	}
+	SOFTI2C_FN(scl_low)();
+	SOFTI2C_FN(delay)();
+	if(SOFTI2C_FN(stop)() || !SOFTI2C_FN(sda_is_high)())
+		return STATUS_ERROR;
+	return 0;
+}
+
+/* Read count bytes, every byte but the last is acknowledged */
+static inline unsigned char SOFTI2C_FN(read)(unsigned char* data, unsigned char count)
+{
+	if(count == 0)
+		return 0;
+	while(--count)
+	{
+		*data++ = SOFTI2C_FN(readbyte)(1);
+		if(SOFTI2C_FN(status))
+			return SOFTI2C_FN(status);
+	}
+	*data = SOFTI2C_FN(readbyte)(0);
+	return SOFTI2C_FN(status);
+}
+
+/* Write, repeated START, read and STOP like tinyi2c_write_read() */
+static inline unsigned char SOFTI2C_FN(write_read)(unsigned char sla, unsigned char* write, unsigned char write_count,
+											unsigned char* read, unsigned char read_count)
+{
+	unsigned char status = 0;
+	
+	if(write_count || !read_count)
+	{
+		status = SOFTI2C_FN(start)(sla & ~I2CREAD);
+		while(!status && write_count--)
+			status = SOFTI2C_FN(_write)(*write++);
+	}
+	if(!status && read_count)
+	{
+		status = SOFTI2C_FN(start)(sla | I2CREAD);
+		if(!status)
+			status = SOFTI2C_FN(read)(read, read_count);
+	}
+	
+	/* other master owns the bus after lost arbitration, no STOP */
+	if(status == ARBITRATION_LOST)
+	{
+		SOFTI2C_FN(init)();
+		return status;
+	}
+	if(SOFTI2C_FN(stop)() && !status)
+		status = BUS_TIMEOUT;
+	if(status == BUS_TIMEOUT)
+		SOFTI2C_FN(recover)();
+	return status;
+}
+
+static inline unsigned char SOFTI2C_FN(write_reg)(unsigned char sla, unsigned char reg, unsigned char value)
+{
+	unsigned char data[2];
+	
+	data[0] = reg;
+	data[1] = value;
+	return SOFTI2C_FN(write_read)(sla, data, 2, 0, 0);
+}
+
+static inline unsigned char SOFTI2C_FN(read_regs)(unsigned char sla, unsigned char reg, unsigned char* data,
+												  unsigned char count)
+{
+	return SOFTI2C_FN(write_read)(sla, &reg, 1, data, count);
+}
+
+/* bus definition is removed so the next bus can be defined */
+#undef SOFTI2C_NAME
+#undef SOFTI2C_SCL_PORT
+#undef SOFTI2C_SCL_BIT
+#undef SOFTI2C_SDA_PORT
+#undef SOFTI2C_SDA_BIT
+#undef SOFTI2C_HZ
+#undef SOFTI2C_FN
+#undef SOFTI2C_SCL_DDR
+#undef SOFTI2C_SCL_OUT
+#undef SOFTI2C_SCL_IN
+#undef SOFTI2C_SDA_DDR
+#undef SOFTI2C_SDA_OUT
+#undef SOFTI2C_SDA_IN
+#undef SOFTI2C_HALF_CYCLES
@@ -0,0 +1,160 @@
+/*
+ * tc74.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of TC74 temperature sensor
+ * driver for ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	TC74 temperature sensor driver (tc74.h and tc74.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * See tc74.h for usage.
+ */
+
+#include "tc74.h"
+
+/************************************************************************/
+/* Sets up sensor with 8 bit address sla, e.g. TC74_ADDRESS(3).         */
+/* Sensor is assumed to be powered up, not in standby.                  */
+/************************************************************************/
+void tc74_init(tc74_t* sensor, unsigned char sla)
+{
+	tinyi2c_device_init(&sensor->device, sla, TC74_SCL_HZ);
+	sensor->temperature = 0;
+	sensor->read_at = 0;
+	sensor->checked_at = 0;
+	sensor->valid = 0;
+	sensor->state = TC74_STATE_CHECK;
+}
+
+/************************************************************************/
+/* Reads temperature in degrees Celsius. Within TC74_CONVERSION_MS of   */
+/* the previous reading the cached value is returned without bus        */
+/* access. Sensor in standby is woken up. Returns 0 for a new reading,  */
+/* TC74_CACHED for the cached one, TC74_NOT_READY when no conversion is */
+/* done since power up or standby (temperature is the old cached value  */
+/* if any) or error code of tinyi2c.                                    */
+/************************************************************************/
+unsigned char tc74_read(tc74_t* sensor, uint16_t now_ms, int8_t* temperature)
+{
+	unsigned char status, value;
+	
+	if(sensor->valid)
+		*temperature = sensor->temperature;
+	
+	/* RTR can not have changed yet. Unsigned difference works also when
+	 * the time counter wraps around. */
+	if(sensor->state == TC74_STATE_READY && sensor->valid &&
+	   (uint16_t)(now_ms - sensor->read_at) < TC74_CONVERSION_MS)
+		return TC74_CACHED;
+	
+	if(sensor->state == TC74_STATE_STANDBY)
+	{
+		status = tc74_wake(sensor, now_ms);
+		return status ? status : TC74_NOT_READY;
+	}
+	
+	/* first conversion can not be done yet, bus is not used */
+	if(sensor->state == TC74_STATE_WAITING)
+	{
+		if((uint16_t)(now_ms - sensor->checked_at) < TC74_CONVERSION_MS)
+			return TC74_NOT_READY;
+		sensor->state = TC74_STATE_CHECK;
+	}
+	
+	/* After power up and standby RTR is valid only when DATA_RDY is set.
+	 * It stays set while the sensor converts, so it is read only once.
+	 */
+	if(sensor->state == TC74_STATE_CHECK)
+	{
+		status = tinyi2c_device_read_regs(&sensor->device, TC74_RWCR, &value, 1);
+		if(status)
+			return status;
+		if(!(value & TC74_DATA_RDY))
+		{
+			sensor->state = TC74_STATE_WAITING;
+			sensor->checked_at = now_ms;
+			return TC74_NOT_READY;
+		}
+		sensor->state = TC74_STATE_READY;
+	}
+	
+	status = tinyi2c_device_read_regs(&sensor->device, TC74_RTR, &value, 1);
+	if(status)
+	{
+		/* sensor may have been unplugged or lost power */
+		sensor->state = TC74_STATE_CHECK;
+		return status;
+	}
+	
+	/* two's complement, 0xE7 is -25 C */
+	sensor->temperature = (int8_t)value;
+	sensor->read_at = now_ms;
+	sensor->valid = 1;
+	*temperature = sensor->temperature;
+	return 0;
+}
+
+/************************************************************************/
+/* For sparse reads, e.g. once a minute. Like tc74_read(), but after a  */
+/* new reading the sensor is put to standby. Next call wakes it up and  */
+/* returns TC74_NOT_READY, the call after conversion gets new reading.  */
+/* Call tc74_wake() early enough to get a value on the first call.      */
+/************************************************************************/
+unsigned char tc74_read_sparse(tc74_t* sensor, uint16_t now_ms, int8_t* temperature)
+{
+	unsigned char status;
+	
+	/* no new conversion could exist even if the sensor was awake */
+	if(sensor->valid && (uint16_t)(now_ms - sensor->read_at) < TC74_CONVERSION_MS)
+	{
+		*temperature = sensor->temperature;
+		return TC74_CACHED;
+	}
+	
+	status = tc74_read(sensor, now_ms, temperature);
+	if(status == 0)
+		tc74_standby(sensor);
+	return status;
+}
+
+/************************************************************************/
+/* Stops conversions, sensor keeps its registers and answers to I2C.    */
+/************************************************************************/
+unsigned char tc74_standby(tc74_t* sensor)
+{
+	unsigned char status = tinyi2c_device_write_reg(&sensor->device, TC74_RWCR, TC74_SHDN);
+	
+	if(status == 0)
+		sensor->state = TC74_STATE_STANDBY;
+	return status;
+}
+
+/************************************************************************/
+/* Starts conversions, first result is ready after one conversion.      */
+/* tc74_read() does not use the bus before TC74_CONVERSION_MS from      */
+/* now_ms.                                                              */
+/************************************************************************/
+unsigned char tc74_wake(tc74_t* sensor, uint16_t now_ms)
+{
+	unsigned char status = tinyi2c_device_write_reg(&sensor->device, TC74_RWCR, 0);
+	
+	if(status == 0)
+	{
+		sensor->state = TC74_STATE_WAITING;
+		sensor->checked_at = now_ms;
+	}
+	return status;
+}
@@ -0,0 +1,136 @@
+/*
+ * tc74.h
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of TC74 temperature sensor
+ * driver for ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	TC74 temperature sensor driver (tc74.h and tc74.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * TC74 is a temperature sensor with SMBus/I2C interface. It converts about
+ * 8 times per second and keeps the last result in register RTR as signed
+ * degrees Celsius. Register RWCR has standby bit SHDN and DATA_RDY bit, 
+ * which is set when the first conversion after power up or standby is 
+ * done. Standby current is 5 uA instead of 200 uA.
+ * See more: TC74 datasheet (DS21462), "Register Set and Programmer's Model".
+ *
+ * Reading is cached. TC74 can not have a new result sooner than 125 ms
+ * after the previous one, until then tc74_read() returns the cached value
+ * without bus access and status TC74_CACHED instead of 0. DATA_RDY is
+ * read only after power up and standby, later it stays set. While it is
+ * not set, RWCR is read again only after TC74_CONVERSION_MS, and after
+ * tc74_wake() not before one conversion time. Time is given by the caller
+ * in milliseconds, any counter which wraps at 65536 will do.
+ *
+ * Sensor is accessed through the device registry of tinyi2c, absent
+ * sensor costs no bus time except probes now and then.
+ *
+ * Eight addresses A0..A7 exist, TC74_ADDRESS(3) is 0x96 of TC74A3. 
+ *
+ * usage:
+ *
+ *	tc74_t inside, outside;
+ *	uint16_t now_ms = 0, logged_ms = 0;
+ *	unsigned char status;
+ *	int8_t celsius;
+ *
+ *	tinyi2c_init();
+ *	tc74_init(&inside, TC74_ADDRESS(3));
+ *	tc74_init(&outside, TC74_ADDRESS(5));
+ *
+ *	while(1)
+ *	{
+ *		// as often as needed, bus is used at most 8 times per second.
+ *		// 0 is a new reading, TC74_CACHED the previous one.
+ *		status = tc74_read(&inside, now_ms, &celsius);
+ *		if(status == 0 || status == TC74_CACHED)
+ *			show(celsius);
+ *
+ *		// once a minute: first call wakes up, the call after conversion
+ *		// gets the value and puts the sensor to standby again
+ *		if((uint16_t)(now_ms - logged_ms) >= 60000)
+ *		{
+ *			status = tc74_read_sparse(&outside, now_ms, &celsius);
+ *			if(status == 0)
+ *				log(celsius);
+ *			if(status != TC74_NOT_READY)
+ *				logged_ms = now_ms;
+ *		}
+ *	}
+ */
+
+#ifndef TC74_H
+#define TC74_H
+
+#include <stdint.h>
+#include "tinyi2c.h"
+
+/* 8 bit address (SLA+W) of TC74A0..TC74A7 */
+#define TC74_ADDRESS(n) (0x90 + ((n) << 1))
+
+/* registers */
+#define TC74_RTR 0x00
+#define TC74_RWCR 0x01
+
+/* bits of RWCR */
+#define TC74_SHDN 0x80
+#define TC74_DATA_RDY 0x40
+
+/* Time between conversions in ms, 8 samples per second typical. */
+#ifndef TC74_CONVERSION_MS
+#define TC74_CONVERSION_MS 125
+#endif
+
+/* SMBus devices are specified up to 100 kHz */
+#ifndef TC74_SCL_HZ
+#define TC74_SCL_HZ 100000UL
+#endif
+
+/* error status when first conversion after power up or standby is not
+ * done yet. Continues the error codes of tinyi2c.h. */
+#define TC74_NOT_READY 6
+
+/* status when temperature is the cached reading and bus was not used,
+ * not an error */
+#define TC74_CACHED 7
+
+/* states of tc74_t */
+#define TC74_STATE_CHECK 0     /* DATA_RDY must be read before RTR */
+#define TC74_STATE_READY 1     /* converting, RTR is valid */
+#define TC74_STATE_STANDBY 2
+#define TC74_STATE_WAITING 3   /* converting, RWCR is read after checked_at */
+
+typedef struct
+{
+	tinyi2c_device_t device;
+	int8_t temperature;        /* last reading in degrees Celsius */
+	uint16_t read_at;          /* time of last reading in ms */
+	uint16_t checked_at;       /* time of wake or last RWCR read in ms */
+	unsigned char valid;       /* 1 when temperature has been read */
+	unsigned char state;
+} tc74_t;
+
+extern void tc74_init(tc74_t* sensor, unsigned char sla);
+
+extern unsigned char tc74_read(tc74_t* sensor, uint16_t now_ms, int8_t* temperature);
+
+extern unsigned char tc74_read_sparse(tc74_t* sensor, uint16_t now_ms, int8_t* temperature);
+
+extern unsigned char tc74_standby(tc74_t* sensor);
+
+extern unsigned char tc74_wake(tc74_t* sensor, uint16_t now_ms);
+
+#endif /* TC74_H */
@@ -38,6 +38,78 @@
  */
 
 #include "tinyi2c.h"
+#include <util/delay.h>
+
+#ifndef F_CPU
+# error "F_CPU must be defined for I2C bit rate"
+#endif
+
+/* CPU cycles of one round of the TWINT wait loop, estimated from the
+ * generated code (lds, sbrc, sbiw, brne, rjmp) */
+#define TINYI2C_WAIT_LOOP_CYCLES 8
+
+/* rounds of the wait loop in TINYI2C_TIMEOUT_US */
+#define TINYI2C_TIMEOUT_LOOPS ((F_CPU / 1000000UL) * TINYI2C_TIMEOUT_US / TINYI2C_WAIT_LOOP_CYCLES)
+
+#if TINYI2C_TIMEOUT_LOOPS > 65535 || TINYI2C_TIMEOUT_LOOPS < 1
+# error "TINYI2C_TIMEOUT_US does not fit to 16 bit loop counter at this F_CPU"
+#endif
+
+/* status of the last tinyi2c_readbyte_ack() or tinyi2c_readbyte_not_ack() */
+unsigned char tinyi2c_status;
+
+/* CPU clocks per SCL period, rounded up so SCL is never faster than asked */
+#define TINYI2C_DIVIDER(hz) ((F_CPU + (hz) - 1) / (hz))
+
+/* Smallest TWBR for stable operation of the TWI master. Datasheets of
+ * older megaAVRs require at least 10, so SCL is at most F_CPU / 36.
+ */
+#define TINYI2C_TWBR_MIN 10
+
+/* TWBR for prescaler 4^twps, rounded up */
+#define TINYI2C_TWBR_FOR(hz, twps) \
+	((TINYI2C_DIVIDER(hz) - 16 + (2UL << (2 * (twps))) - 1) / (2UL << (2 * (twps))))
+
+/* smallest prescaler with which TWBR fits to 8 bits gives closest rate */
+#if TINYI2C_DIVIDER(TINYI2C_SCL_HZ) < 16 + 2 * TINYI2C_TWBR_MIN
+# warning "TINYI2C_SCL_HZ needs TWBR below 10, F_CPU / 36 is used"
+# define TINYI2C_TWPS 0
+# define TINYI2C_TWBR TINYI2C_TWBR_MIN
+#elif TINYI2C_TWBR_FOR(TINYI2C_SCL_HZ, 0) <= 255
+# define TINYI2C_TWPS 0
+#elif TINYI2C_TWBR_FOR(TINYI2C_SCL_HZ, 1) <= 255
+# define TINYI2C_TWPS 1
+#elif TINYI2C_TWBR_FOR(TINYI2C_SCL_HZ, 2) <= 255
+# define TINYI2C_TWPS 2
+#elif TINYI2C_TWBR_FOR(TINYI2C_SCL_HZ, 3) <= 255
+# define TINYI2C_TWPS 3
+#else
+# error "TINYI2C_SCL_HZ is too slow for this F_CPU"
+#endif
+
+#ifndef TINYI2C_TWBR
+#define TINYI2C_TWBR TINYI2C_TWBR_FOR(TINYI2C_SCL_HZ, TINYI2C_TWPS)
+#endif
+
+#if TINYI2C_SCL_HZ < TINYI2C_SCL_MIN_HZ
+# error "TINYI2C_SCL_HZ is too slow for TINYI2C_TIMEOUT_US, increase the timeout"
+#endif
+
+/************************************************************************/
+/* Wait until TWINT Flag set, at most TINYI2C_TIMEOUT_US.               */
+/* Returns 0 or BUS_TIMEOUT.                                            */
+/************************************************************************/
+static unsigned char tinyi2c_wait_twint()
+{
+	uint16_t loops = TINYI2C_TIMEOUT_LOOPS;
+	
+	while (!(TWCR & (1<<TWINT)))
+	{
+		if(--loops == 0)
+			return BUS_TIMEOUT;
+	}
+	return 0;
+}
 
 /************************************************************************/
 /* initializes I2C bus interface			                            */
@@ -72,17 +144,20 @@ void tinyi2c_init()
 	 */
 	
 	/* datasheet ATmega16/32U4 (page: 232-233, TWI Status Register)
-	 * TWSR = 0x00 sets prescaler bit TWPS to factor 1, so no prescaler in use.
+	 * TWPS bits of TWSR select prescaler 1, 4, 16 or 64. Other bits are
+	 * read only status bits.
 	 */
-	TWSR = 0x00;
+	TWSR = TINYI2C_TWPS;
 	
 	/* TWBR selects the division factor for the bit rate generator. The bit rate 
 	 * generator is a frequency divider which generates the SCL clock frequency 
-	 * in the Master modes. Must be > 10 for stable operation.
+	 * in the Master modes. TWBR should be 10 or more for stable operation.
+	 * SCL frequency = F_CPU / (16 + 2 * TWBR * 4^TWPS), values are computed
+	 * above from TINYI2C_SCL_HZ. For example 16 MHz and 100 kHz is TWBR 72.
 	 * See more: datasheet ATmega16/32U4 (page: 231, TWI Bit Rate Register)
 	 * and datasheet section "20.5.2 Bit Rate Generator Unit"
 	 */
-	TWBR = 0x04; // clockfreq = 2mhz/(16+2*4*4^1) = ~41,5khz
+	TWBR = TINYI2C_TWBR;
 	
 	
 	
@@ -100,11 +175,70 @@ void tinyi2c_init()
 	*/
 }
 
+/************************************************************************/
+/* TWBR and prescaler bits for SCL frequency scl_hz. Closest frequency  */
+/* which is not faster is chosen, at most F_CPU / 36 (TWBR 10) and at   */
+/* least F_CPU / 32656. Rates below TINYI2C_SCL_MIN_HZ use that one.    */
+/************************************************************************/
+void tinyi2c_bit_rate(uint32_t scl_hz, unsigned char* twbr, unsigned char* twps)
+{
+	uint32_t divider;
+	uint32_t value = TINYI2C_TWBR_MIN;
+	unsigned char prescaler = 0;
+	
+	/* a byte at slower rate would end in BUS_TIMEOUT */
+	if(scl_hz < TINYI2C_SCL_MIN_HZ)
+		scl_hz = TINYI2C_SCL_MIN_HZ;
+	divider = (F_CPU + scl_hz - 1) / scl_hz;
+	
+	/* same rounding as TINYI2C_TWBR_FOR(), in run time */
+	if(divider >= 16 + 2 * TINYI2C_TWBR_MIN)
+	{
+		for(prescaler=0;;prescaler++)
+		{
+			value = (divider - 16 + (2UL << (2 * prescaler)) - 1) / (2UL << (2 * prescaler));
+			if(value <= 255 || prescaler == 3)
+				break;
+		}
+		if(value > 255)
+			value = 255;
+	}
+	
+	*twbr = value;
+	*twps = prescaler;
+}
+
+/************************************************************************/
+/* Initializes I2C bus interface with SCL frequency scl_hz, see         */
+/* tinyi2c_bit_rate(). Returns the frequency in use.                    */
+/************************************************************************/
+uint32_t tinyi2c_init_hz(uint32_t scl_hz)
+{
+	unsigned char twbr, twps;
+	
+	tinyi2c_init();
+	tinyi2c_bit_rate(scl_hz, &twbr, &twps);
+	TWSR = twps;
+	TWBR = twbr;
+	return tinyi2c_scl_hz();
+}
+
+/************************************************************************/
+/* Returns SCL frequency in Hz set by TWBR and prescaler                */
+/************************************************************************/
+uint32_t tinyi2c_scl_hz()
+{
+	unsigned char twps = TWSR & ((1<<TWPS1) | (1<<TWPS0));
+	return F_CPU / (16 + ((uint32_t)TWBR << (1 + 2 * twps)));
+}
+
 /************************************************************************/
 /* Send start condition, address and data direction.                     */
 /************************************************************************/
 unsigned char tinyi2c_start(unsigned char sla)
 {
+	unsigned char status;
+	
 	/* Send start condition to TWI Control Register 
 	 * The TWCR is used to control the operation of the TWI. It is used to enable 
 	 * the TWI, to initiate a Master access by applying a START condition 
@@ -114,9 +248,12 @@ unsigned char tinyi2c_start(unsigned char sla)
 	 * attempted written to TWDR while the register is inaccessible.
 	 * See more: datasheet ATmega16/32U4 (page: 231-232, TWI Control Register).
 	 */
-	TWCR = (1<<TWINT);		/* TWI initialize and interrupt bit */
-	TWCR |=(1<<TWSTA);      /* TWI START Condition Bit */
-	TWCR |=(1<<TWEN);       /* TWI Enable Bit */
+	TWCR = (1<<TWINT)		/* TWI initialize and interrupt bit */
+		 | (1<<TWSTA)		/* TWI START Condition Bit */
+		 | (1<<TWEN);		/* TWI Enable Bit */
+	/* All bits are written at once. Writing TWEN to zero, even for one
+	 * instruction, switches TWI off and would break repeated START.
+	 */
 
 	/* Wait until TWINT Flag set. This indicates that the START
 	 * condition has been transmitted- After a START condition has been 
@@ -124,8 +261,11 @@ unsigned char tinyi2c_start(unsigned char sla)
 	 * code in TWSR will be 0x08. See more at datasheet page 240, 
 	 * Table 20-3. Status codes for Master Transmitter Mode and
 	 * Table 20-4. Status codes for Master Receiver Mode.
+	 * START waits until bus is free. If it never is, or SCL is held low,
+	 * the wait ends after TINYI2C_TIMEOUT_US.
 	 */
-	while (!(TWCR & (1<<TWINT)));
+	if (tinyi2c_wait_twint())
+		return BUS_TIMEOUT;
 	
 	/* Check value of TWI Status Register. Mask prescaler bits to zero.
 	 * We should not compare prescaler bits. This makes status checking 
@@ -136,9 +276,12 @@ unsigned char tinyi2c_start(unsigned char sla)
 	 * See more at datasheet page 240,
 	 * Table 20-3. Status codes for Master Transmitter Mode and
 	 * Table 20-4. Status codes for Master Receiver Mode. 
+	 * START sent while bus is still ours (no stop before) is a repeated
+	 * START and the status code is 0x10 instead.
 	 */ 
-	if ((TWSR & 0xF8) != TW_START)
-		return STATUS_ERROR; //error
+	status = TWSR & 0xF8;
+	if (status != TW_START && status != TW_REP_START)
+		return status == TW_MT_ARB_LOST ? ARBITRATION_LOST : STATUS_ERROR; //error
 	
 	/* send address of I2C device in bus and clear TWINT bit in
 	 * TWCR to start transmission of address+r/w bit 
@@ -149,21 +292,46 @@ unsigned char tinyi2c_start(unsigned char sla)
 	/* Wait for TWINT Flag set. This indicates that the address+read/write
 	 * bit has been transmitted, and ACK/NACK has been received. 
 	 */
-	while(!(TWCR & (1<<TWINT)));
+	if (tinyi2c_wait_twint())
+		return BUS_TIMEOUT;
 	
 	/* Check value of TWI Status Register. Mask prescaler bits to zero.
 	 * If SLA+W is transmitted, MT mode is entered, if SLA+R is transmitted,
 	 * MR mode is entered. All the status codes mentioned in this section 
 	 * assume that the prescaler bits are zero or are masked to zero.
+	 * SLA+W is acknowledged with 0x18 and SLA+R with 0x40. Other master
+	 * can win the arbitration while address is sent (0x38).
 	 */
-	if ((TWSR & 0xF8) != TW_MT_SLA_ACK)
+	status = TWSR & 0xF8;
+	if (status == TW_MT_ARB_LOST)
+		return ARBITRATION_LOST;
+	if (status != ((sla & I2CREAD) ? TW_MR_SLA_ACK : TW_MT_SLA_ACK))
 		return DEVICE_NOT_FOUND; //error
 
 	return 0;
 }
 
 /************************************************************************/
-/* Read a byte from the I2C device and wait for more                    */
+/* Wait for received byte and check status, expected is TW_MR_DATA_ACK  */
+/* or TW_MR_DATA_NACK. Returns 0, BUS_TIMEOUT or ARBITRATION_LOST.      */
+/************************************************************************/
+static unsigned char tinyi2c_received(unsigned char expected)
+{
+	unsigned char status;
+	
+	if (tinyi2c_wait_twint())
+		return BUS_TIMEOUT;
+	
+	/* arbitration can be lost also while receiving, in the ACK bit */
+	status = TWSR & 0xF8;
+	if (status == TW_MR_ARB_LOST)
+		return ARBITRATION_LOST;
+	return status == expected ? 0 : STATUS_ERROR;
+}
+
+/************************************************************************/
+/* Read a byte from the I2C device and wait for more.                   */
+/* tinyi2c_status is 0 or error code after this.                        */
 /************************************************************************/
 unsigned char tinyi2c_readbyte_ack()
 {
@@ -181,14 +349,15 @@ unsigned char tinyi2c_readbyte_ack()
 	 * condition has been transmitted. 
 	 * Data byte will be received and ACK will be returned 
 	 */
-	while (!(TWCR & (1<<TWINT)));
+	tinyi2c_status = tinyi2c_received(TW_MR_DATA_ACK);
 	
 	/* return the received byte */
 	return TWDR;
 }
 
 /************************************************************************/
-/* Read a byte from the I2C device and stop				                */
+/* Read a byte from the I2C device and stop.                            */
+/* tinyi2c_status is 0 or error code after this.                        */
 /************************************************************************/
 unsigned char tinyi2c_readbyte_not_ack()
 {
@@ -205,7 +374,7 @@ unsigned char tinyi2c_readbyte_not_ack()
 	/* Wait for TWINT Flag set. Data byte will be received and NOT ACK 
 	 * will be returned. 
 	 */
-	while (!(TWCR & (1<<TWINT)));
+	tinyi2c_status = tinyi2c_received(TW_MR_DATA_NACK);
 	
 	/* return the received byte */
 	return TWDR;
@@ -225,29 +394,180 @@ unsigned char tinyi2c__write( unsigned char data )
 	/* Wait for TWINT Flag set. This indicates that the DATA has been
 	 * transmitted, and ACK/NACK has been received.
 	 */
-	while(!(TWCR & (1<<TWINT)));
+	if (tinyi2c_wait_twint())
+		return BUS_TIMEOUT;
 
 	/* Check value of TWI Status Register. Mask prescaler bits to zero.
 	 * If SLA+W is transmitted, MT mode is entered, if SLA+R is transmitted,
 	 * MR mode is entered.
+	 * TW_STATUS is TWSR already masked with 0xF8.
 	 */
-	if( TW_STATUS & 0xF8 != TW_MT_DATA_ACK) 
+	switch (TW_STATUS)
+	{
+	case TW_MT_DATA_ACK:
+		return 0;
+	case TW_MT_DATA_NACK:
+		return DATA_NACK;
+	case TW_MT_ARB_LOST:
+		return ARBITRATION_LOST;
+	default:
 		return STATUS_ERROR;
-	
-	return 0;
+	}
 }	
 
 /************************************************************************/
 /* Stops the data transfer and releases I2C bus                         */
 /************************************************************************/
-void tinyi2c_stop()
+unsigned char tinyi2c_stop()
 {
+	uint16_t loops = TINYI2C_TIMEOUT_LOOPS;
+	
 	/* Clear TWINT bit in TWCR to start transmission of data.
 	 * STOP condition will be transmitted and TWSTO Flag will be reset.
 	 */
 	TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
 	
-	/* wait for stop condition (TWSTO) is executed and bus released 
+	/* wait for stop condition (TWSTO) is executed and bus released.
+	 * STOP can not be sent while a slave holds SCL low.
+	 */
+	while(TWCR & (1<<TWSTO))
+	{
+		if(--loops == 0)
+			return BUS_TIMEOUT;
+	}
+	return 0;
+}
+
+/************************************************************************/
+/* Frees the bus when a slave holds SDA low, e.g. after reset of the    */
+/* master in the middle of a read. Slave is clocked until it has sent   */
+/* its byte and releases SDA, at most 9 clocks, then STOP is sent.      */
+/* Returns 0 if bus is free, STATUS_ERROR if SDA or SCL is still low.   */
+/************************************************************************/
+unsigned char tinyi2c_recover()
+{
+	unsigned char clocks;
+	uint16_t loops;
+	
+	/* TWI off, PD0 (SCL) and PD1 (SDA) are ordinary port pins again.
+	 * Lines are open drain: low is output 0, high is input and the
+	 * pull-up resistors pull the line up.
+	 */
+	TWCR = 0;
+	PORTD &= ~((1<<PD1) | (1<<PD0));
+	DDRD &= ~((1<<PD1) | (1<<PD0));
+	
+	for(clocks=0;clocks<9 && !(PIND & (1<<PD1));clocks++)
+	{
+		DDRD |= (1<<PD0);	// SCL low
+		_delay_us(5);
+		DDRD &= ~(1<<PD0);	// SCL released
+		
+		/* slave may stretch the clock, wait for SCL high */
+		loops = TINYI2C_TIMEOUT_LOOPS;
+		while(!(PIND & (1<<PD0)) && --loops);
+		_delay_us(5);
+	}
+	
+	/* STOP: SDA goes from low to high while SCL is high */
+	DDRD |= (1<<PD0);		// SCL low
+	DDRD |= (1<<PD1);		// SDA low
+	_delay_us(5);
+	DDRD &= ~(1<<PD0);		// SCL high
+	_delay_us(5);
+	DDRD &= ~(1<<PD1);		// SDA high, STOP
+	_delay_us(5);
+	
+	/* pull-ups back on and TWI on, bit rate is kept */
+	PORTD |= (1<<PD1) | (1<<PD0);
+	TWCR = (1<<TWEN);
+	
+	if((PIND & ((1<<PD1) | (1<<PD0))) != ((1<<PD1) | (1<<PD0)))
+		return STATUS_ERROR;
+	return 0;
+}
+
+/************************************************************************/
+/* Read count bytes, every byte but the last is acknowledged.           */
+/* Returns 0 or error code of the first failed byte.                    */
+/************************************************************************/
+unsigned char tinyi2c_read(unsigned char* data, unsigned char count)
+{
+	if(count == 0)
+		return 0;
+	
+	/* ACK tells the device to send one more byte, NOT ACK after the
+	 * last byte ends the read. See more at datasheet:
+	 * Table 20-4. Status codes for Master Receiver Mode
 	 */
-	while(TWCR & (1<<TWSTO));
-}
\ No newline at end of file
+	while(--count)
+	{
+		*data++ = tinyi2c_readbyte_ack();
+		if(tinyi2c_status)
+			return tinyi2c_status;
+	}
+	*data = tinyi2c_readbyte_not_ack();
+	return tinyi2c_status;
+}
+
+/************************************************************************/
+/* Write write_count bytes, then repeated START and read read_count     */
+/* bytes, and STOP. Bus is not released between writing and reading,    */
+/* so no other master can change e.g. the register pointer in between.  */
+/* Returns 0 or error code. Takes at most (write_count + read_count +   */
+/* 3) * TINYI2C_TIMEOUT_US, plus bus recovery after BUS_TIMEOUT.        */
+/************************************************************************/
+unsigned char tinyi2c_write_read(unsigned char sla, unsigned char* write, unsigned char write_count,
+								 unsigned char* read, unsigned char read_count)
+{
+	unsigned char status = 0;
+	
+	/* Master Transmitter mode, also when there is nothing to transfer
+	 * and only the ACK of the address is checked */
+	if(write_count || !read_count)
+	{
+		status = tinyi2c_start(sla & ~I2CREAD);
+		while(!status && write_count--)
+			status = tinyi2c__write(*write++);
+	}
+	
+	/* Master Receiver mode. When write part was sent this START is a
+	 * repeated START (status 0x10), tinyi2c_start() accepts both. */
+	if(!status && read_count)
+	{
+		status = tinyi2c_start(sla | I2CREAD);
+		if(!status)
+			status = tinyi2c_read(read, read_count);
+	}
+	
+	/* after lost arbitration TWSTO only releases the lines, other 
+	 * master owns the bus. Stuck bus is cleared by recovery. */
+	if(tinyi2c_stop() && !status)
+		status = BUS_TIMEOUT;
+	if(status == BUS_TIMEOUT)
+		tinyi2c_recover();
+	return status;
+}
+
+/************************************************************************/
+/* Write one register: START, SLA+W, reg, value, STOP                   */
+/************************************************************************/
+unsigned char tinyi2c_write_reg(unsigned char sla, unsigned char reg, unsigned char value)
+{
+	unsigned char data[2];
+	
+	data[0] = reg;
+	data[1] = value;
+	return tinyi2c_write_read(sla, data, 2, 0, 0);
+}
+
+/************************************************************************/
+/* Read count registers starting from reg: START, SLA+W, reg,           */
+/* repeated START, SLA+R, count bytes, STOP. Devices with auto          */
+/* increment register pointer return consecutive registers.             */
+/************************************************************************/
+unsigned char tinyi2c_read_regs(unsigned char sla, unsigned char reg, unsigned char* data,
+								unsigned char count)
+{
+	return tinyi2c_write_read(sla, &reg, 1, data, count);
+}
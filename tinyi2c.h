@@ -57,6 +57,13 @@
  *		tinyi2c_stop();
  *  }
  *
+ * Register access, one bus transaction with repeated START:
+ *
+ *	unsigned char sample[6];
+ *
+ *	tinyi2c_write_reg(0x3C, 0x02, 0x00);		// register 2 = 0
+ *	tinyi2c_read_regs(0x3C, 0x03, sample, 6);	// registers 3..8
+ *
  */
 
 
@@ -66,6 +73,16 @@
 #include <avr/io.h>
 #include <util/twi.h>
 
+/* SCL frequency set by tinyi2c_init(). Standard mode is 100000 and Fast
+ * mode 400000, closest frequency which is not faster is used. At 16 MHz
+ * these are exact, TWBR 72 and 12. tinyi2c_init_hz() sets it in run time.
+ * TWBR should be 10 or more, which limits SCL to F_CPU / 36: 444 kHz at
+ * 16 MHz but only 222 kHz at 8 MHz. Faster rates use TWBR 10.
+ */
+#ifndef TINYI2C_SCL_HZ
+#define TINYI2C_SCL_HZ 100000UL
+#endif
+
 /* start condition for TWI Status Register*/
 #define START (1<<TWINT)|(1<<TWSTA)|(1<<TWEN)
 
@@ -75,6 +92,30 @@
 /* error status when device address sending fails */
 #define DEVICE_NOT_FOUND 2
 
+/* error status when device does not acknowledge a data byte */
+#define DATA_NACK 3
+
+/* error status when other master took the bus */
+#define ARBITRATION_LOST 4
+
+/* error status when TWI did not finish in TINYI2C_TIMEOUT_US, bus is
+ * stuck and has been recovered with tinyi2c_recover() */
+#define BUS_TIMEOUT 5
+
+/* Longest wait for one START, byte or STOP in microseconds. One byte is 9
+ * SCL periods, 90 us at 100 kHz. Increase if a slave stretches the clock
+ * longer. Longest transaction is its bytes + 3 times this.
+ */
+#ifndef TINYI2C_TIMEOUT_US
+#define TINYI2C_TIMEOUT_US 1000
+#endif
+
+/* Slowest SCL frequency, one byte must fit in TINYI2C_TIMEOUT_US with a
+ * period to spare: 10 kHz with the default timeout. Slower rates asked
+ * from tinyi2c_init_hz() use this, increase TINYI2C_TIMEOUT_US for them.
+ */
+#define TINYI2C_SCL_MIN_HZ (10 * 1000000UL / TINYI2C_TIMEOUT_US)
+
 /* address of i2c device */
 #define DEVICEADDR 0
 
@@ -90,6 +131,12 @@
 
 extern void tinyi2c_init();
 
+extern uint32_t tinyi2c_init_hz(uint32_t scl_hz);
+
+extern uint32_t tinyi2c_scl_hz();
+
+extern void tinyi2c_bit_rate(uint32_t scl_hz, unsigned char* twbr, unsigned char* twps);
+
 extern unsigned char tinyi2c_start(unsigned char address);
 
 extern unsigned char tinyi2c_readbyte_ack();
@@ -98,15 +145,88 @@ extern unsigned char tinyi2c_readbyte_not_ack();
 
 extern unsigned char tinyi2c__write(unsigned char data);
 
-extern void tinyi2c_stop();
+extern unsigned char tinyi2c_stop();
+
+extern unsigned char tinyi2c_recover();
+
+/* status of the last tinyi2c_readbyte_ack() or tinyi2c_readbyte_not_ack() */
+extern unsigned char tinyi2c_status;
+
+extern unsigned char tinyi2c_read(unsigned char* data, unsigned char count);
+
+extern unsigned char tinyi2c_write_read(unsigned char sla, unsigned char* write, unsigned char write_count,
+										unsigned char* read, unsigned char read_count);
+
+extern unsigned char tinyi2c_write_reg(unsigned char sla, unsigned char reg, unsigned char value);
 
-/* not in use */
-struct TinyI2C
+extern unsigned char tinyi2c_read_regs(unsigned char sla, unsigned char reg, unsigned char* data,
+									   unsigned char count);
+
+/* status of a queued transfer until it is done */
+#define TINYI2C_PENDING 0xFF
+
+/* I2C transaction for interrupt driven transfers (tinyi2c_async.c).
+ * write_count bytes from write are sent first, then read_count bytes are
+ * read to read after a repeated START. Either part can be empty.
+ */
+typedef struct tinyi2c_transfer
 {
-	unsigned char TxPort;
-	unsigned char RxPort;
-	unsigned char DeviceAddr;
-	unsigned char DataDirection;
-} tinyi2c;
+	unsigned char sla;             /* device address, data direction bit is ignored */
+	unsigned char* write;
+	unsigned char write_count;
+	unsigned char* read;
+	unsigned char read_count;
+	volatile unsigned char status; /* TINYI2C_PENDING, 0 when done or error code */
+	void (*done)(struct tinyi2c_transfer* transfer); /* called in interrupt, or 0 */
+} tinyi2c_transfer_t;
+
+extern void tinyi2c_async_init();
+
+extern unsigned char tinyi2c_submit(tinyi2c_transfer_t* transfer);
+
+extern unsigned char tinyi2c_idle();
+
+extern unsigned char tinyi2c_wait(tinyi2c_transfer_t* transfer);
+
+extern void tinyi2c_abort(tinyi2c_transfer_t* transfer);
+
+/* first and last 7 bit address which is not reserved, 112 addresses */
+#define TINYI2C_FIRST_ADDRESS 0x08
+#define TINYI2C_LAST_ADDRESS 0x77
+
+/* At most this many accesses are skipped between probes of an absent
+ * device. Skip count doubles after every failed probe up to this.
+ */
+#ifndef TINYI2C_BACKOFF_MAX
+#define TINYI2C_BACKOFF_MAX 128
+#endif
+
+/* Device in the registry (tinyi2c_devices.c). Absent device costs no bus
+ * time, its accesses fail at once until the next probe.
+ */
+typedef struct TinyI2C
+{
+	unsigned char sla;             /* device address, SLA+W */
+	unsigned char present;         /* 1 when last access found the device */
+	unsigned char twbr;            /* bit rate of this device */
+	unsigned char twps;
+	unsigned char last_error;      /* error code of last failed access */
+	uint16_t errors;               /* failed accesses, stops at 65535 */
+	unsigned char backoff;         /* accesses to skip after next failed probe */
+	unsigned char skip;            /* accesses to skip before next probe */
+} tinyi2c_device_t;
+
+extern void tinyi2c_device_init(tinyi2c_device_t* device, unsigned char sla, uint32_t scl_hz);
+
+extern unsigned char tinyi2c_scan(tinyi2c_device_t* devices, unsigned char max_count);
+
+extern unsigned char tinyi2c_device_write_read(tinyi2c_device_t* device,
+											   unsigned char* write, unsigned char write_count,
+											   unsigned char* read, unsigned char read_count);
+
+extern unsigned char tinyi2c_device_write_reg(tinyi2c_device_t* device, unsigned char reg, unsigned char value);
+
+extern unsigned char tinyi2c_device_read_regs(tinyi2c_device_t* device, unsigned char reg,
+											  unsigned char* data, unsigned char count);
 
 #endif /* TINYI2C_H */
\ No newline at end of file
@@ -0,0 +1,390 @@
+/*
+ * tinyi2c_async.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of I2C Bus driver for
+ * ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Tiny I2C, interrupt driven transfers (tinyi2c_async.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * Functions of tinyi2c.c wait for TWINT after every START, address and data
+ * byte. One byte is 9 SCL clocks, at 41.5 kHz about 220 us of busy loop.
+ * Here whole transfers are described with tinyi2c_transfer_t and put to a
+ * queue. TWI interrupt is set with TWINT, TWI_vect reads the status code 
+ * and does the next step of the transfer, main loop runs in between.
+ *
+ * Transfer is done in Master Transmitter mode if it has bytes to write and
+ * in Master Receiver mode if it has bytes to read. When it has both, bytes 
+ * are written first and then a repeated START switches to reading, bus is
+ * not released in between. Every byte but the last is acknowledged when
+ * reading. Transfer without bytes only sends SLA+W and checks the ACK.
+ *
+ * When transfer is done status is set to 0 or error code (DEVICE_NOT_FOUND
+ * when address was not acknowledged, DATA_NACK when data was not, 
+ * STATUS_ERROR when bus failed) and done callback is called if it is set.
+ * Callback runs inside TWI_vect, keep it short. It may submit a new
+ * transfer. Lost arbitration restarts the transfer when bus is free again.
+ *
+ * Stuck bus gives no more interrupts. tinyi2c_wait() gives up after the
+ * time the transfer may take and calls tinyi2c_abort(), which ends the
+ * transfer with BUS_TIMEOUT, recovers the bus and starts the next one.
+ * Code which does not wait can call tinyi2c_abort() with its transfer 
+ * from the main loop when its own timer runs out. Transfer which is done
+ * or not running yet is not aborted.
+ *
+ * START written while STOP is still being sent would replace the STOP.
+ * Transfer submitted from the done callback is started with STOP and 
+ * START together after the callback, others wait until TWSTO is cleared.
+ *
+ * Buffers and the descriptor must stay valid until status is not
+ * TINYI2C_PENDING. Do not use blocking functions of tinyi2c.c before 
+ * tinyi2c_idle() returns 1. Add this file to project to use it, it 
+ * reserves TWI_vect.
+ *
+ * usage:
+ *
+	unsigned char reg = 0x00;
+	unsigned char temperature;
+	tinyi2c_transfer_t read_temp = { 0x96, &reg, 1, &temperature, 1 };
+	
+	tinyi2c_async_init();
+	sei();
+	
+	tinyi2c_submit(&read_temp);
+	while(1)
+	{
+		if(read_temp.status != TINYI2C_PENDING)
+		{
+			if(read_temp.status == 0)
+				show(temperature);
+			tinyi2c_submit(&read_temp);
+		}
+		
+		// LCD refresh, ADC etc. run while the sensor is read
+	}
+ */
+
+#include "tinyi2c.h"
+#include <avr/interrupt.h>
+#include <util/delay.h>
+
+/* Number of transfers waiting or running, must be power of two */
+#ifndef TINYI2C_QUEUE_SIZE
+#define TINYI2C_QUEUE_SIZE 4
+#endif
+
+#if (TINYI2C_QUEUE_SIZE & (TINYI2C_QUEUE_SIZE - 1)) != 0 || TINYI2C_QUEUE_SIZE > 128
+# error "TINYI2C_QUEUE_SIZE must be power of two and at most 128"
+#endif
+
+#define TINYI2C_QUEUE_MASK (TINYI2C_QUEUE_SIZE - 1)
+
+/* tinyi2c_wait() looks at the transfer this often, in microseconds */
+#define TINYI2C_WAIT_SLICE_US 10
+
+/* slices in TINYI2C_TIMEOUT_US, at least one */
+#define TINYI2C_WAIT_SLICES \
+	(TINYI2C_TIMEOUT_US > TINYI2C_WAIT_SLICE_US ? TINYI2C_TIMEOUT_US / TINYI2C_WAIT_SLICE_US : 1)
+
+/* TWCR values, interrupt stays enabled until the queue is empty */
+#define TINYI2C_RUN ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+#define TINYI2C_STOP ((1<<TWINT) | (1<<TWEN) | (1<<TWSTO))
+
+/* Ring buffer of transfers. Running transfer stays at tail until it is
+ * done, so queue is empty exactly when bus is idle. */
+static tinyi2c_transfer_t* tinyi2c_queue[TINYI2C_QUEUE_SIZE];
+static volatile unsigned char tinyi2c_queue_head;
+static volatile unsigned char tinyi2c_queue_tail;
+
+/* position in the running transfer */
+static unsigned char tinyi2c_index;
+static unsigned char tinyi2c_reading;
+
+/* 1 while tinyi2c_abort() recovers the bus */
+static volatile unsigned char tinyi2c_recovering;
+
+/* 1 while done callback runs, tinyi2c_finish() starts the next transfer */
+static unsigned char tinyi2c_finishing;
+
+/************************************************************************/
+/* Initializes TWI for interrupt driven transfers                       */
+/************************************************************************/
+void tinyi2c_async_init()
+{
+	tinyi2c_queue_head = 0;
+	tinyi2c_queue_tail = 0;
+	tinyi2c_init();
+}
+
+/************************************************************************/
+/* START of a transfer. STOP of the transfer before is waited for at    */
+/* most TINYI2C_TIMEOUT_US, a stuck bus is left to tinyi2c_wait().      */
+/************************************************************************/
+static void tinyi2c_send_start()
+{
+	uint16_t us = TINYI2C_TIMEOUT_US;
+	
+	while((TWCR & (1<<TWSTO)) && us--)
+		_delay_us(1);
+	TWCR = TINYI2C_RUN | (1<<TWSTA);
+}
+
+/************************************************************************/
+/* Put transfer to queue. Returns 0, or STATUS_ERROR if queue was full. */
+/* Can be called from interrupts and from the done callback.            */
+/************************************************************************/
+unsigned char tinyi2c_submit(tinyi2c_transfer_t* transfer)
+{
+	unsigned char sreg = SREG;
+	unsigned char head, next;
+	
+	cli();
+	head = tinyi2c_queue_head;
+	next = (head + 1) & TINYI2C_QUEUE_MASK;
+	if(next == tinyi2c_queue_tail)
+	{
+		SREG = sreg;
+		transfer->status = STATUS_ERROR;
+		return STATUS_ERROR;
+	}
+	
+	transfer->status = TINYI2C_PENDING;
+	tinyi2c_queue[head] = transfer;
+	tinyi2c_queue_head = next;
+	
+	/* bus was idle, START begins this transfer. Otherwise interrupt
+	 * starts it when the ones before it are done. */
+	if(head == tinyi2c_queue_tail && !tinyi2c_finishing)
+	{
+		tinyi2c_index = 0;
+		tinyi2c_reading = 0;
+		tinyi2c_send_start();
+	}
+	SREG = sreg;
+	return 0;
+}
+
+/************************************************************************/
+/* Returns 1 when queue is empty and STOP of the last transfer is sent  */
+/************************************************************************/
+unsigned char tinyi2c_idle()
+{
+	return tinyi2c_queue_head == tinyi2c_queue_tail && !(TWCR & (1<<TWSTO));
+}
+
+/************************************************************************/
+/* Waits until transfer is done, returns its status. Waits at most the  */
+/* time of the transfers before it and its own, TINYI2C_TIMEOUT_US per  */
+/* byte, and then aborts the running transfer.                          */
+/************************************************************************/
+unsigned char tinyi2c_wait(tinyi2c_transfer_t* transfer)
+{
+	uint32_t slices = 0;
+	unsigned char sreg, tail;
+	
+	/* each transfer ahead could be stuck in turn */
+	while(transfer->status == TINYI2C_PENDING)
+	{
+		sreg = SREG;
+		cli();
+		tail = tinyi2c_queue_tail;
+		if(tail == tinyi2c_queue_head)
+		{
+			SREG = sreg;
+			break;
+		}
+		/* bytes + START, repeated START, STOP, each in short slices so
+		 * that the wait ends soon after the transfer */
+		slices = (uint32_t)(tinyi2c_queue[tail]->write_count + tinyi2c_queue[tail]->read_count + 3)
+			   * TINYI2C_WAIT_SLICES;
+		SREG = sreg;
+		
+		while(slices && transfer->status == TINYI2C_PENDING && tail == tinyi2c_queue_tail)
+		{
+			_delay_us(TINYI2C_WAIT_SLICE_US);
+			slices--;
+		}
+		if(!slices)
+			tinyi2c_abort(tinyi2c_queue[tail]);
+	}
+	return transfer->status;
+}
+
+/************************************************************************/
+/* Ends running transfer with STOP and starts the next one, also one    */
+/* which the done callback submits                                      */
+/************************************************************************/
+static void tinyi2c_finish(unsigned char status)
+{
+	unsigned char tail = tinyi2c_queue_tail;
+	tinyi2c_transfer_t* transfer = tinyi2c_queue[tail];
+	
+	tail = (tail + 1) & TINYI2C_QUEUE_MASK;
+	tinyi2c_queue_tail = tail;
+	
+	/* SCL is held low until TWCR is written, callback runs before it */
+	transfer->status = status;
+	if(transfer->done)
+	{
+		tinyi2c_finishing = 1;
+		transfer->done(transfer);
+		tinyi2c_finishing = 0;
+	}
+	
+	if(tail != tinyi2c_queue_head)
+	{
+		/* TWSTO and TWSTA together send STOP and then START.
+		 * See more: datasheet ATmega16/32U4 (page: 231-232, TWI Control Register).
+		 */
+		tinyi2c_index = 0;
+		tinyi2c_reading = 0;
+		TWCR = TINYI2C_STOP | (1<<TWSTA) | (1<<TWIE);
+	}
+	else
+		TWCR = TINYI2C_STOP;
+}
+
+/************************************************************************/
+/* Ends transfer with BUS_TIMEOUT if it is still running, recovers the  */
+/* bus and starts the next transfer. For a bus which gives no more      */
+/* interrupts. Recovery takes about 100 us and up to                    */
+/* 9 * TINYI2C_TIMEOUT_US more when a slave holds SCL low. Interrupts   */
+/* stay enabled, so call this from the main loop, not from interrupt.   */
+/************************************************************************/
+void tinyi2c_abort(tinyi2c_transfer_t* transfer)
+{
+	unsigned char sreg = SREG;
+	unsigned char tail;
+	
+	/* interrupt may have finished the transfer after its timeout, then
+	 * the one at tail is the next one and it is running fine */
+	cli();
+	tail = tinyi2c_queue_tail;
+	if(tinyi2c_recovering || tail == tinyi2c_queue_head || tinyi2c_queue[tail] != transfer ||
+	   transfer->status != TINYI2C_PENDING)
+	{
+		SREG = sreg;
+		return;
+	}
+	/* TWI off, no more TWI interrupts. Transfer stays at tail during
+	 * the recovery, so tinyi2c_submit() only queues new transfers. */
+	tinyi2c_recovering = 1;
+	TWCR = 0;
+	SREG = sreg;
+	
+	tinyi2c_recover();
+	
+	cli();
+	tail = (tail + 1) & TINYI2C_QUEUE_MASK;
+	tinyi2c_queue_tail = tail;
+	tinyi2c_recovering = 0;
+	
+	if(tail != tinyi2c_queue_head)
+	{
+		tinyi2c_index = 0;
+		tinyi2c_reading = 0;
+		tinyi2c_send_start();
+	}
+	
+	transfer->status = BUS_TIMEOUT;
+	if(transfer->done)
+		transfer->done(transfer);
+	SREG = sreg;
+}
+
+/************************************************************************/
+/* TWI interrupt, one step of the running transfer per TWINT            */
+/* See more at datasheet page 240,                                      */
+/* Table 20-3. Status codes for Master Transmitter Mode and             */
+/* Table 20-4. Status codes for Master Receiver Mode.                   */
+/************************************************************************/
+ISR(TWI_vect)
+{
+	tinyi2c_transfer_t* transfer = tinyi2c_queue[tinyi2c_queue_tail];
+	
+	switch(TW_STATUS)
+	{
+	case TW_START:
+	case TW_REP_START:
+		/* SLA+W unless write part is done or there is none */
+		if(!tinyi2c_reading && (transfer->write_count || !transfer->read_count))
+			TWDR = transfer->sla & ~I2CREAD;
+		else
+		{
+			tinyi2c_reading = 1;
+			TWDR = transfer->sla | I2CREAD;
+		}
+		TWCR = TINYI2C_RUN;
+		break;
+	
+	case TW_MT_SLA_ACK:
+	case TW_MT_DATA_ACK:
+		if(tinyi2c_index < transfer->write_count)
+		{
+			TWDR = transfer->write[tinyi2c_index++];
+			TWCR = TINYI2C_RUN;
+		}
+		else if(transfer->read_count)
+		{
+			/* repeated START, bus is kept for the read part */
+			tinyi2c_reading = 1;
+			tinyi2c_index = 0;
+			tinyi2c_send_start();
+		}
+		else
+			tinyi2c_finish(0);
+		break;
+	
+	case TW_MR_SLA_ACK:
+		/* TWEA acknowledges next byte, last one gets NOT ACK */
+		tinyi2c_index = 0;
+		TWCR = TINYI2C_RUN | (transfer->read_count > 1 ? (1<<TWEA) : 0);
+		break;
+	
+	case TW_MR_DATA_ACK:
+		transfer->read[tinyi2c_index++] = TWDR;
+		TWCR = TINYI2C_RUN | (tinyi2c_index + 1 < transfer->read_count ? (1<<TWEA) : 0);
+		break;
+	
+	case TW_MR_DATA_NACK:
+		transfer->read[tinyi2c_index] = TWDR;
+		tinyi2c_finish(0);
+		break;
+	
+	case TW_MT_SLA_NACK:
+	case TW_MR_SLA_NACK:
+		tinyi2c_finish(DEVICE_NOT_FOUND);
+		break;
+	
+	case TW_MT_ARB_LOST:
+		/* other master won, START is sent again when bus is free.
+		 * TW_MR_ARB_LOST has the same code. */
+		tinyi2c_index = 0;
+		tinyi2c_reading = 0;
+		tinyi2c_send_start();
+		break;
+	
+	case TW_MT_DATA_NACK:
+		tinyi2c_finish(DATA_NACK);
+		break;
+	
+	default:
+		/* TW_BUS_ERROR. STOP after bus error only releases the lines,
+		 * it is not sent to the bus. */
+		tinyi2c_finish(STATUS_ERROR);
+		break;
+	}
+}
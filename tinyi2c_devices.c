@@ -0,0 +1,167 @@
+/*
+ * tinyi2c_devices.c
+ * ----------------------------------------------------------------------------
+ * This is explanatory and educational version of I2C Bus driver for
+ * ATmega 8 bit Microcontrollers. Copyright (C) 2013 Pasi Heinonen
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * ----------------------------------------------------------------------------
+ *
+ * Title:	Tiny I2C, device registry (tinyi2c_devices.c)
+ * Author:	Pasi Heinonen <pasi.heinonen@gmail.com>, https://twitter.com/pasihe
+ *
+ * Absent device costs a START, address and STOP on every access, at 100 kHz
+ * about 110 us of bus time, with timeouts of a stuck bus much more. Here
+ * each device has a tinyi2c_device_t which remembers whether the device
+ * answered. Access to an absent device returns DEVICE_NOT_FOUND at once
+ * without bus traffic. Every n:th access is a probe which goes to the 
+ * bus, n doubles after each failed probe up to TINYI2C_BACKOFF_MAX. So a
+ * missing sensor read 100 times per second costs one probe in about 1.3
+ * seconds, and when it is plugged in it is found in that time.
+ *
+ * Device also keeps its own bit rate, TWBR is changed only when the 
+ * previous access was to a device with other bit rate, and error counters
+ * for diagnostics.
+ *
+ * tinyi2c_scan() probes all 112 addresses at boot, takes about 12 ms at
+ * 100 kHz, and fills a table of present devices. Devices known in advance
+ * are set up with tinyi2c_device_init(), they start as present.
+ *
+ * usage:
+ *
+	tinyi2c_device_t found[8];
+	tinyi2c_device_t temp;
+	unsigned char i, count, value;
+	
+	tinyi2c_init();
+	count = tinyi2c_scan(found, 8);
+	for(i=0;i<count;i++)
+		show_address(found[i].sla);
+	
+	tinyi2c_device_init(&temp, 0x96, 100000);
+	while(1)
+	{
+		// absent TC74 is probed only now and then
+		if(tinyi2c_device_read_regs(&temp, 0x00, &value, 1) == 0)
+			show_temperature(value);
+	}
+ */
+
+#include "tinyi2c.h"
+
+/************************************************************************/
+/* Sets up device with 8 bit address sla (SLA+W) and SCL frequency.     */
+/* scl_hz 0 keeps the bit rate in use now.                              */
+/************************************************************************/
+void tinyi2c_device_init(tinyi2c_device_t* device, unsigned char sla, uint32_t scl_hz)
+{
+	device->sla = sla & ~I2CREAD;
+	device->present = 1;
+	device->last_error = 0;
+	device->errors = 0;
+	device->backoff = 1;
+	device->skip = 0;
+	
+	if(scl_hz)
+		tinyi2c_bit_rate(scl_hz, &device->twbr, &device->twps);
+	else
+	{
+		device->twbr = TWBR;
+		device->twps = TWSR & ((1<<TWPS1) | (1<<TWPS0));
+	}
+}
+
+/************************************************************************/
+/* Probes addresses 0x08..0x77 with SLA+W and puts the devices which    */
+/* acknowledge to devices, at most max_count. Bit rate in use now is    */
+/* used for all. Returns number of devices found.                       */
+/************************************************************************/
+unsigned char tinyi2c_scan(tinyi2c_device_t* devices, unsigned char max_count)
+{
+	unsigned char address, count = 0;
+	
+	for(address=TINYI2C_FIRST_ADDRESS;address<=TINYI2C_LAST_ADDRESS && count<max_count;address++)
+	{
+		/* address only, no data: START, SLA+W, STOP */
+		if(tinyi2c_write_read(address << 1, 0, 0, 0, 0) == 0)
+			tinyi2c_device_init(&devices[count++], address << 1, 0);
+	}
+	return count;
+}
+
+/************************************************************************/
+/* tinyi2c_write_read() through the registry. Returns DEVICE_NOT_FOUND  */
+/* without bus access when device is absent and this is not a probe.    */
+/************************************************************************/
+unsigned char tinyi2c_device_write_read(tinyi2c_device_t* device,
+										unsigned char* write, unsigned char write_count,
+										unsigned char* read, unsigned char read_count)
+{
+	unsigned char status;
+	
+	if(!device->present && device->skip)
+	{
+		device->skip--;
+		return DEVICE_NOT_FOUND;
+	}
+	
+	/* status bits of TWSR are read only, writing prescaler is enough */
+	if(TWBR != device->twbr || (TWSR & ((1<<TWPS1) | (1<<TWPS0))) != device->twps)
+	{
+		TWSR = device->twps;
+		TWBR = device->twbr;
+	}
+	
+	status = tinyi2c_write_read(device->sla, write, write_count, read, read_count);
+	if(status == 0)
+	{
+		device->present = 1;
+		device->backoff = 1;
+		return 0;
+	}
+	
+	device->last_error = status;
+	if(device->errors != 0xFFFF)
+		device->errors++;
+	
+	/* no answer to the address, skip the next accesses */
+	if(status == DEVICE_NOT_FOUND)
+	{
+		device->present = 0;
+		device->skip = device->backoff;
+		if(device->backoff < TINYI2C_BACKOFF_MAX)
+			device->backoff <<= 1;
+	}
+	return status;
+}
+
+/************************************************************************/
+/* Write one register of device                                         */
+/************************************************************************/
+unsigned char tinyi2c_device_write_reg(tinyi2c_device_t* device, unsigned char reg, unsigned char value)
+{
+	unsigned char data[2];
+	
+	data[0] = reg;
+	data[1] = value;
+	return tinyi2c_device_write_read(device, data, 2, 0, 0);
+}
+
+/************************************************************************/
+/* Read count registers of device starting from reg                     */
+/************************************************************************/
+unsigned char tinyi2c_device_read_regs(tinyi2c_device_t* device, unsigned char reg,
+									   unsigned char* data, unsigned char count)
+{
+	return tinyi2c_device_write_read(device, &reg, 1, data, count);
+}